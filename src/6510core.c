@@ -38,6 +38,13 @@
 #define CPU_STR "Main CPU"
 #endif
 
+/* Only the main CPU can end a batch run at a given PC.  */
+#ifdef DRIVE_CPU
+#define BATCHRUN_CHECK_EXIT_PC(pc)
+#else
+#define BATCHRUN_CHECK_EXIT_PC(pc) batchrun_check_exit_pc(pc)
+#endif
+
 #include "traps.h"
 
 #ifndef C64DTV
@@ -342,6 +349,9 @@
                 if (monitor_mask[CALLER] & (MI_STEP)) {               \
                     monitor_check_icount_interrupt();                 \
                 }                                                     \
+                if (monitor_mask[CALLER] & (MI_PROFILE)) {            \
+                    monitor_profile_interrupt(CALLER, CLK, 1);        \
+                }                                                     \
                 interrupt_ack_nmi(CPU_INT_STATUS);                    \
                 LOCAL_SET_BREAK(0);                                   \
                 PUSH(reg_pc >> 8);                                    \
@@ -360,6 +370,9 @@
                 if (monitor_mask[CALLER] & (MI_STEP)) {               \
                     monitor_check_icount_interrupt();                 \
                 }                                                     \
+                if (monitor_mask[CALLER] & (MI_PROFILE)) {            \
+                    monitor_profile_interrupt(CALLER, CLK, 0);        \
+                }                                                     \
                 interrupt_ack_irq(CPU_INT_STATUS);                    \
                 LOCAL_SET_BREAK(0);                                   \
                 PUSH(reg_pc >> 8);                                    \
@@ -393,6 +406,10 @@
                     IMPORT_REGISTERS();                               \
                 if (monitor_mask[CALLER])                             \
                     EXPORT_REGISTERS();                               \
+                if (monitor_mask[CALLER] & (MI_PROFILE)) {            \
+                    monitor_profile_instruction(CALLER,               \
+                        (WORD)reg_pc, CLK);                           \
+                }                                                     \
                 if (monitor_mask[CALLER] & (MI_BREAK)) {              \
                     if (monitor_check_breakpoints(CALLER,             \
                         (WORD)reg_pc)) {                              \
@@ -408,6 +425,9 @@
                     monitor_check_watchpoints((WORD)reg_pc);          \
                     IMPORT_REGISTERS();                               \
                 }                                                     \
+                if (monitor_mask[CALLER] & (MI_BATCHEXIT)) {          \
+                    BATCHRUN_CHECK_EXIT_PC((WORD)reg_pc);             \
+                }                                                     \
             }                                                         \
             if (ik & IK_DMA) {                                        \
                 EXPORT_REGISTERS();                                   \
@@ -256,6 +256,9 @@
                 if (monitor_mask[CALLER] & (MI_STEP)) {               \
                     monitor_check_icount_interrupt();                 \
                 }                                                     \
+                if (monitor_mask[CALLER] & (MI_PROFILE)) {            \
+                    monitor_profile_interrupt(CALLER, CLK, 1);        \
+                }                                                     \
                 interrupt_ack_nmi(CPU_INT_STATUS);                    \
                 if (!SKIP_CYCLE) {                                    \
                     LOAD(reg_pc);                                     \
@@ -286,6 +289,9 @@
                 if (monitor_mask[CALLER] & (MI_STEP)) {               \
                     monitor_check_icount_interrupt();                 \
                 }                                                     \
+                if (monitor_mask[CALLER] & (MI_PROFILE)) {            \
+                    monitor_profile_interrupt(CALLER, CLK, 0);        \
+                }                                                     \
                 interrupt_ack_irq(CPU_INT_STATUS);                    \
                 if (!SKIP_CYCLE) {                                    \
                     LOAD(reg_pc);                                     \
@@ -333,6 +339,10 @@
                     IMPORT_REGISTERS();                               \
                 if (monitor_mask[CALLER])                             \
                     EXPORT_REGISTERS();                               \
+                if (monitor_mask[CALLER] & (MI_PROFILE)) {            \
+                    monitor_profile_instruction(CALLER,               \
+                        (WORD)reg_pc, CLK);                           \
+                }                                                     \
                 if (monitor_mask[CALLER] & (MI_BREAK)) {              \
                     if (monitor_check_breakpoints(CALLER,             \
                         (WORD)reg_pc)) {                              \
@@ -348,6 +358,9 @@
                     monitor_check_watchpoints((WORD)reg_pc);          \
                     IMPORT_REGISTERS();                               \
                 }                                                     \
+                if (monitor_mask[CALLER] & (MI_BATCHEXIT)) {          \
+                    batchrun_check_exit_pc((WORD)reg_pc);             \
+                }                                                     \
             }                                                         \
             if (ik & IK_DMA) {                                        \
                 EXPORT_REGISTERS();                                   \
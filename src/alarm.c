@@ -51,8 +51,20 @@ void alarm_context_init(alarm_context_t *context, const char *name)
 
     context->alarms = NULL;
 
+    context->num_allocated_pending_alarms = ALARM_CONTEXT_INITIAL_PENDING_ALARMS;
+    context->pending_alarms = lib_malloc(context->num_allocated_pending_alarms
+                                         * sizeof(pending_alarms_t));
     context->num_pending_alarms = 0;
     context->next_pending_alarm_clk = (CLOCK)~0L;
+    context->next_pending_alarm_idx = -1;
+}
+
+void alarm_context_grow_pending(alarm_context_t *context)
+{
+    context->num_allocated_pending_alarms *= 2;
+    context->pending_alarms = lib_realloc(context->pending_alarms,
+                                          context->num_allocated_pending_alarms
+                                          * sizeof(pending_alarms_t));
 }
 
 void alarm_context_destroy(alarm_context_t *context)
@@ -72,6 +84,7 @@ void alarm_context_destroy(alarm_context_t *context)
         }
     }
 
+    lib_free(context->pending_alarms);
     lib_free(context);
 }
 
@@ -90,10 +103,8 @@ void alarm_context_time_warp(alarm_context_t *context, CLOCK warp_amount,
             context->pending_alarms[i].clk -= warp_amount;
     }
 
-    if (warp_direction > 0)
-        context->next_pending_alarm_clk += warp_amount;
-    else
-        context->next_pending_alarm_clk -= warp_amount;
+    /* Shifting every alarm by the same amount keeps the heap order.  */
+    alarm_context_update_next_pending(context);
 }
 
 /* ------------------------------------------------------------------------ */
@@ -160,6 +171,7 @@ void alarm_unset(alarm_t *alarm)
 {
     alarm_context_t *context;
     int idx;
+    unsigned int last;
 
     idx = alarm->pending_idx;
 
@@ -168,37 +180,25 @@ void alarm_unset(alarm_t *alarm)
 
     context = alarm->context;
 
-    if (context->num_pending_alarms > 1) {
-        int last;
+    last = --context->num_pending_alarms;
 
-        last = --context->num_pending_alarms;
+    if ((unsigned int)idx != last) {
+        CLOCK removed_clk = context->pending_alarms[idx].clk;
+        CLOCK last_clk = context->pending_alarms[last].clk;
 
-        if (last != idx) {
-            /* Let's copy the struct by hand to make sure stupid compilers
-               don't do stupid things.  */
-            context->pending_alarms[idx].alarm
-                = context->pending_alarms[last].alarm;
-            context->pending_alarms[idx].clk
-                = context->pending_alarms[last].clk;
+        /* Fill the hole with the last heap entry and restore the heap
+           property in whichever direction it got violated.  */
+        alarm_context_place(context, (unsigned int)idx,
+                            context->pending_alarms[last].alarm, last_clk);
 
-            context->pending_alarms[idx].alarm->pending_idx = idx;
-        }
-
-        if (context->next_pending_alarm_idx == idx)
-            alarm_context_update_next_pending(context);
-        else if (context->next_pending_alarm_idx == last)
-            context->next_pending_alarm_idx = idx;
-    } else {
-        context->num_pending_alarms = 0;
-        context->next_pending_alarm_clk = (CLOCK) ~0L;
-        context->next_pending_alarm_idx = -1;
+        if (last_clk < removed_clk)
+            alarm_context_sift_up(context, (unsigned int)idx);
+        else
+            alarm_context_sift_down(context, (unsigned int)idx);
     }
 
-    alarm->pending_idx = -1;
-}
+    alarm_context_update_next_pending(context);
 
-void alarm_log_too_many_alarms(void)
-{
-    //log_error(LOG_DEFAULT, "alarm_set(): Too many alarms set!");
+    alarm->pending_idx = -1;
 }
 
@@ -30,7 +30,9 @@
 
 #include "types.h"
 
-#define ALARM_CONTEXT_MAX_PENDING_ALARMS 0x100
+/* Initial size of the pending alarm heap.  The heap grows on demand, so
+   this is not a hard limit.  */
+#define ALARM_CONTEXT_INITIAL_PENDING_ALARMS 0x40
 
 typedef void (*alarm_callback_t)(CLOCK offset, void *data);
 
@@ -45,7 +47,7 @@ struct alarm_s {
     /* Callback to be called when the alarm is dispatched.  */
     alarm_callback_t callback;
 
-    /* Index into the pending alarm list.  If < 0, the alarm is not
+    /* Index into the pending alarm heap.  If < 0, the alarm is not
        pending.  */
     int pending_idx;
 
@@ -74,15 +76,17 @@ struct alarm_context_s {
     /* Alarm list.  */
     struct alarm_s *alarms;
 
-    /* Pending alarm array.  Statically allocated because it's slightly
-       faster this way.  */
-    pending_alarms_t pending_alarms[ALARM_CONTEXT_MAX_PENDING_ALARMS];
+    /* Pending alarms, kept as a binary min-heap ordered by `clk'.  The
+       earliest alarm is always at index 0, so finding it no longer
+       requires a scan over all pending alarms.  */
+    pending_alarms_t *pending_alarms;
     unsigned int num_pending_alarms;
+    unsigned int num_allocated_pending_alarms;
 
     /* Clock tick for the next pending alarm.  */
     CLOCK next_pending_alarm_clk;
 
-    /* Pending alarm number.  */
+    /* Pending alarm number; 0 if any alarm is pending, -1 otherwise.  */
     int next_pending_alarm_idx;
 };
 typedef struct alarm_context_s alarm_context_t;
@@ -98,7 +102,7 @@ extern alarm_t *alarm_new(alarm_context_t *context, const char *name,
                           alarm_callback_t callback, void *data);
 extern void alarm_destroy(alarm_t *alarm);
 extern void alarm_unset(alarm_t *alarm);
-extern void alarm_log_too_many_alarms(void);
+extern void alarm_context_grow_pending(alarm_context_t *context);
 
 /* ------------------------------------------------------------------------- */
 
@@ -109,38 +113,90 @@ inline static CLOCK alarm_context_next_pending_clk(alarm_context_t *context)
     return context->next_pending_alarm_clk;
 }
 
-inline static void alarm_context_update_next_pending(alarm_context_t *context)
+/* Store a pending alarm at heap position `idx' and keep the back
+   reference in the alarm up to date.  */
+inline static void alarm_context_place(alarm_context_t *context,
+                                       unsigned int idx, alarm_t *alarm,
+                                       CLOCK clk)
+{
+    context->pending_alarms[idx].alarm = alarm;
+    context->pending_alarms[idx].clk = clk;
+    alarm->pending_idx = (int)idx;
+}
+
+/* Move the pending alarm at heap position `idx' towards the root until
+   the heap property holds again.  */
+inline static void alarm_context_sift_up(alarm_context_t *context,
+                                         unsigned int idx)
 {
-    CLOCK next_pending_alarm_clk = (CLOCK)~0L;
-    unsigned int next_pending_alarm_idx;
-    unsigned int i;
+    pending_alarms_t *heap = context->pending_alarms;
+    alarm_t *alarm = heap[idx].alarm;
+    CLOCK clk = heap[idx].clk;
+
+    while (idx > 0) {
+        unsigned int parent = (idx - 1) >> 1;
+
+        if (heap[parent].clk <= clk)
+            break;
+
+        alarm_context_place(context, idx, heap[parent].alarm,
+                            heap[parent].clk);
+        idx = parent;
+    }
+
+    alarm_context_place(context, idx, alarm, clk);
+}
+
+/* Move the pending alarm at heap position `idx' towards the leaves until
+   the heap property holds again.  */
+inline static void alarm_context_sift_down(alarm_context_t *context,
+                                           unsigned int idx)
+{
+    pending_alarms_t *heap = context->pending_alarms;
+    unsigned int num = context->num_pending_alarms;
+    alarm_t *alarm = heap[idx].alarm;
+    CLOCK clk = heap[idx].clk;
+
+    for (;;) {
+        unsigned int child = (idx << 1) + 1;
 
-    next_pending_alarm_idx = context->next_pending_alarm_idx;
+        if (child >= num)
+            break;
 
-    for (i = 0; i < context->num_pending_alarms; i++) {
-        CLOCK pending_clk = context->pending_alarms[i].clk;
+        if (child + 1 < num && heap[child + 1].clk < heap[child].clk)
+            child++;
 
-        if (pending_clk <= next_pending_alarm_clk) {
-            next_pending_alarm_clk = pending_clk;
-            next_pending_alarm_idx = i;
-        }
+        if (clk <= heap[child].clk)
+            break;
+
+        alarm_context_place(context, idx, heap[child].alarm,
+                            heap[child].clk);
+        idx = child;
     }
 
-    context->next_pending_alarm_clk = next_pending_alarm_clk;
-    context->next_pending_alarm_idx = next_pending_alarm_idx;
+    alarm_context_place(context, idx, alarm, clk);
+}
+
+inline static void alarm_context_update_next_pending(alarm_context_t *context)
+{
+    if (context->num_pending_alarms > 0) {
+        context->next_pending_alarm_clk = context->pending_alarms[0].clk;
+        context->next_pending_alarm_idx = 0;
+    } else {
+        context->next_pending_alarm_clk = (CLOCK)~0L;
+        context->next_pending_alarm_idx = -1;
+    }
 }
 
 inline static void alarm_context_dispatch(alarm_context_t *context,
                                           CLOCK cpu_clk)
 {
     CLOCK offset;
-    unsigned int idx;
     alarm_t *alarm;
 
     offset = (CLOCK)(cpu_clk - context->next_pending_alarm_clk);
 
-    idx = context->next_pending_alarm_idx;
-    alarm = context->pending_alarms[idx].alarm;
+    alarm = context->pending_alarms[0].alarm;
 
     (alarm->callback)(offset, alarm->data);
 }
@@ -159,31 +215,28 @@ inline static void alarm_set(alarm_t *alarm, CLOCK cpu_clk)
         /* Not pending yet: add.  */
 
         new_idx = context->num_pending_alarms;
-        if (new_idx >= ALARM_CONTEXT_MAX_PENDING_ALARMS) {
-            alarm_log_too_many_alarms();
-            return;
-        }
-
-        context->pending_alarms[new_idx].alarm = alarm;
-        context->pending_alarms[new_idx].clk = cpu_clk;
+        if (new_idx >= context->num_allocated_pending_alarms)
+            alarm_context_grow_pending(context);
 
         context->num_pending_alarms++;
 
-        if (cpu_clk < context->next_pending_alarm_clk) {
-            context->next_pending_alarm_clk = cpu_clk;
-            context->next_pending_alarm_idx = new_idx;
-        }
-
-        alarm->pending_idx = new_idx;
+        alarm_context_place(context, new_idx, alarm, cpu_clk);
+        alarm_context_sift_up(context, new_idx);
     } else {
+        CLOCK old_clk;
+
         /* Already pending: modify.  */
 
+        old_clk = context->pending_alarms[idx].clk;
         context->pending_alarms[idx].clk = cpu_clk;
-        if (context->next_pending_alarm_clk > cpu_clk
-            || idx == context->next_pending_alarm_idx)
-            alarm_context_update_next_pending(context);
+
+        if (cpu_clk < old_clk)
+            alarm_context_sift_up(context, (unsigned int)idx);
+        else if (cpu_clk > old_clk)
+            alarm_context_sift_down(context, (unsigned int)idx);
     }
+
+    alarm_context_update_next_pending(context);
 }
 
 #endif
-
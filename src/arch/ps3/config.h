@@ -87,6 +87,8 @@
 //#define HAVE_RESID_DTV         1
 #define HAVE_PNG               0
 #define HAVE_ZLIB              1
+/* Define if the C library can open a stream on a buffer in memory.  */
+//#define HAVE_FMEMOPEN          1
 #define HAS_JOYSTICK           1
 #define HAVE_MOUSE             1
 //#define HAVE_NETWORK           1
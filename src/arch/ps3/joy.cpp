@@ -42,6 +42,7 @@ extern "C" {
 #include "autostart.h"
 #include "machine.h"
 #include "resources.h"
+#include "rewind.h"
 #include "videoarch.h"
 #include "vsync.h"
 #include "ui.h"
@@ -211,6 +212,7 @@ int joystick(void)
 	static bool key_cursorright = false;
 
 	static bool warp_mode=false;
+	static bool rewinding=false;
 
 	// osk_active_bufferlen == The OSK is entering characters, don't interrupt it.
 	// autostart_in_progress() == 
@@ -347,6 +349,24 @@ int joystick(void)
 		if (CellInput->IsButtonPressed(i,CTRL_L1) && CellInput->IsButtonPressed(i,CTRL_R1) && CellInput->IsButtonPressed(i,CTRL_L2) && CellInput->IsButtonPressed(i,CTRL_R2) )
 			machine_trigger_reset(MACHINE_RESET_MODE_HARD);
 
+		// Holding L1+R1 steps back one rewind state per frame (needs RewindFrames > 0)
+		if (i == 0)
+		{
+			if ((CellInput->IsButtonPressed(0,CTRL_L1) && CellInput->IsButtonPressed(0,CTRL_R1) && !CellInput->IsButtonPressed(0,CTRL_L2) && !CellInput->IsButtonPressed(0,CTRL_R2)) || (CellInput->IsButtonPressed(1,CTRL_L1) && CellInput->IsButtonPressed(1,CTRL_R1) && !CellInput->IsButtonPressed(1,CTRL_L2) && !CellInput->IsButtonPressed(1,CTRL_R2)))
+			{
+				if (!rewinding)
+				{
+					#ifdef CELL_DEBUG
+					printf("INFO: Rewinding, %u states in %lu bytes.\n", rewind_get_depth(), rewind_get_memory());
+					#endif
+					rewinding=true;
+				}
+				rewind_step();
+			}
+			else
+				rewinding=false;
+		}
+
 
 		/*
 		// Swap joysticks
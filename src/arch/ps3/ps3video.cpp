@@ -43,6 +43,7 @@ extern "C" {
 #include "datasette.h"
 #include "tape.h"
 #include "ui.h"
+#include "videoarch.h"
 }
 
 static const char* active_shader=NULL;
@@ -263,6 +264,8 @@ int32_t PS3Graphics::PSGLInit()
 	glVertexPointer(3, GL_FLOAT, 0, 0);
 	glTexCoordPointer(2, GL_FLOAT, 0, (void*)128);
 
+	force_full_upload();
+
 	return CELL_OK;
 }
 
@@ -334,9 +337,21 @@ void PS3Graphics::UpdateCgParams(unsigned width, unsigned height, unsigned tex_w
 }
 
 void PS3Graphics::Draw(int width, int height, uint16_t* screen)
+{
+	UploadRows(width, screen, 0, height);
+	Present(width, height);
+}
+
+// Copy only the given rows of the screen into the texture buffer
+void PS3Graphics::UploadRows(int width, uint16_t* screen, int first_row, int num_rows)
+{
+	glBufferSubData(GL_TEXTURE_REFERENCE_BUFFER_SCE, first_row * width * 2, num_rows * width * 2, screen + first_row * width);
+}
+
+// Draw whatever is in the texture buffer
+void PS3Graphics::Present(int width, int height)
 {
 	glClear(GL_COLOR_BUFFER_BIT);
-	glBufferSubData(GL_TEXTURE_REFERENCE_BUFFER_SCE, 0, width * height * 2, screen);
 	glTextureReferenceSCE(GL_TEXTURE_2D, 1, width, height, 0, GL_RGB5_A1, width*2, 0);
 	UpdateCgParams(width, height, width, height);
 	glDrawArrays(GL_QUADS, 0, 4); 
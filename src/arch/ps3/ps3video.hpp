@@ -86,6 +86,8 @@ class PS3Graphics
 
 		/* draw functions */
 		void Draw(int width, int height, uint16_t* screen);
+		void UploadRows(int width, uint16_t* screen, int first_row, int num_rows);
+		void Present(int width, int height);
 		void Refresh();
 
 		/* cg */
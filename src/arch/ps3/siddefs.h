@@ -66,4 +66,17 @@ const char* resid_version_string = VERSION;
 #define RESID_INLINING 1
 #define RESID_INLINE inline
 
+// SIMD convolution kernels, selected at run time.
+#if defined(__ALTIVEC__)
+#define RESID_USE_ALTIVEC 1
+#else
+#define RESID_USE_ALTIVEC 0
+#endif
+
+#if defined(__SSE2__) || defined(__x86_64__)
+#define RESID_USE_SSE2 1
+#else
+#define RESID_USE_SSE2 0
+#endif
+
 #endif // not __SIDDEFS_H__
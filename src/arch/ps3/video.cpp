@@ -59,6 +59,38 @@ static video_canvas_t *canvaslist[MAX_CANVAS_NUM];
 int sysutil_drawing = 0;
 static int last_redraw = 0;
 
+/* Rows of `screenbuffer' rendered since the last upload to the texture.  */
+#define MAX_DIRTY_RANGES 8
+static unsigned int dirty_first[MAX_DIRTY_RANGES];
+static unsigned int dirty_last[MAX_DIRTY_RANGES];
+static unsigned int num_dirty_ranges = 0;
+
+/* The texture buffer has been reallocated and must be uploaded in full.  */
+static int full_upload = 1;
+
+static void add_dirty_rows(unsigned int first, unsigned int last)
+{
+	unsigned int i = num_dirty_ranges - 1;
+
+	if (num_dirty_ranges > 0 && first <= dirty_last[i] + 1 && last + 1 >= dirty_first[i])
+	{
+		dirty_first[i] = MIN(first, dirty_first[i]);
+		dirty_last[i] = MAX(last, dirty_last[i]);
+	}
+	else if (num_dirty_ranges < MAX_DIRTY_RANGES)
+	{
+		dirty_first[num_dirty_ranges] = first;
+		dirty_last[num_dirty_ranges] = last;
+		num_dirty_ranges++;
+	}
+	else
+	{
+		/* Out of ranges, grow the last one.  */
+		dirty_first[i] = MIN(first, dirty_first[i]);
+		dirty_last[i] = MAX(last, dirty_last[i]);
+	}
+}
+
 static void canvas_change_palette(video_canvas_t *c)
 {
 }
@@ -147,6 +179,7 @@ void video_canvas_resize(video_canvas_t *canvas, unsigned int width, unsigned in
 
 	video_canvas_set_palette(canvas, canvas->palette);
 	Graphics->PSGLReInit (width, height, canvas->depth);
+	full_upload = 1;
 }
 
 /* Note: `mapped' is ignored.  */
@@ -233,8 +266,32 @@ void video_canvas_refresh(video_canvas_t *canvas, unsigned int xs, unsigned int
 
 	video_canvas_render(canvas, (BYTE *)screenbuffer, w, h, xs, ys, xi, yi, canvas->bytes_per_line, canvas->depth);
 
+	if (h > 0 && yi < canvas->height)
+		add_dirty_rows(yi, MIN(yi + h, canvas->height) - 1);
+}
+
+void video_canvas_refresh_done(video_canvas_t *canvas)
+{
+	unsigned int i;
+
+	if (active_canvas != canvas)
+		return;
+
+	/* Only the rows rendered during this frame need to go to the texture.  */
+	if (full_upload)
+	{
+		Graphics->UploadRows(canvas->width, (std::uint16_t *)screenbuffer, 0, canvas->height);
+		full_upload = 0;
+	}
+	else
+	{
+		for (i = 0; i < num_dirty_ranges; i++)
+			Graphics->UploadRows(canvas->width, (std::uint16_t *)screenbuffer, dirty_first[i], dirty_last[i] - dirty_first[i] + 1);
+	}
+	num_dirty_ranges = 0;
+
 	set_last_redraw();
-	Graphics->Draw (canvas->width, canvas->height, (std::uint16_t *)screenbuffer);
+	Graphics->Present(canvas->width, canvas->height);
 	psglSwap();
 }
 
@@ -274,6 +331,13 @@ void force_redraw (void)
 		raster_force_repaint(active_canvas->parent_raster);
 }
 
+/* The texture buffer was reallocated, so the next refresh must upload the
+   whole screen and not only the dirty rows.  */
+void force_full_upload (void)
+{
+	full_upload = 1;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -32,6 +32,7 @@
 void set_last_redraw(void);
 unsigned long get_last_redraw(void);
 void force_redraw(void);
+void force_full_upload(void);
 
 
 struct palette_s;
@@ -36,6 +36,8 @@
 
 #include <unistd.h>
 #include <sys/time.h>
+#include <sys/sys_time.h>
+#include <ppu_intrinsics.h>
 
 /* hook to ui event dispatcher */
 static void_hook_t ui_dispatch_hook;
@@ -82,6 +84,19 @@ unsigned long vsyncarch_gettime(void)
 	return sys_time_get_system_time();
 }
 
+/* Fine grained host timer for the performance counters: the PPU timebase.
+   Reading it is a single instruction, unlike the system time syscall. */
+
+unsigned long vsyncarch_perf_ticks(void)
+{
+	return (unsigned long)__mftb();
+}
+
+signed long vsyncarch_perf_frequency(void)
+{
+	return (signed long)sys_time_get_timebase_frequency();
+}
+
 void vsyncarch_init(void)
 {
 	vsync_set_event_dispatcher(ui_dispatch_events);
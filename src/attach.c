@@ -26,6 +26,7 @@
 
 #include "vice.h"
 
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -37,6 +38,7 @@
 #include "event.h"
 #include "fsdevice.h"
 #include "fliplist.h"
+#include "gcr.h"
 #include "lib.h"
 #include "machine-drive.h"
 #include "network.h"
@@ -67,6 +69,7 @@ static file_system_t file_system[4];
 
 static int attach_device_readonly_enabled[4];
 static int file_system_device_enabled[4];
+static int attach_prefetch_enabled;
 
 static int set_attach_device_readonly(int val, void *param);
 static int set_file_system_device(int val, void *param);
@@ -78,6 +81,17 @@ static void detach_disk_image_and_free(disk_image_t *image, vdrive_t *floppy,
 static int attach_disk_image(disk_image_t **imgptr, vdrive_t *floppy,
                              const char *filename, unsigned int unit,
                              int devicetype);
+static void attach_prefetch_shutdown(void);
+
+static int set_attach_prefetch(int val, void *param)
+{
+    attach_prefetch_enabled = val;
+
+    if (!val)
+        attach_prefetch_shutdown();
+
+    return 0;
+}
 
 static const resource_int_t resources_int[] = {
     { "AttachDevice8Readonly", 0, RES_EVENT_SAME, NULL,
@@ -108,6 +122,8 @@ static const resource_int_t resources_int[] = {
       RES_EVENT_STRICT, (resource_value_t)ATTACH_DEVICE_NONE,
       &file_system_device_enabled[3],
       set_file_system_device, (void *)11 },
+    { "AttachPrefetch", 1, RES_EVENT_NO, NULL,
+      &attach_prefetch_enabled, set_attach_prefetch, NULL },
     { NULL }
 };
 
@@ -179,6 +195,16 @@ static const cmdline_option_t cmdline_options[] = {
       USE_PARAM_STRING, USE_DESCRIPTION_ID,
       IDCLS_UNUSED, IDCLS_ATTACH_READ_WRITE_11,
       NULL, NULL },
+    { "-attachprefetch", SET_RESOURCE, 0,
+      NULL, NULL, "AttachPrefetch", (resource_value_t)1,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      NULL, T_("Open the next fliplist image in the background") },
+    { "+attachprefetch", SET_RESOURCE, 0,
+      NULL, NULL, "AttachPrefetch", (resource_value_t)0,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      NULL, T_("Open fliplist images only when flipping") },
     { NULL }
 };
 
@@ -245,6 +271,8 @@ void file_system_shutdown(void)
 {
     unsigned int i;
 
+    attach_prefetch_shutdown();
+
     for (i = 0; i < 4; i++) {
         vdrive_device_shutdown(file_system[i].vdrive);
         lib_free(file_system[i].vdrive);
@@ -433,6 +461,222 @@ static int set_file_system_device(int val, void *param)
 
 /* ------------------------------------------------------------------------- */
 
+/* The image a fliplist flips to next is opened, probed and read into memory
+   by a helper thread ahead of time, see file_system_prefetch_disk().
+   Attaching it then only hands the opened image over to the drives.  The
+   GCR data of a G64 image is read ahead into a buffer of its own, which
+   drive_image_attach() copies instead of parsing the file again.  */
+
+#define ATTACH_PREFETCH_NONE    0
+#define ATTACH_PREFETCH_PENDING 1
+#define ATTACH_PREFETCH_DONE    2
+#define ATTACH_PREFETCH_FAILED  3
+
+typedef struct attach_prefetch_s {
+    /* The helper thread owns a pending slot; all other states belong to
+       the main thread.  */
+    int state;
+    char *filename;
+    unsigned int read_only;
+    disk_image_t image;
+} attach_prefetch_t;
+
+static attach_prefetch_t prefetch[4];
+
+static pthread_t prefetch_thread;
+static pthread_mutex_t prefetch_mutex;
+static pthread_cond_t prefetch_cond;
+static int prefetch_thread_started = 0;
+static int prefetch_thread_quit = 0;
+
+static int attach_prefetch_open(attach_prefetch_t *p)
+{
+    disk_image_t *image = &p->image;
+
+    memset(image, 0, sizeof(disk_image_t));
+    image->read_only = p->read_only;
+    image->device = DISK_IMAGE_DEVICE_FS;
+
+    disk_image_media_create(image);
+    disk_image_fsimage_name_set(image, lib_stralloc(p->filename));
+
+    /* The probe reads the GCR data of a G64 image into this buffer.  */
+    image->gcr = gcr_create_image();
+
+    if (disk_image_open(image) < 0) {
+        gcr_destroy_image(image->gcr);
+        disk_image_media_destroy(image);
+        return -1;
+    }
+
+    if (image->type != DISK_IMAGE_TYPE_G64) {
+        gcr_destroy_image(image->gcr);
+        image->gcr = NULL;
+    }
+
+    return 0;
+}
+
+static void *attach_prefetch_main(void *data)
+{
+    unsigned int i;
+    int rc;
+
+    pthread_mutex_lock(&prefetch_mutex);
+
+    while (!prefetch_thread_quit) {
+        for (i = 0; i < 4; i++) {
+            if (prefetch[i].state == ATTACH_PREFETCH_PENDING)
+                break;
+        }
+
+        if (i == 4) {
+            pthread_cond_wait(&prefetch_cond, &prefetch_mutex);
+            continue;
+        }
+
+        pthread_mutex_unlock(&prefetch_mutex);
+        rc = attach_prefetch_open(&prefetch[i]);
+        pthread_mutex_lock(&prefetch_mutex);
+
+        prefetch[i].state = (rc < 0) ? ATTACH_PREFETCH_FAILED
+                                     : ATTACH_PREFETCH_DONE;
+        pthread_cond_broadcast(&prefetch_cond);
+    }
+
+    pthread_mutex_unlock(&prefetch_mutex);
+
+    return NULL;
+}
+
+/* Wait until the helper thread is done with `p'.  */
+static void attach_prefetch_wait(attach_prefetch_t *p)
+{
+    while (p->state == ATTACH_PREFETCH_PENDING)
+        pthread_cond_wait(&prefetch_cond, &prefetch_mutex);
+}
+
+static void attach_prefetch_discard(attach_prefetch_t *p)
+{
+    if (p->state == ATTACH_PREFETCH_DONE) {
+        if (p->image.gcr != NULL)
+            gcr_destroy_image(p->image.gcr);
+        disk_image_close(&p->image);
+        disk_image_media_destroy(&p->image);
+    }
+
+    lib_free(p->filename);
+    p->filename = NULL;
+    p->state = ATTACH_PREFETCH_NONE;
+}
+
+/* Hand out the image prefetched for `filename', if there is one.  */
+static int attach_prefetch_take(unsigned int unit, const char *filename,
+                                unsigned int read_only, disk_image_t *image)
+{
+    attach_prefetch_t *p;
+    int rc = -1;
+
+    if (!prefetch_thread_started)
+        return -1;
+
+    p = &prefetch[unit - 8];
+
+    pthread_mutex_lock(&prefetch_mutex);
+
+    attach_prefetch_wait(p);
+
+    if (p->state != ATTACH_PREFETCH_NONE && p->read_only == read_only
+        && strcmp(p->filename, filename) == 0) {
+        if (p->state == ATTACH_PREFETCH_DONE) {
+            memcpy(image, &p->image, sizeof(disk_image_t));
+            p->state = ATTACH_PREFETCH_NONE;
+            rc = 0;
+        }
+        attach_prefetch_discard(p);
+    }
+
+    pthread_mutex_unlock(&prefetch_mutex);
+
+    return rc;
+}
+
+/* Start opening `filename' for `unit' in the background.  */
+void file_system_prefetch_disk(unsigned int unit, const char *filename)
+{
+    attach_prefetch_t *p;
+    unsigned int read_only;
+
+    if (!attach_prefetch_enabled || unit < 8 || unit > 11 || filename == NULL)
+        return;
+
+    switch (file_system_device_enabled[unit - 8]) {
+      case ATTACH_DEVICE_NONE:
+      case ATTACH_DEVICE_VIRT:
+      case ATTACH_DEVICE_FS:
+        break;
+      default:
+        return;
+    }
+
+    if (!prefetch_thread_started) {
+        pthread_mutex_init(&prefetch_mutex, NULL);
+        pthread_cond_init(&prefetch_cond, NULL);
+        prefetch_thread_quit = 0;
+
+        if (pthread_create(&prefetch_thread, NULL, attach_prefetch_main,
+                           NULL) != 0) {
+            pthread_cond_destroy(&prefetch_cond);
+            pthread_mutex_destroy(&prefetch_mutex);
+            return;
+        }
+        prefetch_thread_started = 1;
+    }
+
+    p = &prefetch[unit - 8];
+    read_only = (unsigned int)attach_device_readonly_enabled[unit - 8];
+
+    pthread_mutex_lock(&prefetch_mutex);
+
+    attach_prefetch_wait(p);
+
+    if (p->state != ATTACH_PREFETCH_DONE || p->read_only != read_only
+        || strcmp(p->filename, filename) != 0) {
+        attach_prefetch_discard(p);
+        p->filename = lib_stralloc(filename);
+        p->read_only = read_only;
+        p->state = ATTACH_PREFETCH_PENDING;
+        pthread_cond_broadcast(&prefetch_cond);
+    }
+
+    pthread_mutex_unlock(&prefetch_mutex);
+}
+
+static void attach_prefetch_shutdown(void)
+{
+    unsigned int i;
+
+    if (!prefetch_thread_started)
+        return;
+
+    pthread_mutex_lock(&prefetch_mutex);
+    for (i = 0; i < 4; i++)
+        attach_prefetch_wait(&prefetch[i]);
+    prefetch_thread_quit = 1;
+    pthread_cond_broadcast(&prefetch_cond);
+    pthread_mutex_unlock(&prefetch_mutex);
+
+    pthread_join(prefetch_thread, NULL);
+    pthread_cond_destroy(&prefetch_cond);
+    pthread_mutex_destroy(&prefetch_mutex);
+    prefetch_thread_started = 0;
+
+    for (i = 0; i < 4; i++)
+        attach_prefetch_discard(&prefetch[i]);
+}
+
+/* ------------------------------------------------------------------------- */
+
 static void detach_disk_image(disk_image_t *image, vdrive_t *floppy,
                               unsigned int unit)
 {
@@ -488,6 +732,7 @@ static int attach_disk_image(disk_image_t **imgptr, vdrive_t *floppy,
 {
     disk_image_t *image;
     disk_image_t new_image;
+    gcr_t *prefetched_gcr = NULL;
     int err = -1;
 
     if (filename == NULL) {
@@ -495,6 +740,19 @@ static int attach_disk_image(disk_image_t **imgptr, vdrive_t *floppy,
         return -1;
     }
 
+    switch (devicetype) {
+      case ATTACH_DEVICE_NONE:
+      case ATTACH_DEVICE_VIRT:
+      case ATTACH_DEVICE_FS:
+        if (attach_prefetch_take(unit, filename,
+            (unsigned int)attach_device_readonly_enabled[unit - 8],
+            &new_image) == 0) {
+            prefetched_gcr = new_image.gcr;
+            goto opened;
+        }
+        break;
+    }
+
     new_image.gcr = NULL;
     new_image.read_only = (unsigned int)attach_device_readonly_enabled[unit - 8];
 
@@ -527,6 +785,7 @@ static int attach_disk_image(disk_image_t **imgptr, vdrive_t *floppy,
         return -1;
     }
 
+opened:
     detach_disk_image_and_free(*imgptr, floppy, unit);
 
     *imgptr = disk_image_create();
@@ -556,6 +815,11 @@ static int attach_disk_image(disk_image_t **imgptr, vdrive_t *floppy,
         err &= machine_drive_image_attach(image, 11);
         break;
     }
+    /* The drive copies GCR data read ahead; drop it if it did not.  */
+    if (prefetched_gcr != NULL && image->gcr == prefetched_gcr) {
+        gcr_destroy_image(prefetched_gcr);
+        image->gcr = NULL;
+    }
     if (err) {
         disk_image_close(image);
         disk_image_media_destroy(image);
@@ -45,6 +45,8 @@ extern int file_system_cmdline_options_init(void);
 
 extern const char *file_system_get_disk_name(unsigned int unit);
 extern int file_system_attach_disk(unsigned int unit, const char *filename);
+extern void file_system_prefetch_disk(unsigned int unit,
+                                      const char *filename);
 extern void file_system_detach_disk(int unit);
 extern void file_system_detach_disk_shutdown(void);
 extern struct vdrive_s *file_system_get_vdrive(unsigned int unit);
@@ -0,0 +1,404 @@
+/*
+ * batchrun.c - Headless batch mode for unattended program execution.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* In batch mode the emulator runs as fast as it can without drawing
+   frames or producing sound, until either a cycle limit is reached, the
+   CPU gets to a given PC, a memory location takes a given value or the
+   CPU jams.  It then optionally dumps a memory range to a file, prints
+   the emulation throughput and exits.  */
+
+#include "vice.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "alarm.h"
+#include "archdep.h"
+#include "batchrun.h"
+#include "clkguard.h"
+#include "cmdline.h"
+#include "interrupt.h"
+#include "machine.h"
+#include "maincpu.h"
+#include "mem.h"
+#include "monitor.h"
+#include "raster.h"
+#include "resources.h"
+#include "translate.h"
+#include "types.h"
+#include "util.h"
+#include "vsyncapi.h"
+
+
+/* The cycle limit alarm is only armed once the limit is this close, so
+   that the alarm clock can never overflow.  */
+#define BATCHRUN_ALARM_WINDOW 0x100000
+
+int batchrun_enabled;
+
+static int cycle_limit;
+static int exit_pc;
+static int exit_address;
+static int exit_value;
+static int exit_on_jam;
+static char *dump_file = NULL;
+static int dump_start;
+static int dump_end;
+
+static alarm_t *cycle_limit_alarm = NULL;
+
+/* Main CPU cycles thrown away by the clock guard.  */
+static double clk_base;
+static double start_cycles;
+
+static unsigned long last_time;
+static double host_ticks;
+
+/* The exit PC is checked from the monitor trap of the main CPU, so the
+   CPU loop only pays for it in a batch run that has an exit PC set.  */
+static void update_exit_pc_trap(void)
+{
+    if (cycle_limit_alarm == NULL)
+        return;
+
+    if (batchrun_enabled && exit_pc >= 0) {
+        monitor_mask[e_comp_space] |= MI_BATCHEXIT;
+        interrupt_monitor_trap_on(maincpu_int_status);
+    } else if (monitor_mask[e_comp_space] & MI_BATCHEXIT) {
+        monitor_mask[e_comp_space] &= ~MI_BATCHEXIT;
+        if (!monitor_mask[e_comp_space])
+            interrupt_monitor_trap_off(maincpu_int_status);
+    }
+}
+
+static int set_batch_mode(int val, void *param)
+{
+    batchrun_enabled = val ? 1 : 0;
+    raster_drawing_disabled = batchrun_enabled;
+
+    if (batchrun_enabled) {
+        resources_set_int("Sound", 0);
+        resources_set_int("WarpMode", 1);
+    }
+
+    update_exit_pc_trap();
+
+    return 0;
+}
+
+static int set_cycle_limit(int val, void *param)
+{
+    if (val < 0)
+        return -1;
+
+    cycle_limit = val;
+
+    return 0;
+}
+
+static int set_exit_pc(int val, void *param)
+{
+    if (val > 0xffff)
+        return -1;
+
+    /* A negative value disables the check.  */
+    exit_pc = val;
+    update_exit_pc_trap();
+
+    return 0;
+}
+
+static int set_exit_address(int val, void *param)
+{
+    if (val > 0xffff)
+        return -1;
+
+    exit_address = val;
+
+    return 0;
+}
+
+static int set_exit_value(int val, void *param)
+{
+    exit_value = val & 0xff;
+
+    return 0;
+}
+
+static int set_exit_on_jam(int val, void *param)
+{
+    exit_on_jam = val ? 1 : 0;
+
+    return 0;
+}
+
+static int set_dump_file(const char *val, void *param)
+{
+    util_string_set(&dump_file, val);
+
+    return 0;
+}
+
+static int set_dump_start(int val, void *param)
+{
+    if (val < 0 || val > 0xffff)
+        return -1;
+
+    dump_start = val;
+
+    return 0;
+}
+
+static int set_dump_end(int val, void *param)
+{
+    if (val < 0 || val > 0xffff)
+        return -1;
+
+    dump_end = val;
+
+    return 0;
+}
+
+static const resource_string_t resources_string[] = {
+    { "BatchDumpFile", "", RES_EVENT_NO, NULL,
+      &dump_file, set_dump_file, NULL },
+    { NULL }
+};
+
+static const resource_int_t resources_int[] = {
+    { "BatchMode", 0, RES_EVENT_NO, NULL,
+      &batchrun_enabled, set_batch_mode, NULL },
+    { "BatchCycleLimit", 0, RES_EVENT_NO, NULL,
+      &cycle_limit, set_cycle_limit, NULL },
+    { "BatchExitPC", -1, RES_EVENT_NO, NULL,
+      &exit_pc, set_exit_pc, NULL },
+    { "BatchExitAddress", -1, RES_EVENT_NO, NULL,
+      &exit_address, set_exit_address, NULL },
+    { "BatchExitValue", 0, RES_EVENT_NO, NULL,
+      &exit_value, set_exit_value, NULL },
+    { "BatchExitOnJam", 1, RES_EVENT_NO, NULL,
+      &exit_on_jam, set_exit_on_jam, NULL },
+    { "BatchDumpStart", 0x0000, RES_EVENT_NO, NULL,
+      &dump_start, set_dump_start, NULL },
+    { "BatchDumpEnd", 0xffff, RES_EVENT_NO, NULL,
+      &dump_end, set_dump_end, NULL },
+    { NULL }
+};
+
+int batchrun_resources_init(void)
+{
+    if (resources_register_string(resources_string) < 0)
+        return -1;
+
+    return resources_register_int(resources_int);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static const cmdline_option_t cmdline_options[] = {
+    { "-batch", SET_RESOURCE, 0,
+      NULL, NULL, "BatchMode", (resource_value_t)1,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      NULL, T_("Run headless at maximum speed until an exit condition is met") },
+    { "-batchcycles", SET_RESOURCE, 1,
+      NULL, NULL, "BatchCycleLimit", NULL,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      T_("<cycles>"), T_("Exit the batch run after this many main CPU cycles") },
+    { "-batchexitpc", SET_RESOURCE, 1,
+      NULL, NULL, "BatchExitPC", NULL,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      T_("<address>"), T_("Exit the batch run when the main CPU reaches this address") },
+    { "-batchexitaddr", SET_RESOURCE, 1,
+      NULL, NULL, "BatchExitAddress", NULL,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      T_("<address>"), T_("Exit the batch run when this address holds the exit value") },
+    { "-batchexitvalue", SET_RESOURCE, 1,
+      NULL, NULL, "BatchExitValue", NULL,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      T_("<value>"), T_("Value to wait for at the batch exit address") },
+    { "-batchexitjam", SET_RESOURCE, 0,
+      NULL, NULL, "BatchExitOnJam", (resource_value_t)1,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      NULL, T_("Exit the batch run when a CPU jams") },
+    { "+batchexitjam", SET_RESOURCE, 0,
+      NULL, NULL, "BatchExitOnJam", (resource_value_t)0,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      NULL, T_("Do not exit the batch run when a CPU jams") },
+    { "-batchdump", SET_RESOURCE, 1,
+      NULL, NULL, "BatchDumpFile", NULL,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      T_("<name>"), T_("Dump a memory range to this file when the batch run ends") },
+    { "-batchdumpstart", SET_RESOURCE, 1,
+      NULL, NULL, "BatchDumpStart", NULL,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      T_("<address>"), T_("First address of the batch memory dump") },
+    { "-batchdumpend", SET_RESOURCE, 1,
+      NULL, NULL, "BatchDumpEnd", NULL,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      T_("<address>"), T_("Last address of the batch memory dump") },
+    { NULL }
+};
+
+int batchrun_cmdline_options_init(void)
+{
+    return cmdline_register_options(cmdline_options);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static double batchrun_cycles(void)
+{
+    return clk_base + (double)maincpu_clk - start_cycles;
+}
+
+static void batchrun_update_host_time(void)
+{
+    unsigned long now;
+
+    now = vsyncarch_gettime();
+    host_ticks += (double)(signed long)(now - last_time);
+    last_time = now;
+}
+
+static void cycle_limit_alarm_handler(CLOCK offset, void *data)
+{
+    alarm_unset(cycle_limit_alarm);
+    batchrun_exit(BATCHRUN_EXIT_CYCLES, "cycle limit reached");
+}
+
+static void clk_overflow_callback(CLOCK sub, void *data)
+{
+    clk_base += (double)sub;
+}
+
+static void batchrun_check_cycle_limit(void)
+{
+    double remaining;
+
+    if (cycle_limit == 0)
+        return;
+
+    remaining = (double)cycle_limit - batchrun_cycles();
+
+    if (remaining <= 0.0)
+        batchrun_exit(BATCHRUN_EXIT_CYCLES, "cycle limit reached");
+
+    if (remaining <= (double)BATCHRUN_ALARM_WINDOW)
+        alarm_set(cycle_limit_alarm, maincpu_clk + (CLOCK)remaining);
+}
+
+void batchrun_init(void)
+{
+    cycle_limit_alarm = alarm_new(maincpu_alarm_context, "BatchCycleLimit",
+                                  cycle_limit_alarm_handler, NULL);
+    clk_guard_add_callback(maincpu_clk_guard, clk_overflow_callback, NULL);
+
+    clk_base = 0.0;
+    start_cycles = (double)maincpu_clk;
+    host_ticks = 0.0;
+    last_time = vsyncarch_gettime();
+
+    update_exit_pc_trap();
+
+    if (batchrun_enabled)
+        batchrun_check_cycle_limit();
+}
+
+/* Called at the end of every frame instead of the speed and sound
+   synchronization.  */
+void batchrun_vsync(void)
+{
+    batchrun_update_host_time();
+
+    if (exit_address >= 0
+        && mem_bank_peek(0, (WORD)exit_address, NULL) == (BYTE)exit_value)
+        batchrun_exit(BATCHRUN_EXIT_CONDITION, "exit value found");
+
+    batchrun_check_cycle_limit();
+}
+
+/* Called from the monitor trap of the main CPU before every instruction
+   while an exit PC is armed.  */
+void batchrun_check_exit_pc(WORD addr)
+{
+    if (addr == (WORD)exit_pc)
+        batchrun_exit(BATCHRUN_EXIT_CONDITION, "exit PC reached");
+}
+
+void batchrun_check_jam(const char *msg)
+{
+    if (!batchrun_enabled || !exit_on_jam)
+        return;
+
+    printf("%s\n", msg);
+    batchrun_exit(BATCHRUN_EXIT_JAM, "CPU jammed");
+}
+
+static void batchrun_dump_memory(void)
+{
+    FILE *fd;
+    unsigned int addr;
+
+    if (dump_file == NULL || *dump_file == '\0')
+        return;
+
+    fd = fopen(dump_file, MODE_WRITE);
+
+    if (fd == NULL) {
+        printf("Cannot write batch dump file `%s'.\n", dump_file);
+        return;
+    }
+
+    for (addr = (unsigned int)dump_start; addr <= (unsigned int)dump_end; addr++)
+        fputc(mem_bank_peek(0, (WORD)addr, NULL), fd);
+
+    fclose(fd);
+}
+
+void batchrun_exit(int status, const char *reason)
+{
+    double cycles, seconds, speed;
+
+    batchrun_update_host_time();
+    batchrun_dump_memory();
+
+    cycles = batchrun_cycles();
+    seconds = host_ticks / vsyncarch_frequency();
+    speed = seconds > 0.0 ? cycles / seconds : 0.0;
+
+    printf("Batch run finished: %s after %.0f cycles in %.2f s, "
+           "%.0f cycles/s (%.0f%%).\n", reason, cycles, seconds, speed,
+           100.0 * speed / machine_get_cycles_per_second());
+
+    exit(status);
+}
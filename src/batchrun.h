@@ -0,0 +1,44 @@
+/*
+ * batchrun.h - Headless batch mode for unattended program execution.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef VICE_BATCHRUN_H
+#define VICE_BATCHRUN_H
+
+#include "types.h"
+
+/* Process exit status for the different ways a batch run can end.  */
+#define BATCHRUN_EXIT_CONDITION 0
+#define BATCHRUN_EXIT_CYCLES    1
+#define BATCHRUN_EXIT_JAM       2
+
+extern int batchrun_enabled;
+
+extern int batchrun_resources_init(void);
+extern int batchrun_cmdline_options_init(void);
+extern void batchrun_init(void);
+extern void batchrun_vsync(void);
+extern void batchrun_check_exit_pc(WORD addr);
+extern void batchrun_check_jam(const char *msg);
+extern void batchrun_exit(int status, const char *reason);
+
+#endif
@@ -254,6 +254,23 @@ void mem_set_bank_pointer(BYTE **base, int *limit)
     bank_limit = limit;
 }
 
+/* Return a pointer to `addr' if the page is plain RAM for reading or, if
+   `store' is set, writing; the pointer is valid up to the end of the page.
+   Return NULL if the access could have any side effect.  Used by DMA
+   devices to copy whole blocks.  */
+BYTE *mem_dma_ram_ptr(WORD addr, int store)
+{
+    if (store) {
+        if (_mem_write_tab_ptr[addr >> 8] != ram_store)
+            return NULL;
+    } else {
+        if (_mem_read_tab_ptr[addr >> 8] != ram_read)
+            return NULL;
+    }
+
+    return ram_bank + addr;
+}
+
 /* Change the current video bank.  Call this routine only when the vbank
    has really changed.  */
 void mem_set_vbank(int new_vbank)
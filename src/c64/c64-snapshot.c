@@ -53,15 +53,9 @@
 #define SNAP_MAJOR 1
 #define SNAP_MINOR 1
 
-int c64_snapshot_write(const char *name, int save_roms, int save_disks, int event_mode)
+static int c64_snapshot_write_snapshot(snapshot_t *s, int save_roms,
+                                       int save_disks, int event_mode)
 {
-    snapshot_t *s;
-
-    s = snapshot_create(name, ((BYTE)(SNAP_MAJOR)), ((BYTE)(SNAP_MINOR)), machine_get_name());
-    if (s == NULL) {
-        return -1;
-    }
-
     sound_snapshot_prepare();
 
     /* Execute drive CPUs to get in sync with the main CPU.  */
@@ -79,6 +73,22 @@ int c64_snapshot_write(const char *name, int save_roms, int save_disks, int even
         || tape_snapshot_write_module(s, save_disks) < 0
         || keyboard_snapshot_write_module(s)
         || joystick_snapshot_write_module(s)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+int c64_snapshot_write(const char *name, int save_roms, int save_disks, int event_mode)
+{
+    snapshot_t *s;
+
+    s = snapshot_create(name, ((BYTE)(SNAP_MAJOR)), ((BYTE)(SNAP_MINOR)), machine_get_name());
+    if (s == NULL) {
+        return -1;
+    }
+
+    if (c64_snapshot_write_snapshot(s, save_roms, save_disks, event_mode) < 0) {
         snapshot_close(s);
         ioutil_remove(name);
         return -1;
@@ -88,16 +98,27 @@ int c64_snapshot_write(const char *name, int save_roms, int save_disks, int even
     return 0;
 }
 
-int c64_snapshot_read(const char *name, int event_mode)
+int c64_snapshot_write_memory(BYTE **data, size_t *size, int save_roms, int save_disks, int event_mode)
 {
     snapshot_t *s;
-    BYTE minor, major;
 
-    s = snapshot_open(name, &major, &minor, machine_get_name());
+    s = snapshot_memory_create(((BYTE)(SNAP_MAJOR)), ((BYTE)(SNAP_MINOR)), machine_get_name());
     if (s == NULL) {
         return -1;
     }
 
+    if (c64_snapshot_write_snapshot(s, save_roms, save_disks, event_mode) < 0) {
+        snapshot_close(s);
+        return -1;
+    }
+
+    *data = snapshot_memory_release(s, size);
+    snapshot_close(s);
+    return 0;
+}
+
+static int c64_snapshot_read_snapshot(snapshot_t *s, BYTE major, BYTE minor, int event_mode)
+{
     if (major != SNAP_MAJOR || minor != SNAP_MINOR)
     {
     	#ifdef CELL_DEBUG
@@ -130,11 +151,35 @@ int c64_snapshot_read(const char *name, int event_mode)
     return 0;
 
 fail:
-    if (s != NULL) {
-        snapshot_close(s);
-    }
+    snapshot_close(s);
 
     machine_trigger_reset(MACHINE_RESET_MODE_SOFT);
 
     return -1;
 }
+
+int c64_snapshot_read(const char *name, int event_mode)
+{
+    snapshot_t *s;
+    BYTE minor, major;
+
+    s = snapshot_open(name, &major, &minor, machine_get_name());
+    if (s == NULL) {
+        return -1;
+    }
+
+    return c64_snapshot_read_snapshot(s, major, minor, event_mode);
+}
+
+int c64_snapshot_read_memory(const BYTE *data, size_t size, int event_mode)
+{
+    snapshot_t *s;
+    BYTE minor, major;
+
+    s = snapshot_memory_open(data, size, &major, &minor, machine_get_name());
+    if (s == NULL) {
+        return -1;
+    }
+
+    return c64_snapshot_read_snapshot(s, major, minor, event_mode);
+}
@@ -27,7 +27,13 @@
 #ifndef VICE_C64_SNAPSHOT_H
 #define VICE_C64_SNAPSHOT_H
 
+#include <stddef.h>
+
+#include "types.h"
+
 extern int c64_snapshot_write(const char *name, int save_roms, int save_disks, int event_mode);
 extern int c64_snapshot_read(const char *name, int event_mode);
+extern int c64_snapshot_write_memory(BYTE **data, size_t *size, int save_roms, int save_disks, int event_mode);
+extern int c64_snapshot_read_memory(const BYTE *data, size_t size, int event_mode);
  
 #endif
@@ -647,6 +647,16 @@ int machine_read_snapshot(const char *name, int event_mode)
 	return c64_snapshot_read(name, event_mode);
 }
 
+int machine_write_snapshot_memory(BYTE **data, size_t *size, int save_roms, int save_disks, int event_mode)
+{
+	return c64_snapshot_write_memory(data, size, save_roms, save_disks, event_mode);
+}
+
+int machine_read_snapshot_memory(const BYTE *data, size_t size, int event_mode)
+{
+	return c64_snapshot_read_memory(data, size, event_mode);
+}
+
 /* ------------------------------------------------------------------------- */
 
 int machine_autodetect_psid(const char *name)
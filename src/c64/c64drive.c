@@ -104,6 +104,11 @@ void machine_drive_vsync_hook(void)
     iec_drive_vsync_hook();
 }
 
+CLOCK machine_drive_disk_change_clk(unsigned int dnr)
+{
+    return iec_drive_disk_change_clk(dnr);
+}
+
 void machine_drive_rom_load(void)
 {
     iec_drive_rom_load();
@@ -138,9 +138,30 @@ static void REGPARM2 store_watch(WORD addr, BYTE value)
     mem_write_tab[vbank][mem_config][addr >> 8](addr, value);
 }
 
+/* Only the pages holding a watchpoint go through the watch handlers, the
+   others use the tables of the current configuration.  */
+static void mem_update_watch_tabs(void)
+{
+    int i;
+
+    for (i = 0; i <= 0x100; i++) {
+        if (monitor_watch_page_load(e_comp_space, i)) {
+            mem_read_tab_watch[i] = read_watch;
+        } else {
+            mem_read_tab_watch[i] = mem_read_tab[mem_config][i];
+        }
+        if (monitor_watch_page_store(e_comp_space, i)) {
+            mem_write_tab_watch[i] = store_watch;
+        } else {
+            mem_write_tab_watch[i] = mem_write_tab[vbank][mem_config][i];
+        }
+    }
+}
+
 void mem_toggle_watchpoints(int flag, void *context)
 {
     if (flag) {
+        mem_update_watch_tabs();
         _mem_read_tab_ptr = mem_read_tab_watch;
         _mem_write_tab_ptr = mem_write_tab_watch;
     } else {
@@ -198,6 +219,7 @@ void mem_pla_config_changed(void)
     c64pla_config_changed(tape_sense, 1, 0x17);
 
     if (any_watchpoints(e_comp_space)) {
+        mem_update_watch_tabs();
         _mem_read_tab_ptr = mem_read_tab_watch;
         _mem_write_tab_ptr = mem_write_tab_watch;
     } else {
@@ -618,11 +640,6 @@ void mem_initialize_memory(void)
     mem_limit_init(mem_read_limit_tab);
 
     /* Default is RAM.  */
-    for (i = 0; i <= 0x100; i++) {
-        mem_read_tab_watch[i] = read_watch;
-        mem_write_tab_watch[i] = store_watch;
-    }
-
     for (i = 0; i < NUM_CONFIGS; i++) {
         mem_set_write_hook(i, 0, zero_store);
         mem_read_tab[i][0] = zero_read;
@@ -729,6 +746,8 @@ void mem_set_vbank(int new_vbank)
     /* Do not override watchpoints on vbank switches.  */
     if (_mem_write_tab_ptr != mem_write_tab_watch) {
         _mem_write_tab_ptr = mem_write_tab[new_vbank][mem_config];
+    } else {
+        mem_update_watch_tabs();
     }
 
     vicii_set_vbank(new_vbank);
@@ -747,6 +766,23 @@ void mem_set_bank_pointer(BYTE **base, int *limit)
     bank_limit = limit;
 }
 
+/* Return a pointer to `addr' if the page is plain RAM for reading or, if
+   `store' is set, writing; the pointer is valid up to the end of the page.
+   Return NULL if the access could have any side effect.  Used by DMA
+   devices to copy whole blocks.  */
+BYTE *mem_dma_ram_ptr(WORD addr, int store)
+{
+    if (store) {
+        if (_mem_write_tab_ptr[addr >> 8] != ram_store)
+            return NULL;
+    } else {
+        if (_mem_read_tab_ptr[addr >> 8] != ram_read)
+            return NULL;
+    }
+
+    return mem_ram + addr;
+}
+
 /* ------------------------------------------------------------------------- */
 
 /* FIXME: this part needs to be checked.  */
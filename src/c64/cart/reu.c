@@ -58,6 +58,7 @@
 #include "translate.h"
 #include "types.h"
 #include "util.h"
+#include "vicii.h"
 
 #if 0
 #define REU_DEBUG 1 /*!< define this if you want to get debugging output for the REU. */
@@ -983,6 +984,110 @@ inline static BYTE read_from_reu(unsigned int reu_addr)
 
 /* ------------------------------------------------------------------------- */
 
+/*! \brief number of bytes a DMA operation can move in one block
+  A block must not cross a page of the host and must end before the
+  VIC-II needs to be served again, so that no byte of it could steal
+  cycles or see a different memory configuration.
+
+  \param host_addr
+    The host (computer) address where the block starts
+
+  \param host_step
+    The increment to use for the host address; must be either 0 or 1
+
+  \param len
+    The remaining transfer length of the operation
+
+  \return
+    The length of the block; 0 if the next byte must be moved the
+    exact way.
+*/
+static int reu_dma_block_len(WORD host_addr, int host_step, int len)
+{
+	CLOCK next_clk;
+	int n = len;
+
+	/* x64sc checks BA for every single byte */
+	if (reu_ba.enabled)
+		return 0;
+
+	next_clk = vicii_get_next_pending_clk();
+	if (next_clk <= maincpu_clk + 1)
+		return 0;
+
+	if ((CLOCK)n > next_clk - maincpu_clk - 1)
+		n = (int)(next_clk - maincpu_clk - 1);
+
+	if (host_step && n > 0x100 - (host_addr & 0xff))
+		n = 0x100 - (host_addr & 0xff);
+
+	return n;
+}
+
+/*! \brief check if a block of the REU can be accessed as one array
+
+  \return
+     non-zero if the `n' bytes starting at `reu_addr' are backed by DRAM
+     and there is no wrap around before the last one.
+*/
+inline static int reu_is_linear(unsigned int reu_addr, int reu_step, int n)
+{
+	return reu_step
+	       && reu_addr + n <= rec_options.special_wrap_around_1700
+	       && reu_addr + n <= rec_options.wrap_around
+	       && reu_addr + n <= rec_options.not_backedup_addresses;
+}
+
+/*! \brief copy a block from plain host RAM to the REU
+
+  \return
+     The REU address after the block
+*/
+static unsigned int reu_dma_block_to_reu(const BYTE *host, int host_step, unsigned int reu_addr, int reu_step, int n)
+{
+	int i;
+
+	if (host_step && reu_is_linear(reu_addr, reu_step, n))
+	{
+		memcpy(reu_ram + reu_addr, host, n);
+		return increment_reu_with_wrap_around(reu_addr + n - 1, 1);
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		store_to_reu(reu_addr, *host);
+		host += host_step;
+		reu_addr = increment_reu_with_wrap_around(reu_addr, reu_step);
+	}
+
+	return reu_addr;
+}
+
+/*! \brief copy a block from the REU to plain host RAM
+
+  \return
+     The REU address after the block
+*/
+static unsigned int reu_dma_block_to_host(BYTE *host, int host_step, unsigned int reu_addr, int reu_step, int n)
+{
+	int i;
+
+	if (host_step && reu_is_linear(reu_addr, reu_step, n))
+	{
+		memcpy(host, reu_ram + reu_addr, n);
+		return increment_reu_with_wrap_around(reu_addr + n - 1, 1);
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		*host = read_from_reu(reu_addr);
+		host += host_step;
+		reu_addr = increment_reu_with_wrap_around(reu_addr, reu_step);
+	}
+
+	return reu_addr;
+}
+
 /*! \brief update the REU registers after a DMA operation
 
   \param host_addr
@@ -1072,10 +1177,23 @@ static void reu_dma_update_regs(WORD host_addr, unsigned int reu_addr, int len,
 static void reu_dma_host_to_reu(WORD host_addr, unsigned int reu_addr, int host_step, int reu_step, int len)
 {
 	BYTE value;
+	BYTE *host;
+	int n;
 	//DEBUG_LOG(DEBUG_LEVEL_TRANSFER_HIGH_LEVEL, (reu_log, "copy ext $%05X %s<= main $%04X%s, $%04X (%d) bytes.",reu_addr, reu_step ? "" : "(fixed) ", host_addr, host_step ? "" : " (fixed)", len, len));
 
 	while (len)
 	{
+		/* plain RAM and nothing to serve: move a whole block */
+		n = reu_dma_block_len(host_addr, host_step, len);
+		if (n > 0 && (host = mem_dma_ram_ptr(host_addr, 0)) != NULL)
+		{
+			reu_addr = reu_dma_block_to_reu(host, host_step, reu_addr, reu_step, n);
+			maincpu_clk += n;
+			host_addr = (host_addr + host_step * n) & 0xffff;
+			len -= n;
+			continue;
+		}
+
 		reu_clk_inc_pre();
 		machine_handle_pending_alarms(0);
 		value = mem_read(host_addr);
@@ -1111,10 +1229,23 @@ static void reu_dma_host_to_reu(WORD host_addr, unsigned int reu_addr, int host_
 static void reu_dma_reu_to_host(WORD host_addr, unsigned int reu_addr, int host_step, int reu_step, int len)
 {
 	BYTE value;
+	BYTE *host;
+	int n;
 	//DEBUG_LOG(DEBUG_LEVEL_TRANSFER_HIGH_LEVEL, (reu_log, "copy ext $%05X %s=> main $%04X%s, $%04X (%d) bytes.", reu_addr, reu_step ? "" : "(fixed) ", host_addr, host_step ? "" : " (fixed)", len, len));
 
 	while (len)
 	{
+		/* plain RAM and nothing to serve: move a whole block */
+		n = reu_dma_block_len(host_addr, host_step, len);
+		if (n > 0 && (host = mem_dma_ram_ptr(host_addr, 1)) != NULL)
+		{
+			reu_addr = reu_dma_block_to_host(host, host_step, reu_addr, reu_step, n);
+			maincpu_clk += n;
+			host_addr = (host_addr + host_step * n) & 0xffff;
+			len -= n;
+			continue;
+		}
+
 		//DEBUG_LOG(DEBUG_LEVEL_TRANSFER_LOW_LEVEL, (reu_log, "Transferring byte: %x from ext $%05X to main $%04X.", reu_ram[reu_addr % reu_size], reu_addr, host_addr));
 		reu_clk_inc_pre();
 		value = read_from_reu(reu_addr);
@@ -59,16 +59,9 @@
 #define SNAP_MAJOR 1
 #define SNAP_MINOR 1
 
-int c64dtv_snapshot_write(const char *name, int save_roms, int save_disks,
-                       int event_mode)
+static int c64dtv_snapshot_write_snapshot(snapshot_t *s, int save_roms,
+                                          int save_disks, int event_mode)
 {
-    snapshot_t *s;
-
-    s = snapshot_create(name, ((BYTE)(SNAP_MAJOR)), ((BYTE)(SNAP_MINOR)),
-                        machine_name);
-    if (s == NULL)
-        return -1;
-
     sound_snapshot_prepare();
 
     /* Execute drive CPUs to get in sync with the main CPU.  */
@@ -87,24 +80,55 @@ int c64dtv_snapshot_write(const char *name, int save_roms, int save_disks,
         || event_snapshot_write_module(s, event_mode) < 0
         || keyboard_snapshot_write_module(s)
         || joystick_snapshot_write_module(s)) {
-        snapshot_close(s);
-        ioutil_remove(name);
         return -1;
     }
 
-    snapshot_close(s);
     return 0;
 }
 
-int c64dtv_snapshot_read(const char *name, int event_mode)
+int c64dtv_snapshot_write(const char *name, int save_roms, int save_disks,
+                       int event_mode)
 {
     snapshot_t *s;
-    BYTE minor, major;
+    int retval;
 
-    s = snapshot_open(name, &major, &minor, machine_name);
+    s = snapshot_create(name, ((BYTE)(SNAP_MAJOR)), ((BYTE)(SNAP_MINOR)),
+                        machine_name);
+    if (s == NULL)
+        return -1;
+
+    retval = c64dtv_snapshot_write_snapshot(s, save_roms, save_disks, event_mode);
+    snapshot_close(s);
+
+    if (retval != 0)
+        ioutil_remove(name);
+
+    return retval;
+}
+
+int c64dtv_snapshot_write_memory(BYTE **data, size_t *size, int save_roms,
+                                 int save_disks, int event_mode)
+{
+    snapshot_t *s;
+
+    s = snapshot_memory_create(((BYTE)(SNAP_MAJOR)), ((BYTE)(SNAP_MINOR)),
+                               machine_name);
     if (s == NULL)
         return -1;
 
+    if (c64dtv_snapshot_write_snapshot(s, save_roms, save_disks, event_mode) != 0) {
+        snapshot_close(s);
+        return -1;
+    }
+
+    *data = snapshot_memory_release(s, size);
+    snapshot_close(s);
+    return 0;
+}
+
+static int c64dtv_snapshot_read_snapshot(snapshot_t *s, BYTE major, BYTE minor,
+                                         int event_mode)
+{
     if (major != SNAP_MAJOR || minor != SNAP_MINOR) {
         log_error(LOG_DEFAULT,
                   "Snapshot version (%d.%d) not valid: expecting %d.%d.",
@@ -143,3 +167,27 @@ fail:
 
     return -1;
 }
+
+int c64dtv_snapshot_read(const char *name, int event_mode)
+{
+    snapshot_t *s;
+    BYTE minor, major;
+
+    s = snapshot_open(name, &major, &minor, machine_name);
+    if (s == NULL)
+        return -1;
+
+    return c64dtv_snapshot_read_snapshot(s, major, minor, event_mode);
+}
+
+int c64dtv_snapshot_read_memory(const BYTE *data, size_t size, int event_mode)
+{
+    snapshot_t *s;
+    BYTE minor, major;
+
+    s = snapshot_memory_open(data, size, &major, &minor, machine_name);
+    if (s == NULL)
+        return -1;
+
+    return c64dtv_snapshot_read_snapshot(s, major, minor, event_mode);
+}
@@ -58,16 +58,9 @@
 #define SNAP_MINOR          0
 
 
-int cbm2_snapshot_write(const char *name, int save_roms, int save_disks,
-                        int event_mode)
+static int cbm2_snapshot_write_snapshot(snapshot_t *s, int save_roms,
+                                        int save_disks, int event_mode)
 {
-    snapshot_t *s;
-
-    s = snapshot_create(name, SNAP_MAJOR, SNAP_MINOR, machine_get_name());
-
-    if (s == NULL)
-        return -1;
-
     sound_snapshot_prepare();
 
     if (maincpu_snapshot_write_module(s) < 0
@@ -85,25 +78,53 @@ int cbm2_snapshot_write(const char *name, int save_roms, int save_disks,
         || tape_snapshot_write_module(s, save_disks) < 0
         || keyboard_snapshot_write_module(s)
         || joystick_snapshot_write_module(s)) {
-        snapshot_close(s);
-        ioutil_remove(name);
         return -1;
     }
 
-    snapshot_close(s);
     return 0;
 }
 
-int cbm2_snapshot_read(const char *name, int event_mode)
+int cbm2_snapshot_write(const char *name, int save_roms, int save_disks,
+                        int event_mode)
 {
     snapshot_t *s;
-    BYTE minor, major;
+    int retval;
 
-    s = snapshot_open(name, &major, &minor, machine_get_name());
+    s = snapshot_create(name, SNAP_MAJOR, SNAP_MINOR, machine_get_name());
+    if (s == NULL)
+        return -1;
+
+    retval = cbm2_snapshot_write_snapshot(s, save_roms, save_disks, event_mode);
+    snapshot_close(s);
 
+    if (retval != 0)
+        ioutil_remove(name);
+
+    return retval;
+}
+
+int cbm2_snapshot_write_memory(BYTE **data, size_t *size, int save_roms,
+                               int save_disks, int event_mode)
+{
+    snapshot_t *s;
+
+    s = snapshot_memory_create(SNAP_MAJOR, SNAP_MINOR, machine_get_name());
     if (s == NULL)
         return -1;
 
+    if (cbm2_snapshot_write_snapshot(s, save_roms, save_disks, event_mode) != 0) {
+        snapshot_close(s);
+        return -1;
+    }
+
+    *data = snapshot_memory_release(s, size);
+    snapshot_close(s);
+    return 0;
+}
+
+static int cbm2_snapshot_read_snapshot(snapshot_t *s, BYTE major, BYTE minor,
+                                       int event_mode)
+{
     if (major != SNAP_MAJOR || minor != SNAP_MINOR) {
         log_error(LOG_DEFAULT,
                   "Snapshot version (%d.%d) not valid: expecting %d.%d.",
@@ -131,6 +152,8 @@ int cbm2_snapshot_read(const char *name, int event_mode)
         || joystick_snapshot_read_module(s) < 0)
         goto fail;
 
+    snapshot_close(s);
+
     sound_snapshot_finish();
 
     return 0;
@@ -144,4 +167,28 @@ fail:
     return -1;
 }
 
+int cbm2_snapshot_read(const char *name, int event_mode)
+{
+    snapshot_t *s;
+    BYTE minor, major;
+
+    s = snapshot_open(name, &major, &minor, machine_get_name());
+    if (s == NULL)
+        return -1;
+
+    return cbm2_snapshot_read_snapshot(s, major, minor, event_mode);
+}
+
+int cbm2_snapshot_read_memory(const BYTE *data, size_t size, int event_mode)
+{
+    snapshot_t *s;
+    BYTE minor, major;
+
+    s = snapshot_memory_open(data, size, &major, &minor, machine_get_name());
+    if (s == NULL)
+        return -1;
+
+    return cbm2_snapshot_read_snapshot(s, major, minor, event_mode);
+}
+
 
@@ -88,6 +88,11 @@ void machine_drive_vsync_hook(void)
 {
 }
 
+CLOCK machine_drive_disk_change_clk(unsigned int dnr)
+{
+    return (CLOCK)0;
+}
+
 void machine_drive_rom_load(void)
 {
     ieee_drive_rom_load();
@@ -36,6 +36,7 @@
 #include "cmdline.h"
 #include "datasette.h"
 #include "event.h"
+#include "lib.h"
 //#include "log.h"
 #include "machine.h"
 #include "maincpu.h"
@@ -49,7 +50,9 @@
 
 
 #define MOTOR_DELAY         32000
-#define TAP_BUFFER_LENGTH   100000
+
+/* number of gaps between two entries of the tape index */
+#define DATASETTE_INDEX_STEP 1024
 
 /* at least every DATASETTE_MAX_GAP cycle there should be an alarm */ 
 #define DATASETTE_MAX_GAP   100000
@@ -58,12 +61,38 @@
 /* Attached TAP tape image.  */
 static tap_t *current_image = NULL;
 
-/* Buffer for the TAP */
-static BYTE tap_buffer[TAP_BUFFER_LENGTH];
+/* The whole TAP is kept in memory; tap_buffer[next_tap] is the byte at
+   current_file_seek_position.  */
+static BYTE *tap_buffer = NULL;
 
 /* Pointer and length of the tap-buffer */
 static long next_tap, last_tap;
 
+/* Has the buffer to be read (again) from the image?  */
+static int tap_buffer_invalid = 1;
+
+/* Every DATASETTE_INDEX_STEP gaps, the position in the file and the tape
+   counter.  Fast forward and rewind jump from entry to entry in warp
+   mode.  */
+typedef struct datasette_index_s {
+    long file_seek_position;
+    int cycle_counter;
+} datasette_index_t;
+
+static datasette_index_t *tap_index = NULL;
+static unsigned int tap_index_num = 0;
+
+/* File position at the other end of the index jump being wound, -1 if
+   none, and the length of that jump.  */
+static long datasette_jump_other_end = -1;
+static CLOCK datasette_jump_gap;
+
+/* Copy of the `WarpMode' resource.  */
+static int datasette_warp = 0;
+
+/* Counter value shown by the UI.  */
+static int datasette_displayed_counter = -1;
+
 /* State of the datasette motor.  */
 static int datasette_motor = 0;
 
@@ -200,7 +229,10 @@ static void datasette_update_ui_counter(void)
                              / (datasette_cycles_per_second / 8.0)
                              * ds_c1) + ds_c2)- ds_c3))) % 1000;
 
-    ui_display_tape_counter(current_image->counter);
+    if (current_image->counter != datasette_displayed_counter) {
+        datasette_displayed_counter = current_image->counter;
+        ui_display_tape_counter(current_image->counter);
+    }
 }
 
 
@@ -217,45 +249,48 @@ void datasette_reset_counter(void)
 }
 
 
-inline static int datasette_move_buffer_forward(int offset)
+static int datasette_load_buffer(void)
 {
-    /* reads buffer to fit the next gap-read
-       tap_buffer[next_tap] ~ current_file_seek_position
-    */
-    if (next_tap + offset >= last_tap) {
-        if (fseek(current_image->fd, current_image->current_file_seek_position
-            + current_image->offset, SEEK_SET)) {
-            //log_error(datasette_log,"Cannot read in tap-file.");
-            return 0;
-        }
-        last_tap = (long)fread(tap_buffer, 1, TAP_BUFFER_LENGTH, current_image->fd);
-        next_tap = 0;
-        if (next_tap >= last_tap)
-            return 0;
+    lib_free(tap_buffer);
+    tap_buffer = NULL;
+    last_tap = 0;
+
+    if (current_image->size <= 0)
+        return 0;
+
+    tap_buffer = lib_malloc((size_t)current_image->size);
+
+    if (fseek(current_image->fd, current_image->offset, SEEK_SET)) {
+        //log_error(datasette_log,"Cannot read in tap-file.");
+        return 0;
     }
+    last_tap = (long)fread(tap_buffer, 1, (size_t)current_image->size,
+                           current_image->fd);
+    tap_buffer_invalid = 0;
+
     return 1;
 }
 
+inline static int datasette_move_buffer_forward(int offset)
+{
+    /* tap_buffer[next_tap] ~ current_file_seek_position */
+    if (tap_buffer_invalid && !datasette_load_buffer())
+        return 0;
+
+    next_tap = current_image->current_file_seek_position;
+
+    return next_tap < last_tap;
+}
+
 inline static int datasette_move_buffer_back(int offset)
 {
-    /* reads buffer to fit the next gap-read at current_file_seek_position-1
-       tap_buffer[next_tap] ~ current_file_seek_position
-    */
-    if (next_tap+offset < 0) {
-        if (current_image->current_file_seek_position >= TAP_BUFFER_LENGTH)
-            next_tap = TAP_BUFFER_LENGTH;
-        else
-            next_tap = current_image->current_file_seek_position;
-        if (fseek(current_image->fd, current_image->current_file_seek_position
-            - next_tap + current_image->offset, SEEK_SET)) {
-            //log_error(datasette_log,"Cannot read in tap-file.");
-            return 0;
-        }
-        last_tap = (long)fread(tap_buffer, 1, TAP_BUFFER_LENGTH, current_image->fd);
-        if (next_tap > last_tap)
-            return 0;
-    }
-    return 1;
+    /* tap_buffer[next_tap] ~ current_file_seek_position */
+    if (tap_buffer_invalid && !datasette_load_buffer())
+        return 0;
+
+    next_tap = current_image->current_file_seek_position;
+
+    return next_tap <= last_tap;
 }
 
 inline static int fetch_gap(CLOCK *gap, int *direction, long read_tap)
@@ -430,11 +465,77 @@ static CLOCK datasette_read_gap(int direction)
 }
 
 
+/* Binary search the index for the current position.  */
+static int datasette_index_find(long file_seek_position)
+{
+    int lo = 0, hi = (int)tap_index_num - 1, mid;
+
+    while (lo <= hi) {
+        mid = (lo + hi) / 2;
+        if (tap_index[mid].file_seek_position == file_seek_position)
+            return mid;
+        if (tap_index[mid].file_seek_position < file_seek_position)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+
+    return -1;
+}
+
+/* Wind the tape to the neighbouring index entry in one go, if the tape
+   is exactly at an entry.  Return the gap wound over, 0 if the tape has to
+   be wound gap by gap.  Like a long gap, the jump is then split into
+   alarms of at most DATASETTE_MAX_GAP cycles that advance the counter.  */
+static CLOCK datasette_index_jump(int direction)
+{
+    int i;
+    CLOCK gap;
+
+    if (fullwave || datasette_long_gap_pending
+        || direction + datasette_last_direction == 0)
+        return 0;
+
+    i = datasette_index_find(current_image->current_file_seek_position);
+    if (i < 0 || i + direction < 0 || i + direction >= (int)tap_index_num)
+        return 0;
+
+    i += direction;
+    gap = (CLOCK)(direction * (tap_index[i].cycle_counter
+                               - current_image->cycle_counter)) * 8;
+    if (gap == 0)
+        return 0;
+
+    datasette_jump_other_end = current_image->current_file_seek_position;
+    datasette_jump_gap = gap;
+    current_image->current_file_seek_position = tap_index[i].file_seek_position;
+
+    return gap;
+}
+
+/* The direction changed while winding over an index jump: go back to the
+   other end of the jump and return its length.  */
+static CLOCK datasette_index_jump_back(void)
+{
+    long position;
+
+    position = current_image->current_file_seek_position;
+    current_image->current_file_seek_position = datasette_jump_other_end;
+    datasette_jump_other_end = position;
+
+    return datasette_jump_gap;
+}
+
+static void datasette_warp_changed(const char *name, void *param)
+{
+    resources_get_int(name, &datasette_warp);
+}
+
 static void datasette_read_bit(CLOCK offset, void *data)
 {
     double speed_of_tape = DS_V_PLAY;
     int direction = 1;
-    long gap;
+    long gap = 0;
 
     alarm_unset(datasette_alarm);
     datasette_alarm_pending = 0;
@@ -484,20 +585,32 @@ static void datasette_read_bit(CLOCK offset, void *data)
         return;
     }
 
-    if (direction + datasette_last_direction == 0) {
-        /* the direction changed; read the gap from file,
-        but use use only the elapsed gap */
-        gap = datasette_read_gap(direction);
-        datasette_long_gap_pending = datasette_long_gap_elapsed;
-        datasette_long_gap_elapsed = gap - datasette_long_gap_elapsed;
-    }
-    if (datasette_long_gap_pending) {
-        gap = datasette_long_gap_pending;
-        datasette_long_gap_pending = 0;
+    /* While warping, fast forward and rewind use the index.  */
+    if (datasette_warp && current_image->mode != DATASETTE_CONTROL_START)
+        gap = (long)datasette_index_jump(direction);
+
+    if (gap) {
+        datasette_long_gap_elapsed = 0;
     } else {
-        gap = datasette_read_gap(direction);
-        if (gap)
-            datasette_long_gap_elapsed = 0;
+        if (direction + datasette_last_direction == 0) {
+            /* the direction changed; read the gap from file,
+            but use use only the elapsed gap */
+            if (datasette_jump_other_end >= 0)
+                gap = (long)datasette_index_jump_back();
+            else
+                gap = datasette_read_gap(direction);
+            datasette_long_gap_pending = datasette_long_gap_elapsed;
+            datasette_long_gap_elapsed = gap - datasette_long_gap_elapsed;
+        }
+        if (datasette_long_gap_pending) {
+            gap = datasette_long_gap_pending;
+            datasette_long_gap_pending = 0;
+        } else {
+            datasette_jump_other_end = -1;
+            gap = datasette_read_gap(direction);
+            if (gap)
+                datasette_long_gap_elapsed = 0;
+        }
     }
     if (!gap) {
         datasette_control(DATASETTE_CONTROL_STOP);
@@ -553,26 +666,55 @@ void datasette_init(void)
         //log_error(datasette_log, "Cannot get cycles per second for this machine.");
         datasette_cycles_per_second = 985248;
     }
+
+    resources_register_callback("WarpMode", datasette_warp_changed, NULL);
+    resources_get_int("WarpMode", &datasette_warp);
 }
 
 void datasette_set_tape_image(tap_t *image)
 {
     CLOCK gap;
+    unsigned int gaps, index_size;
 
     current_image = image;
     last_tap = next_tap = 0;
+    tap_buffer_invalid = 1;
+    lib_free(tap_buffer);
+    tap_buffer = NULL;
+    lib_free(tap_index);
+    tap_index = NULL;
+    tap_index_num = 0;
+    datasette_displayed_counter = -1;
     datasette_internal_reset();
 
     if (image != NULL) {
-        /* We need the length of tape for realistic counter. */
+        /* We need the length of tape for realistic counter; build the
+           index on the way. */
+        index_size = 64;
+        tap_index = lib_malloc(index_size * sizeof(datasette_index_t));
         current_image->cycle_counter_total = 0;
+        gaps = 0;
         do {
+            if (gaps % DATASETTE_INDEX_STEP == 0 && !fullwave) {
+                if (tap_index_num == index_size) {
+                    index_size *= 2;
+                    tap_index = lib_realloc(tap_index, index_size
+                                            * sizeof(datasette_index_t));
+                }
+                tap_index[tap_index_num].file_seek_position
+                    = current_image->current_file_seek_position;
+                tap_index[tap_index_num].cycle_counter
+                    = current_image->cycle_counter_total;
+                tap_index_num++;
+            }
             gap = datasette_read_gap(1);
             current_image->cycle_counter_total += gap / 8;
+            gaps++;
         } while (gap);
         current_image->current_file_seek_position = 0;
         last_tap = next_tap = 0;
         fullwave = 0;
+        datasette_jump_other_end = -1;
     } else {
         datasette_set_tape_sense(0);
     }
@@ -621,6 +763,7 @@ static void datasette_internal_reset(void)
         datasette_long_gap_pending = 0;
         datasette_long_gap_elapsed = 0;
         datasette_last_direction = 0;
+        datasette_jump_other_end = -1;
         motor_stop_clk = 0;
         datasette_update_ui_counter();
         fullwave = 0;
@@ -712,8 +855,6 @@ static void datasette_control_internal(int command)
             break;
         }
         ui_display_tape_control_status(current_image->mode);
-        /* clear the tap-buffer */
-        last_tap = next_tap = 0;
     }
 }
 
@@ -797,6 +938,13 @@ inline static void bit_write(void)
     if (current_image->size < current_image->current_file_seek_position)
         current_image->size = current_image->current_file_seek_position;
 
+    /* Read the tape again before playing it and forget the index entries
+       behind the recorded part.  */
+    tap_buffer_invalid = 1;
+    while (tap_index_num > 0 && tap_index[tap_index_num - 1].file_seek_position
+           >= current_image->current_file_seek_position - 4)
+        tap_index_num--;
+
     current_image->cycle_counter += write_time / 8;
 
     /* Correct for C16 TAPs so the counter is the same during record/play */
@@ -902,6 +1050,9 @@ int datasette_read_snapshot(snapshot_t *s)
         return -1;
     }
 
+    /* Winding back over an interrupted index jump is not saved.  */
+    datasette_jump_other_end = -1;
+
     if (datasette_alarm_pending)
         alarm_set(datasette_alarm, alarm_clk);
     else
@@ -921,6 +1072,7 @@ int datasette_read_snapshot(snapshot_t *s)
 
     /* reset buffer */
     next_tap = last_tap = 0;
+    tap_buffer_invalid = 1;
 
     snapshot_module_close(m);
     return 0;
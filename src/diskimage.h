@@ -100,6 +100,7 @@ extern int disk_image_read_sector(disk_image_t *image, BYTE *buf,
                                   unsigned int track, unsigned int sector);
 extern int disk_image_write_sector(disk_image_t *image, BYTE *buf,
                                    unsigned int track, unsigned int sector);
+extern int disk_image_flush(disk_image_t *image);
 extern int disk_image_check_sector(disk_image_t *image, unsigned int track,
                                    unsigned int sector);
 extern unsigned int disk_image_sector_per_track(unsigned int format,
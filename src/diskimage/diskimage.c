@@ -508,6 +508,15 @@ int disk_image_write_sector(disk_image_t *image, BYTE *buf, unsigned int track,
 	return rc;
 }
 
+/* Write back sectors that are only buffered in memory.  */
+int disk_image_flush(disk_image_t *image)
+{
+	if (image == NULL || image->device != DISK_IMAGE_DEVICE_FS)
+		return 0;
+
+	return fsimage_flush(image);
+}
+
 /*-----------------------------------------------------------------------*/
 
 int disk_image_read_track(disk_image_t *image, unsigned int track,
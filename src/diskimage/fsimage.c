@@ -28,6 +28,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "archdep.h"
 #include "cbmdos.h"
@@ -38,6 +39,7 @@
 #include "fsimage.h"
 #include "lib.h"
 #include "types.h"
+#include "util.h"
 #include "x64.h"
 #include "zfile.h"
 
@@ -84,6 +86,153 @@ void fsimage_error_info_destroy(fsimage_t *fsimage)
 
 /*-----------------------------------------------------------------------*/
 
+/* Sector based images are read into memory once when they are opened, so
+   that the virtual drive and c1541 do not need a seek and a read for
+   every single sector.  Writes only go to the copy in memory and are
+   written back by fsimage_flush().  */
+
+static int fsimage_cache_type(disk_image_t *image)
+{
+    switch (image->type) {
+      case DISK_IMAGE_TYPE_D64:
+      case DISK_IMAGE_TYPE_D67:
+      case DISK_IMAGE_TYPE_D71:
+      case DISK_IMAGE_TYPE_D81:
+      case DISK_IMAGE_TYPE_D80:
+      case DISK_IMAGE_TYPE_D82:
+      case DISK_IMAGE_TYPE_X64:
+        return 1;
+    }
+    return 0;
+}
+
+static void fsimage_cache_create(disk_image_t *image)
+{
+    fsimage_t *fsimage;
+    size_t size;
+
+    fsimage = image->media.fsimage;
+
+    if (!fsimage_cache_type(image))
+        return;
+
+    size = util_file_length(fsimage->fd);
+    if (size == 0)
+        return;
+
+    fsimage->cache = lib_malloc(size);
+
+    if (fseek(fsimage->fd, 0, SEEK_SET) != 0
+        || fread(fsimage->cache, size, 1, fsimage->fd) < 1) {
+        /* Fall back to reading from the file.  */
+        lib_free(fsimage->cache);
+        fsimage->cache = NULL;
+        return;
+    }
+
+    fsimage->cache_size = size;
+    fsimage->cache_dirty_sectors = (unsigned int)(size >> 8) + 1;
+    fsimage->cache_dirty = lib_calloc(1, (fsimage->cache_dirty_sectors + 7)
+                                      / 8);
+    fsimage->cache_dirty_num = 0;
+}
+
+static void fsimage_cache_destroy(fsimage_t *fsimage)
+{
+    lib_free(fsimage->cache);
+    lib_free(fsimage->cache_dirty);
+    fsimage->cache = NULL;
+    fsimage->cache_dirty = NULL;
+    fsimage->cache_size = 0;
+    fsimage->cache_dirty_sectors = 0;
+    fsimage->cache_dirty_num = 0;
+}
+
+/* The drive may extend an image, make the copy at least `size' bytes.  */
+static void fsimage_cache_grow(fsimage_t *fsimage, size_t size)
+{
+    unsigned int sectors;
+
+    if (size <= fsimage->cache_size)
+        return;
+
+    fsimage->cache = lib_realloc(fsimage->cache, size);
+    memset(fsimage->cache + fsimage->cache_size, 0,
+           size - fsimage->cache_size);
+    fsimage->cache_size = size;
+
+    sectors = (unsigned int)(size >> 8) + 1;
+    if (sectors > fsimage->cache_dirty_sectors) {
+        fsimage->cache_dirty = lib_realloc(fsimage->cache_dirty,
+                                           (sectors + 7) / 8);
+        memset(fsimage->cache_dirty + (fsimage->cache_dirty_sectors + 7) / 8,
+               0, (sectors + 7) / 8 - (fsimage->cache_dirty_sectors + 7) / 8);
+        fsimage->cache_dirty_sectors = sectors;
+    }
+}
+
+static int fsimage_cache_is_dirty(fsimage_t *fsimage, unsigned int sectors)
+{
+    return fsimage->cache_dirty[sectors >> 3] & (1 << (sectors & 7));
+}
+
+/* Write all dirty sectors back to the image file.  Runs of consecutive
+   sectors are written with a single call.  A run stays dirty if writing
+   it fails, so the next flush tries again.  */
+int fsimage_flush(disk_image_t *image)
+{
+    fsimage_t *fsimage;
+    unsigned int sectors, first, i;
+    long header, offset;
+    size_t len;
+    int rc = 0;
+
+    fsimage = image->media.fsimage;
+
+    if (fsimage == NULL || fsimage->cache == NULL
+        || fsimage->cache_dirty_num == 0 || fsimage->fd == NULL)
+        return 0;
+
+    header = (image->type == DISK_IMAGE_TYPE_X64) ? X64_HEADER_LENGTH : 0;
+
+    for (sectors = 0; sectors < fsimage->cache_dirty_sectors; sectors++) {
+        if (!fsimage_cache_is_dirty(fsimage, sectors))
+            continue;
+
+        first = sectors;
+        while (sectors < fsimage->cache_dirty_sectors
+               && fsimage_cache_is_dirty(fsimage, sectors))
+            sectors++;
+
+        offset = header + ((long)first << 8);
+        len = (size_t)(sectors - first) << 8;
+        if ((size_t)offset + len > fsimage->cache_size)
+            len = fsimage->cache_size - (size_t)offset;
+
+        if (fseek(fsimage->fd, offset, SEEK_SET) != 0
+            || fwrite(fsimage->cache + offset, len, 1, fsimage->fd) < 1) {
+            #ifdef CELL_DEBUG
+            printf("ERROR: Error writing back sectors %u-%u of `%s'.\n",
+                   first, sectors - 1, fsimage->name);
+            #endif
+            rc = -1;
+            continue;
+        }
+
+        for (i = first; i < sectors; i++) {
+            fsimage->cache_dirty[i >> 3] &= ~(1 << (i & 7));
+            fsimage->cache_dirty_num--;
+        }
+    }
+
+    /* Make sure the stream is visible to other readers.  */
+    fflush(fsimage->fd);
+
+    return rc;
+}
+
+/*-----------------------------------------------------------------------*/
+
 void fsimage_media_create(disk_image_t *image)
 {
     fsimage_t *fsimage;
@@ -101,6 +250,7 @@ void fsimage_media_destroy(disk_image_t *image)
 
     lib_free(fsimage->name);
     fsimage_error_info_destroy(fsimage);
+    fsimage_cache_destroy(fsimage);
 
     lib_free(fsimage);
 }
@@ -133,8 +283,10 @@ int fsimage_open(disk_image_t *image)
 		return -1;
 	}
 
-	if (fsimage_probe(image) == 0)
+	if (fsimage_probe(image) == 0) {
+		fsimage_cache_create(image);
 		return 0;
+	}
 
 	zfile_fclose(fsimage->fd);
 	#ifdef CELL_DEBUG
@@ -157,6 +309,9 @@ int fsimage_close(disk_image_t *image)
 		return -1;
 	}
 
+	fsimage_flush(image);
+	fsimage_cache_destroy(fsimage);
+
 	zfile_fclose(fsimage->fd);
 
 	fsimage_error_info_destroy(fsimage);
@@ -206,9 +361,17 @@ int fsimage_read_sector(disk_image_t *image, BYTE *buf, unsigned int track,
 			if (image->type == DISK_IMAGE_TYPE_X64)
 				offset += X64_HEADER_LENGTH;
 
-			fseek(fsimage->fd, offset, SEEK_SET);
-
-			if (fread((char *)buf, 256, 1, fsimage->fd) < 1)
+			if (fsimage->cache != NULL) {
+				if ((size_t)offset + 256 > fsimage->cache_size)
+				{
+					#ifdef CELL_DEBUG
+					printf("ERROR: Error reading T:%i S:%i from disk image.\n", track, sector);
+					#endif
+					return -1;
+				}
+				memcpy(buf, fsimage->cache + offset, 256);
+			} else if (fseek(fsimage->fd, offset, SEEK_SET) != 0
+			           || fread((char *)buf, 256, 1, fsimage->fd) < 1)
 			{
 				#ifdef CELL_DEBUG
 				printf("ERROR: Error reading T:%i S:%i from disk image.\n", track, sector);
@@ -309,6 +472,17 @@ int fsimage_write_sector(disk_image_t *image, BYTE *buf, unsigned int track,
 			if (image->type == DISK_IMAGE_TYPE_X64)
 				offset += X64_HEADER_LENGTH;
 
+			if (fsimage->cache != NULL) {
+				fsimage_cache_grow(fsimage, (size_t)offset + 256);
+				memcpy(fsimage->cache + offset, buf, 256);
+
+				if (!fsimage_cache_is_dirty(fsimage, (unsigned int)sectors)) {
+					fsimage->cache_dirty[sectors >> 3] |= 1 << (sectors & 7);
+					fsimage->cache_dirty_num++;
+				}
+				break;
+			}
+
 			fseek(fsimage->fd, offset, SEEK_SET);
 
 			if (fwrite((char *)buf, 256, 1, fsimage->fd) < 1)
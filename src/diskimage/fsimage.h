@@ -37,6 +37,13 @@ typedef struct fsimage_s {
     FILE *fd;
     char *name;
     BYTE *error_info;
+    /* Copy of the whole image file for sector based images, with one
+       dirty bit per sector that still has to be written back.  */
+    BYTE *cache;
+    size_t cache_size;
+    BYTE *cache_dirty;
+    unsigned int cache_dirty_sectors;
+    unsigned int cache_dirty_num;
 } fsimage_t;
 
 
@@ -57,6 +64,7 @@ extern int fsimage_read_sector(struct disk_image_s *image, BYTE *buf,
                                unsigned int track, unsigned int sector);
 extern int fsimage_write_sector(struct disk_image_s *image, BYTE *buf,
                                 unsigned int track, unsigned int sector);
+extern int fsimage_flush(struct disk_image_s *image);
 
 #endif
 
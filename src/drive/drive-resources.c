@@ -33,6 +33,7 @@
 #include "drive.h"
 #include "drivecpu.h"
 #include "driverom.h"
+#include "drivethread.h"
 #include "drivetypes.h"
 #include "iecbus.h"
 #include "iecdrive.h"
@@ -308,9 +309,21 @@ static const resource_int_t resources_int[] = {
     { NULL }
 };
 
+static int set_drive_idle_loop_detect(int val, void *param)
+{
+    drive_context_t *drv = drive_context[vice_ptr_to_int(param)];
+
+    drv->drive->idle_loop_detect = val ? 1 : 0;
+    drivecpu_set_mem_funcs(drv);
+
+    return 0;
+}
+
 static resource_int_t res_drive[] = {
     { NULL, DRIVE_EXTEND_NEVER, RES_EVENT_SAME, NULL,
       NULL, set_drive_extend_image_policy, NULL },
+    { NULL, 0, RES_EVENT_SAME, NULL,
+      NULL, set_drive_idle_loop_detect, NULL },
     { NULL }
 };
 
@@ -326,14 +339,19 @@ int drive_resources_init(void)
 		res_drive[0].name = lib_msprintf("Drive%iExtendImagePolicy", dnr + 8);
 		res_drive[0].value_ptr = (int *)&(drive->extend_image_policy);
 		res_drive[0].param = uint_to_void_ptr(dnr);
+		res_drive[1].name = lib_msprintf("Drive%iIdleLoopDetect", dnr + 8);
+		res_drive[1].value_ptr = &(drive->idle_loop_detect);
+		res_drive[1].param = uint_to_void_ptr(dnr);
 
 		if (resources_register_int(res_drive) < 0)
 			return -1;
 
 		lib_free((char *)(res_drive[0].name));
+		lib_free((char *)(res_drive[1].name));
 	}
 
 	return machine_drive_resources_init()
+		| drivethread_resources_init()
 		| resources_register_int(resources_int);
 }
 
@@ -64,3 +64,33 @@ BYTE drive_writeprotect_sense(drive_t *dptr)
     }
 }
 
+static CLOCK drive_writeprotect_earliest(CLOCK next_clk, CLOCK clk,
+                                         CLOCK start_clk, CLOCK delay)
+{
+    if (start_clk == (CLOCK)0 || clk - start_clk >= delay)
+        return next_clk;
+
+    if (next_clk == (CLOCK)0 || start_clk + delay < next_clk)
+        return start_clk + delay;
+
+    return next_clk;
+}
+
+/* Return the drive clock at which the disk change in progress next changes
+   what `drive_writeprotect_sense()' and the rotation report, or (CLOCK)0
+   if there is none.  */
+CLOCK drive_writeprotect_change_clk(drive_t *dptr)
+{
+    CLOCK clk = *(dptr->clk);
+    CLOCK next_clk = (CLOCK)0;
+
+    next_clk = drive_writeprotect_earliest(next_clk, clk, dptr->detach_clk,
+                                           DRIVE_DETACH_DELAY);
+    next_clk = drive_writeprotect_earliest(next_clk, clk,
+                                           dptr->attach_detach_clk,
+                                           DRIVE_ATTACH_DETACH_DELAY);
+    next_clk = drive_writeprotect_earliest(next_clk, clk, dptr->attach_clk,
+                                           DRIVE_ATTACH_DELAY);
+
+    return next_clk;
+}
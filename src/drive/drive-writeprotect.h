@@ -32,6 +32,7 @@
 struct drive_s;
 
 extern BYTE drive_writeprotect_sense(struct drive_s *dptr);
+extern CLOCK drive_writeprotect_change_clk(struct drive_s *dptr);
 
 #endif
 
@@ -52,6 +52,7 @@
 #include "drivecpu.h"
 #include "driveimage.h"
 #include "drivesync.h"
+#include "drivethread.h"
 #include "driverom.h"
 #include "drivetypes.h"
 #include "gcr.h"
@@ -236,8 +237,20 @@ int drive_init(void)
 void drive_shutdown(void)
 {
     unsigned int dnr;
+#ifdef CELL_DEBUG
+    unsigned long skipped_cycles, skips;
+#endif
+
+    drivethread_shutdown();
 
     for (dnr = 0; dnr < DRIVE_NUM; dnr++) {
+#ifdef CELL_DEBUG
+        drivecpu_idle_stats_get(dnr, &skipped_cycles, &skips);
+        if (skips > 0)
+            printf("INFO: Drive %u skipped %lu cycles in %lu idle loops.\n",
+                   dnr + 8, skipped_cycles, skips);
+#endif
+
         drivecpu_shutdown(drive_context[dnr]);
         gcr_destroy_image(drive_context[dnr]->drive->gcr);
     }
@@ -731,13 +744,25 @@ int drive_num_leds(unsigned int dnr)
 	return 1;
 }
 
+/* Number of frames between writing back the sectors that have been
+   written to attached images.  */
+#define DRIVE_IMAGE_FLUSH_FRAMES 50
+
 /* This is called at every vsync.  */
 void drive_vsync_hook(void)
 {
+	static unsigned int flush_frames = 0;
 	unsigned int dnr;
 
 	drive_update_ui_status();
 
+	if (++flush_frames >= DRIVE_IMAGE_FLUSH_FRAMES)
+	{
+		flush_frames = 0;
+		for (dnr = 0; dnr < DRIVE_NUM; dnr++)
+			disk_image_flush(drive_context[dnr]->drive->image);
+	}
+
 	for (dnr = 0; dnr < DRIVE_NUM; dnr++)
 	{
 		drive_t *drive;
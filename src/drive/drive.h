@@ -119,6 +119,9 @@ typedef struct drive_s {
     /* What idling method?  (See `DRIVE_IDLE_*')  */
     int idling_method;
 
+    /* Fast-forward through detected spin loops?  */
+    int idle_loop_detect;
+
     /* Original ROM code is saved here.  */
     BYTE rom_idle_trap[4];
 
@@ -40,7 +40,9 @@
 #include "drive.h"
 #include "drivecpu.h"
 #include "drive-check.h"
+#include "drive-writeprotect.h"
 #include "drivemem.h"
+#include "drivethread.h"
 #include "drivetypes.h"
 #include "interrupt.h"
 #include "lib.h"
@@ -49,6 +51,7 @@
 #include "mem.h"
 #include "monitor.h"
 #include "mos6510.h"
+#include "perfcount.h"
 #include "rotation.h"
 #include "snapshot.h"
 #include "types.h"
@@ -123,10 +126,21 @@ void drivecpu_setup_context(struct drive_context_s *drv)
 #define STORE_ZERO(a, b)  (drv->cpud->store_func[0](drv, (WORD)(a), \
                           (BYTE)(b)))
 
+/* Backward jumps are where spin loops close; let the detector see them.  */
+#define JUMP(addr)                                       \
+    do {                                                 \
+        unsigned int jump_dest = (addr);                 \
+                                                         \
+        if (jump_dest <= reg_pc && cpu->idle_hooked) {   \
+            drivecpu_idle_jump(drv, jump_dest);          \
+        }                                                \
+        SET_BANK_BASE(jump_dest);                        \
+    } while (0)
+
 /* FIXME: pc can not jump to VIA adress space in 1541 and 1571 emulation.  */
 /* FIXME: SFD1001 does not use bank_base at all due to messy memory mapping.
    We should use tables like in maincpu instead (AF) */
-#define JUMP(addr)                                       \
+#define SET_BANK_BASE(addr)                              \
     do {                                                 \
         reg_pc = (addr);                                 \
         if (drv->drive->type == 1001) {                  \
@@ -194,17 +208,8 @@ static void drivecpu_toggle_watchpoints(int flag, void *context)
 {
     drive_context_t *drv = (drive_context_t *)context;
 
-    if (flag) {
-        memcpy(drv->cpud->read_func, drv->cpud->read_func_watch,
-               sizeof(drive_read_func_t *) * 0x101);
-        memcpy(drv->cpud->store_func, drv->cpud->store_func_watch,
-               sizeof(drive_store_func_t *) * 0x101);
-    } else {
-        memcpy(drv->cpud->read_func, drv->cpud->read_func_nowatch,
-               sizeof(drive_read_func_t *) * 0x101);
-        memcpy(drv->cpud->store_func, drv->cpud->store_func_nowatch,
-               sizeof(drive_store_func_t *) * 0x101);
-    }
+    drv->cpu->watchpoints_active = flag;
+    drivecpu_set_mem_funcs(drv);
 }
 
 void drivecpu_reset_clk(drive_context_t *drv)
@@ -371,6 +376,196 @@ inline static DWORD drive_trap_handler(drive_context_t *drv)
     return (DWORD)-1;
 }
 
+/* -------------------------------------------------------------------------- */
+
+/* Generic spin loop detection.
+
+   While the drive CPU catches up with the main CPU, nothing on the bus can
+   change, so the only things that can break a loop which does not write to
+   memory are the drive's own alarms and the disk rotation.  A candidate
+   loop is armed on a backward jump and every memory read of one iteration
+   is recorded.  Further iterations must take the same number of cycles,
+   end with the same registers and read the same values, without any
+   writes.  Once this has held for at least DRIVECPU_IDLE_VERIFY_CYCLES
+   (long enough for every timer register to visibly change) the drive
+   clock is advanced by whole iterations up to the next pending alarm.
+
+   The accesses are watched through the memory access tables, like the
+   monitor watchpoints, so the CPU core is unchanged while the detection
+   is off.  */
+
+#define DRIVECPU_IDLE_OFF       0
+#define DRIVECPU_IDLE_RECORD    1
+#define DRIVECPU_IDLE_VERIFY    2
+
+#define DRIVECPU_IDLE_VERIFY_CYCLES 2048
+
+inline static void drivecpu_idle_abort(drive_context_t *drv)
+{
+    drv->cpu->idle_state = DRIVECPU_IDLE_OFF;
+}
+
+static BYTE REGPARM2 drivecpu_idle_read(drive_context_t *drv, WORD addr)
+{
+    drivecpu_context_t *cpu = drv->cpu;
+    BYTE value;
+    unsigned int pos;
+
+    value = drv->cpud->read_func_nowatch[addr >> 8](drv, addr);
+
+    if (cpu->idle_state == DRIVECPU_IDLE_OFF)
+        return value;
+
+    pos = cpu->idle_read_pos++;
+
+    if (cpu->idle_state == DRIVECPU_IDLE_RECORD) {
+        if (pos >= DRIVECPU_IDLE_MAX_READS) {
+            cpu->idle_state = DRIVECPU_IDLE_OFF;
+        } else {
+            cpu->idle_read_addr[pos] = addr;
+            cpu->idle_read_value[pos] = value;
+        }
+    } else if (pos >= cpu->idle_num_reads
+               || cpu->idle_read_addr[pos] != addr
+               || cpu->idle_read_value[pos] != value) {
+        cpu->idle_state = DRIVECPU_IDLE_OFF;
+    }
+
+    return value;
+}
+
+static void REGPARM3 drivecpu_idle_store(drive_context_t *drv, WORD addr,
+                                         BYTE value)
+{
+    drivecpu_idle_abort(drv);
+    drv->cpud->store_func_nowatch[addr >> 8](drv, addr, value);
+}
+
+inline static int drivecpu_idle_regs_equal(const mos6510_regs_t *a,
+                                           const mos6510_regs_t *b)
+{
+    return a->a == b->a && a->x == b->x && a->y == b->y && a->sp == b->sp
+           && a->p == b->p && a->n == b->n && a->z == b->z;
+}
+
+static void drivecpu_idle_start(drive_context_t *drv, unsigned int dest)
+{
+    drivecpu_context_t *cpu = drv->cpu;
+
+    cpu->idle_state = DRIVECPU_IDLE_RECORD;
+    cpu->idle_pc = dest;
+    cpu->idle_start_clk = *(drv->clk_ptr);
+    cpu->idle_last_clk = cpu->idle_start_clk;
+    cpu->idle_regs = cpu->cpu_regs;
+    cpu->idle_read_pos = 0;
+}
+
+static void drivecpu_idle_jump(drive_context_t *drv, unsigned int dest)
+{
+    drivecpu_context_t *cpu = drv->cpu;
+    CLOCK clk = *(drv->clk_ptr);
+    CLOCK next_clk;
+    CLOCK change_clk;
+    CLOCK skip;
+
+    if (cpu->idle_state == DRIVECPU_IDLE_OFF || dest != cpu->idle_pc) {
+        drivecpu_idle_start(drv, dest);
+        return;
+    }
+
+    if (!drivecpu_idle_regs_equal(&(cpu->idle_regs), &(cpu->cpu_regs))) {
+        drivecpu_idle_start(drv, dest);
+        return;
+    }
+
+    if (cpu->idle_state == DRIVECPU_IDLE_RECORD) {
+        cpu->idle_iteration_clk = clk - cpu->idle_last_clk;
+        cpu->idle_num_reads = cpu->idle_read_pos;
+        cpu->idle_state = DRIVECPU_IDLE_VERIFY;
+    } else if (clk - cpu->idle_last_clk != cpu->idle_iteration_clk
+               || cpu->idle_read_pos != cpu->idle_num_reads) {
+        drivecpu_idle_start(drv, dest);
+        return;
+    }
+
+    cpu->idle_last_clk = clk;
+    cpu->idle_read_pos = 0;
+
+    if (clk - cpu->idle_start_clk < DRIVECPU_IDLE_VERIFY_CYCLES)
+        return;
+
+    /* The disk rotation is not alarm driven; do not skip while the head
+       is reading a spinning disk.  */
+    if ((drv->drive->byte_ready_active & 0x04)
+        && drv->drive->GCR_image_loaded)
+        return;
+
+    if (cpu->int_status->global_pending_int != IK_NONE)
+        return;
+
+    next_clk = alarm_context_next_pending_clk(cpu->alarm_context);
+    if (next_clk > cpu->stop_clk)
+        next_clk = cpu->stop_clk;
+
+    /* A disk change in progress is timed by plain clock comparisons when
+       the drive reads its state, not by an alarm.  */
+    change_clk = drive_writeprotect_change_clk(drv->drive);
+    if (change_clk != (CLOCK)0 && change_clk < next_clk)
+        next_clk = change_clk;
+    change_clk = machine_drive_disk_change_clk(drv->mynumber);
+    if (change_clk != (CLOCK)0 && change_clk < next_clk)
+        next_clk = change_clk;
+
+    if (next_clk <= clk || cpu->idle_iteration_clk == 0)
+        return;
+
+    skip = ((next_clk - clk) / cpu->idle_iteration_clk)
+           * cpu->idle_iteration_clk;
+
+    if (skip > 0) {
+        *(drv->clk_ptr) += skip;
+        cpu->idle_skipped_cycles += skip;
+        cpu->idle_skips++;
+        drivecpu_idle_start(drv, dest);
+    }
+}
+
+/* Install the memory access functions of the drive CPU.  Watchpoints take
+   precedence over the spin loop detection.  */
+void drivecpu_set_mem_funcs(drive_context_t *drv)
+{
+    drivecpu_context_t *cpu = drv->cpu;
+    unsigned int i;
+
+    drivecpu_idle_abort(drv);
+    cpu->idle_hooked = 0;
+
+    if (cpu->watchpoints_active) {
+        memcpy(drv->cpud->read_func, drv->cpud->read_func_watch,
+               sizeof(drive_read_func_t *) * 0x101);
+        memcpy(drv->cpud->store_func, drv->cpud->store_func_watch,
+               sizeof(drive_store_func_t *) * 0x101);
+    } else if (drv->drive->idle_loop_detect) {
+        for (i = 0; i < 0x101; i++) {
+            drv->cpud->read_func[i] = drivecpu_idle_read;
+            drv->cpud->store_func[i] = drivecpu_idle_store;
+        }
+        cpu->idle_hooked = 1;
+    } else {
+        memcpy(drv->cpud->read_func, drv->cpud->read_func_nowatch,
+               sizeof(drive_read_func_t *) * 0x101);
+        memcpy(drv->cpud->store_func, drv->cpud->store_func_nowatch,
+               sizeof(drive_store_func_t *) * 0x101);
+    }
+}
+
+void drivecpu_idle_stats_get(unsigned int dnr, unsigned long *skipped_cycles,
+                             unsigned long *skips)
+{
+    *skipped_cycles = drive_context[dnr]->cpu->idle_skipped_cycles;
+    *skips = drive_context[dnr]->cpu->idle_skips;
+}
+
 static void drive_generic_dma(void)
 {
     /* Generic DMA hosts can be implemented here.
@@ -445,6 +640,8 @@ void drivecpu_execute(drive_context_t *drv, CLOCK clk_value)
 #define flag_z  (cpu->cpu_regs.z)
 #define flag_n  (cpu->cpu_regs.n)
 
+    PERFCOUNT_ENTER(PERFCOUNT_DRIVE);
+
     cpu = drv->cpu;
 
     drivecpu_wake_up(drv);
@@ -511,8 +708,13 @@ void drivecpu_execute(drive_context_t *drv, CLOCK clk_value)
 
     }
 
+    /* The main CPU may change the bus before we run again.  */
+    drivecpu_idle_abort(drv);
+
     cpu->last_clk = clk_value;
     drivecpu_sleep(drv);
+
+    PERFCOUNT_LEAVE(PERFCOUNT_DRIVE);
 }
 
 #ifdef _MSC_VER
@@ -523,6 +725,9 @@ void drivecpu_execute_all(CLOCK clk_value)
 {
     unsigned int dnr;
 
+    if (drivethread_execute_all(clk_value) == 0)
+        return;
+
     for (dnr = 0; dnr < DRIVE_NUM; dnr++) {
         if (drive_context[dnr]->drive->enable)
             drivecpu_execute(drive_context[dnr], clk_value);
@@ -539,11 +744,13 @@ static void drivecpu_set_bank_base(void *context)
     drv = (drive_context_t *)context;
     cpu = drv->cpu;
 
-    JUMP(reg_pc);
+    SET_BANK_BASE(reg_pc);
 }
 
 /* Inlining this fuction makes no sense and would only bloat the code.  */
-static void drive_jam(drive_context_t *drv)
+/* Ask the user what to do about the JAM.  Return nonzero if the CPU
+   should keep running.  */
+static int drive_jam_dialog(drive_context_t *drv)
 {
     unsigned int tmp;
     char *dname = "  Drive";
@@ -613,7 +820,32 @@ static void drive_jam(drive_context_t *drv)
         monitor_startup();
         break;
       default:
+        return 1;
+    }
+
+    return 0;
+}
+
+static void drive_jam(drive_context_t *drv)
+{
+    /* The dialog, the monitor and machine resets belong to the main
+       thread; a worker just keeps the CPU on the JAM until the drives
+       meet.  */
+    if (drv->cpu->on_worker) {
+        drv->cpu->jam_pending = 1;
         CLK++;
+        return;
+    }
+
+    if (drive_jam_dialog(drv))
+        CLK++;
+}
+
+void drivecpu_handle_jam(drive_context_t *drv)
+{
+    if (drv->cpu->jam_pending) {
+        drv->cpu->jam_pending = 0;
+        drive_jam_dialog(drv);
     }
 }
 
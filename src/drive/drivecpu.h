@@ -49,6 +49,11 @@ extern void drivecpu_trigger_reset(unsigned int dnr);
 
 extern void drivecpu_execute(struct drive_context_s *drv, CLOCK clk_value);
 extern void drivecpu_execute_all(CLOCK clk_value);
+extern void drivecpu_handle_jam(struct drive_context_s *drv);
+extern void drivecpu_set_mem_funcs(struct drive_context_s *drv);
+extern void drivecpu_idle_stats_get(unsigned int dnr,
+                                    unsigned long *skipped_cycles,
+                                    unsigned long *skips);
 extern int drivecpu_snapshot_write_module(struct drive_context_s *drv,
                                           struct snapshot_s *s);
 extern int drivecpu_snapshot_read_module(struct drive_context_s *drv,
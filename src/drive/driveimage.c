@@ -264,6 +264,17 @@ int drive_image_attach(disk_image_t *image, unsigned int unit)
 	}
 
 	drive->image = image;
+
+	if (image->gcr != NULL && image->gcr != drive->gcr
+	    && image->type == DISK_IMAGE_TYPE_G64) {
+		/* The GCR data has been read ahead, see attach.c.  */
+		memcpy(drive->gcr, image->gcr, sizeof(gcr_t));
+		gcr_destroy_image(image->gcr);
+		image->gcr = drive->gcr;
+		drive->GCR_image_loaded = 1;
+		return 0;
+	}
+
 	drive->image->gcr = drive->gcr;
 
 	if (drive->image->type == DISK_IMAGE_TYPE_G64) {
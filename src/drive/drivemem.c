@@ -31,6 +31,7 @@
 #include <string.h>
 
 #include "drive.h"
+#include "drivecpu.h"
 #include "drivemem.h"
 #include "driverom.h"
 #include "drivetypes.h"
@@ -114,10 +115,7 @@ void drivemem_init(drive_context_t *drv, unsigned int type)
 	drv->cpud->read_func_nowatch[0x100] = drv->cpud->read_func_nowatch[0];
 	drv->cpud->store_func_nowatch[0x100] = drv->cpud->store_func_nowatch[0];
 
-	memcpy(drv->cpud->read_func, drv->cpud->read_func_nowatch,
-			sizeof(drive_read_func_t *) * 0x101);
-	memcpy(drv->cpud->store_func, drv->cpud->store_func_nowatch,
-			sizeof(drive_store_func_t *) * 0x101);
+	drivecpu_set_mem_funcs(drv);
 
 	switch (type)
 	{
@@ -0,0 +1,305 @@
+/*
+ * drivethread.c - Run true drive CPUs on worker threads.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include "vice.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "drive.h"
+#include "drivecpu.h"
+#include "drivethread.h"
+#include "drivetypes.h"
+#include "iecbus.h"
+#include "monitor.h"
+#include "resources.h"
+#include "types.h"
+
+
+/* When enabled, every true drive but the first runs on a worker thread
+   while drivecpu_execute_all() catches the drives up with the main CPU.
+   The drives are advanced in slices of at most `drive_thread_skew' main
+   CPU cycles and meet at the end of every slice, so one drive never sees
+   the bus state of another drive more than that many cycles off.  A skew
+   of 0 disables the threads; the drives then run serially and
+   deterministically as before.
+   While the drives run in parallel the IEC bus is split: every drive
+   changes only its own output and sees the others as they were at the
+   start of the slice, and the bus is recombined when the drives meet.
+   Everything else a drive could share is kept off the threads: only
+   1541 drives without parallel cable on a machine with an IEC bus
+   qualify, the drives run serially while the monitor watches any of
+   them, and a JAM on a worker is reported by the main thread.  */
+static int drive_thread_skew = 0;
+
+/* Number of busy-wait rounds before a worker blocks on its condition.  */
+#define DRIVETHREAD_SPIN_ROUNDS 1000
+
+typedef struct drivethread_s {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    drive_context_t *drv;
+
+    /* Handshake: the main thread publishes `target_clk' and then bumps
+       `request'; the worker runs the drive and copies `request' into
+       `done'.  */
+    volatile CLOCK target_clk;
+    volatile unsigned int request;
+    volatile unsigned int done;
+    volatile int sleeping;
+    volatile int running;
+} drivethread_t;
+
+static drivethread_t drivethreads[DRIVE_NUM];
+static int drivethreads_started = 0;
+
+#define drivethread_barrier() __sync_synchronize()
+
+/* ------------------------------------------------------------------------- */
+
+static void *drivethread_main(void *data)
+{
+    drivethread_t *t = (drivethread_t *)data;
+    unsigned int rounds = 0;
+
+    while (1) {
+        if (t->request == t->done) {
+            if (!t->running)
+                break;
+
+            if (++rounds < DRIVETHREAD_SPIN_ROUNDS) {
+                sched_yield();
+                continue;
+            }
+
+            pthread_mutex_lock(&t->mutex);
+            t->sleeping = 1;
+            drivethread_barrier();
+            while (t->request == t->done && t->running)
+                pthread_cond_wait(&t->cond, &t->mutex);
+            t->sleeping = 0;
+            pthread_mutex_unlock(&t->mutex);
+            continue;
+        }
+
+        rounds = 0;
+        drivethread_barrier();
+
+        t->drv->cpu->on_worker = 1;
+        drivecpu_execute(t->drv, t->target_clk);
+        t->drv->cpu->on_worker = 0;
+
+        drivethread_barrier();
+        t->done = t->request;
+    }
+
+    return NULL;
+}
+
+static void drivethread_wake(drivethread_t *t)
+{
+    drivethread_barrier();
+
+    if (t->sleeping) {
+        pthread_mutex_lock(&t->mutex);
+        pthread_cond_signal(&t->cond);
+        pthread_mutex_unlock(&t->mutex);
+    }
+}
+
+static int drivethread_start(void)
+{
+    unsigned int dnr;
+
+    for (dnr = 1; dnr < DRIVE_NUM; dnr++) {
+        drivethread_t *t = &drivethreads[dnr];
+
+        t->drv = drive_context[dnr];
+        t->request = 0;
+        t->done = 0;
+        t->sleeping = 0;
+        t->running = 1;
+        pthread_mutex_init(&t->mutex, NULL);
+        pthread_cond_init(&t->cond, NULL);
+
+        if (pthread_create(&t->thread, NULL, drivethread_main, t) != 0) {
+            t->running = 0;
+            pthread_cond_destroy(&t->cond);
+            pthread_mutex_destroy(&t->mutex);
+            drivethreads_started = dnr;
+            drivethread_shutdown();
+            return -1;
+        }
+    }
+
+    drivethreads_started = DRIVE_NUM;
+
+    return 0;
+}
+
+void drivethread_shutdown(void)
+{
+    unsigned int dnr;
+
+    for (dnr = 1; dnr < (unsigned int)drivethreads_started; dnr++) {
+        drivethread_t *t = &drivethreads[dnr];
+
+        t->running = 0;
+        drivethread_barrier();
+        pthread_mutex_lock(&t->mutex);
+        pthread_cond_signal(&t->cond);
+        pthread_mutex_unlock(&t->mutex);
+
+        pthread_join(t->thread, NULL);
+        pthread_cond_destroy(&t->cond);
+        pthread_mutex_destroy(&t->mutex);
+    }
+
+    drivethreads_started = 0;
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* Return nonzero if `drv' touches nothing but its own IEC bus output.  */
+static int drivethread_drive_ok(drive_context_t *drv)
+{
+    drive_t *drive = drv->drive;
+
+    if (drive->type != DRIVE_TYPE_1541 && drive->type != DRIVE_TYPE_1541II)
+        return 0;
+
+    if (drive->parallel_cable != DRIVE_PC_NONE)
+        return 0;
+
+    return monitor_mask[drv->cpu->monspace] == 0;
+}
+
+/* Run all enabled drives up to `clk_value' in parallel.  Return -1 if the
+   caller has to run the drives serially instead.  */
+int drivethread_execute_all(CLOCK clk_value)
+{
+    unsigned int dnr, enabled = 0;
+    int jam;
+    CLOCK clk;
+
+    if (drive_thread_skew <= 0 || iecbus_drive_port() == NULL)
+        return -1;
+
+    clk = clk_value;
+    for (dnr = 0; dnr < DRIVE_NUM; dnr++) {
+        drive_context_t *drv = drive_context[dnr];
+
+        if (drv->drive->enable) {
+            if (!drivethread_drive_ok(drv))
+                return -1;
+
+            enabled++;
+            if (drv->cpu->last_clk < clk)
+                clk = drv->cpu->last_clk;
+        }
+    }
+
+    if (enabled < 2)
+        return -1;
+
+    if (!drivethreads_started && drivethread_start() < 0) {
+        drive_thread_skew = 0;
+        return -1;
+    }
+
+    while (clk < clk_value) {
+        if (clk_value - clk > (CLOCK)drive_thread_skew)
+            clk += (CLOCK)drive_thread_skew;
+        else
+            clk = clk_value;
+
+        iecbus_split_ports();
+
+        for (dnr = 1; dnr < DRIVE_NUM; dnr++) {
+            drivethread_t *t = &drivethreads[dnr];
+
+            if (t->drv->drive->enable) {
+                t->target_clk = clk;
+                drivethread_barrier();
+                t->request++;
+                drivethread_wake(t);
+            }
+        }
+
+        if (drive_context[0]->drive->enable)
+            drivecpu_execute(drive_context[0], clk);
+
+        for (dnr = 1; dnr < DRIVE_NUM; dnr++) {
+            drivethread_t *t = &drivethreads[dnr];
+
+            while (t->done != t->request)
+                sched_yield();
+        }
+        drivethread_barrier();
+
+        iecbus_join_ports();
+
+        jam = 0;
+        for (dnr = 1; dnr < DRIVE_NUM; dnr++) {
+            if (drive_context[dnr]->cpu->jam_pending) {
+                drivecpu_handle_jam(drive_context[dnr]);
+                jam = 1;
+            }
+        }
+
+        /* Let the caller finish the catch-up serially; the user may have
+           reset the machine or entered the monitor.  */
+        if (jam)
+            return -1;
+    }
+
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static int set_drive_thread_skew(int val, void *param)
+{
+    if (val < 0)
+        return -1;
+
+    if (val == 0 && drivethreads_started)
+        drivethread_shutdown();
+
+    drive_thread_skew = val;
+
+    return 0;
+}
+
+static const resource_int_t resources_int[] = {
+    { "DriveThreadSkew", 0, RES_EVENT_NO, NULL,
+      &drive_thread_skew, set_drive_thread_skew, NULL },
+    { NULL }
+};
+
+int drivethread_resources_init(void)
+{
+    return resources_register_int(resources_int);
+}
+
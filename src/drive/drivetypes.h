@@ -48,6 +48,9 @@ typedef BYTE REGPARM2 drive_read_func_t(struct drive_context_s *, WORD);
 typedef void REGPARM3 drive_store_func_t(struct drive_context_s *, WORD,
                                          BYTE);
 
+/* Maximum number of memory reads in one iteration of a spin loop.  */
+#define DRIVECPU_IDLE_MAX_READS 16
+
 /*
  *  The private CPU data.
  */
@@ -94,6 +97,36 @@ typedef struct drivecpu_context_s {
     char *snap_module_name;
 
     char *identification_string;
+
+    /* Flag: Are the watchpoint memory access functions installed?  */
+    int watchpoints_active;
+
+    /* Flag: Are the spin loop detection memory access functions
+       installed?  */
+    int idle_hooked;
+
+    /* Spin loop detection state (see `drivecpu_idle_jump()').  */
+    int idle_state;
+    unsigned int idle_pc;
+    CLOCK idle_start_clk;
+    CLOCK idle_last_clk;
+    CLOCK idle_iteration_clk;
+    mos6510_regs_t idle_regs;
+    unsigned int idle_num_reads;
+    unsigned int idle_read_pos;
+    WORD idle_read_addr[DRIVECPU_IDLE_MAX_READS];
+    BYTE idle_read_value[DRIVECPU_IDLE_MAX_READS];
+
+    /* Spin loop detection statistics.  */
+    unsigned long idle_skipped_cycles;
+    unsigned long idle_skips;
+
+    /* Flag: Is the CPU running on a drive worker thread?  */
+    int on_worker;
+
+    /* Flag: Did the CPU jam on a worker thread?  The JAM is reported
+       by `drivecpu_handle_jam()' on the main thread.  */
+    int jam_pending;
 } drivecpu_context_t;
 
 
@@ -139,6 +139,11 @@ void iec_drive_vsync_hook(void)
     wd1770_vsync_hook();
 }
 
+CLOCK iec_drive_disk_change_clk(unsigned int dnr)
+{
+    return wd1770_disk_change_clk(dnr);
+}
+
 void iec_drive_rom_load(void)
 {
     iecrom_load_1541();
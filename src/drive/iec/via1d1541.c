@@ -170,13 +170,17 @@ static void undump_prb(via_context_t *via_context, BYTE byte)
             | (((*drive_data) << 6)
             & ((~(*drive_data) ^ iecbus->cpu_bus) << 3) & 0x80));
 
-        iecbus->cpu_port = iecbus->cpu_bus;
-        for (unit = 4; unit < 8+DRIVE_NUM; unit++)
-            iecbus->cpu_port &= iecbus->drv_bus[unit];
+        if (iecbus->split) {
+            IECBUS_DRV_PORT_UNIT_UPDATE(iecbus, via1p->number + 8);
+        } else {
+            iecbus->cpu_port = iecbus->cpu_bus;
+            for (unit = 4; unit < 8+DRIVE_NUM; unit++)
+                iecbus->cpu_port &= iecbus->drv_bus[unit];
 
-        iecbus->drv_port = (((iecbus->cpu_port >> 4) & 0x4)
-                           | (iecbus->cpu_port >> 7)
-                           | ((iecbus->cpu_bus << 3) & 0x80));
+            iecbus->drv_port = (((iecbus->cpu_port >> 4) & 0x4)
+                               | (iecbus->cpu_port >> 7)
+                               | ((iecbus->cpu_bus << 3) & 0x80));
+        }
 
     } else {
         iec_drive_write((BYTE)(~byte), via1p->number);
@@ -205,13 +209,17 @@ static void store_prb(via_context_t *via_context, BYTE byte, BYTE p_oldpb,
                 | (((*drive_data) << 6)
                 & ((~(*drive_data) ^ iecbus->cpu_bus) << 3) & 0x80));
 
-            iecbus->cpu_port = iecbus->cpu_bus;
-            for (unit = 4; unit < 8+DRIVE_NUM; unit++)
-                iecbus->cpu_port &= iecbus->drv_bus[unit];
+            if (iecbus->split) {
+                IECBUS_DRV_PORT_UNIT_UPDATE(iecbus, via1p->number + 8);
+            } else {
+                iecbus->cpu_port = iecbus->cpu_bus;
+                for (unit = 4; unit < 8+DRIVE_NUM; unit++)
+                    iecbus->cpu_port &= iecbus->drv_bus[unit];
 
-            iecbus->drv_port = (((iecbus->cpu_port >> 4) & 0x4)
-                               | (iecbus->cpu_port >> 7)
-                               | ((iecbus->cpu_bus << 3) & 0x80));
+                iecbus->drv_port = (((iecbus->cpu_port >> 4) & 0x4)
+                                   | (iecbus->cpu_port >> 7)
+                                   | ((iecbus->cpu_bus << 3) & 0x80));
+            }
 
             DEBUG_IEC_BUS_WRITE(iecbus->drv_port);
 
@@ -302,8 +310,12 @@ static BYTE read_prb(via_context_t *via_context)
     andval = (0xfe | via1p->number);
 
     if (iecbus != NULL) {
+        BYTE port;
+
+        port = iecbus->split ? iecbus->drv_port_unit[via1p->number + 8]
+                             : iecbus->drv_port;
         byte = (((via_context->via[VIA_PRB] & 0x1a)
-               | iecbus->drv_port) ^ 0x85) | orval;
+               | port) ^ 0x85) | orval;
     } else {
         byte = (((via_context->via[VIA_PRB] & 0x1a)
                | iec_drive_read(via1p->number)) ^ 0x85) | orval;
@@ -933,3 +933,14 @@ int wd1770_disk_change(drive_context_t *drive_context)
 	return 0;
 }
 
+/* Return the drive clock at which `wd1770_disk_change()' stops reporting
+   the disk change in progress, or (CLOCK)0 if there is none.  */
+CLOCK wd1770_disk_change_clk(unsigned int dnr)
+{
+	if (wd1770[dnr].image == NULL || wd1770[dnr].attach_clk == (CLOCK)0
+			|| drive_clk[dnr] - wd1770[dnr].attach_clk >= DRIVE_ATTACH_DELAY)
+		return (CLOCK)0;
+
+	return wd1770[dnr].attach_clk + DRIVE_ATTACH_DELAY;
+}
+
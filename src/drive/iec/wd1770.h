@@ -108,6 +108,7 @@ extern void wd1770_vsync_hook(void);
 extern int wd1770_attach_image(struct disk_image_s *image, unsigned int unit);
 extern int wd1770_detach_image(struct disk_image_s *image, unsigned int unit);
 extern int wd1770_disk_change(struct drive_context_s *drive_context);
+extern CLOCK wd1770_disk_change_clk(unsigned int dnr);
 
 #endif 
 
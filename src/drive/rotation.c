@@ -33,6 +33,11 @@
 
 #define ACCUM_MAX 0x10000
 
+/* Largest clock delta that can be added to `accum' in one step without
+   overflowing its DWORD at the highest bit rate; the product has to be
+   computed unsigned, as it does not fit into an int.  */
+#define ROTATION_MAX_DELTA 10000
+
 #define ROTATION_TABLE_SIZE 0x1000
 
 
@@ -173,6 +178,70 @@ inline static SDWORD RANDOM_nextInt(rotation_t *rptr) {
     return (SDWORD) rptr->seed;
 }
 
+/* Read the next 8 bits in one go.  This is only done if none of them can
+   complete a sync mark, trigger a clock reset or a random flux event, so
+   the result is exactly what 8 calls of the bit-by-bit loop would give.
+   Return 0 and leave everything untouched otherwise.  */
+inline static int read_next_byte_fast(drive_t *dptr, rotation_t *rptr)
+{
+    unsigned int off, byte_offset, data, lrd, window, run, n, tz;
+
+    if (dptr->GCR_image_loaded == 0 || rptr->zero_count > 5)
+        return 0;
+
+    off = dptr->GCR_head_offset;
+    byte_offset = off >> 3;
+    data = dptr->GCR_track_start_ptr[byte_offset];
+
+    if (off & 7) {
+        unsigned int next = byte_offset + 1;
+
+        if (next >= dptr->GCR_current_track_size)
+            next = 0;
+
+        data = (((data << 8) | dptr->GCR_track_start_ptr[next])
+               >> (8 - (off & 7))) & 0xff;
+    }
+
+    lrd = rptr->last_read_data;
+
+    /* A run of 4 zeros would cause a clock reset.  */
+    window = ((lrd & 0x7) << 8) | data;
+    run = ~window;
+    run &= run >> 1;
+    run &= run >> 2;
+    if (run & 0xff)
+        return 0;
+
+    /* A run of 10 ones is a sync mark.  */
+    window = ((lrd & 0x1ff) << 8) | data;
+    run = window & (window >> 1);
+    run &= run >> 2;
+    run &= run >> 4;
+    run &= run >> 2;
+    if (run & 0xff)
+        return 0;
+
+    /* The byte boundary is reached after `n' of the 8 bits.  */
+    n = 8 - rptr->bit_counter;
+    dptr->GCR_read = (BYTE)((lrd << n) | (data >> (8 - n)));
+    rptr->last_write_data = (BYTE)(dptr->GCR_read << (8 - n));
+    if ((dptr->byte_ready_active & 2) != 0) {
+        dptr->byte_ready_edge = 1;
+        dptr->byte_ready_level = 1;
+    }
+
+    rptr->last_read_data = ((lrd << 8) | data) & 0x3ff;
+
+    for (tz = 0; (data & 1) == 0; tz++)
+        data >>= 1;
+    rptr->zero_count = 1 + tz;
+
+    dptr->GCR_head_offset = (off + 8) % (dptr->GCR_current_track_size << 3);
+
+    return 1;
+}
+
 void rotation_begins(drive_t *dptr) {
     unsigned int dnr = dptr->mynumber;
     rotation[dnr].rotation_last_clk = *(dptr->clk);
@@ -199,16 +268,23 @@ void rotation_rotate_disk(drive_t *dptr)
     rptr->rotation_last_clk = *(dptr->clk);
 
     while (delta > 0) {
-        tdelta = delta > 1000 ? 1000 : delta;
+        tdelta = delta > ROTATION_MAX_DELTA ? ROTATION_MAX_DELTA : delta;
         delta -= tdelta;
 
-        rptr->accum += rot_speed_bps[rptr->frequency][rptr->speed_zone] * tdelta;
+        rptr->accum += (DWORD)rot_speed_bps[rptr->frequency][rptr->speed_zone]
+                       * (DWORD)tdelta;
         bits_moved += rptr->accum / 1000000;
         rptr->accum %= 1000000;
     }
 
     if (dptr->read_write_mode) {
-        while (bits_moved -- != 0) {
+        while (bits_moved != 0) {
+            if (bits_moved >= 8 && read_next_byte_fast(dptr, rptr)) {
+                bits_moved -= 8;
+                continue;
+            }
+            bits_moved--;
+
             /* GCR=0 support.
              * 
              * In the absence of 1-bits (magnetic flux changes), the drive
@@ -70,6 +70,17 @@ struct event_image_list_s {
 };
 typedef struct event_image_list_s event_image_list_t;
 
+/* Every `EventKeyframeInterval' seconds of a recording an EVENT_KEYFRAME
+   holding a memory snapshot is put into the event list.  When a history is
+   loaded the keyframes are indexed by their timestamp, so playback can
+   seek to any second by restoring the keyframe before it and warping over
+   the rest.  */
+struct event_keyframe_s {
+    unsigned int timestamp;
+    event_list_t *event;
+};
+typedef struct event_keyframe_s event_keyframe_t;
+
 static event_list_state_t *event_list = NULL;
 static event_image_list_t *event_image_list_base = NULL;
 static int image_number;
@@ -91,6 +102,16 @@ static char *event_end_snapshot = NULL;
 static char *event_snapshot_path_str = NULL;
 static int event_start_mode;
 static int event_image_include;
+static int event_keyframe_interval;
+
+static event_keyframe_t *keyframes = NULL;
+static unsigned int keyframes_num = 0, keyframes_max = 0;
+
+static unsigned int seek_timestamp;
+static int seek_pending = 0, seek_warp = 0, seek_warp_mode;
+
+/* Second to seek to once playback has started (-playbackseek).  */
+static unsigned int playback_start_seek = 0;
 
 
 static char *event_snapshot_path(const char *snapshot_file)
@@ -306,6 +327,7 @@ void event_record_in_list(event_list_state_t *list, unsigned int type, void *dat
 		case EVENT_INITIAL:
 		case EVENT_SYNC_TEST:
 		case EVENT_RESOURCE:
+		case EVENT_KEYFRAME:
 			event_data = lib_malloc(size);
 			memcpy(event_data, data, size);
 			break;
@@ -352,6 +374,25 @@ static void next_current_list(void)
     event_list->current = event_list->current->next;
 }
 
+static void event_record_keyframe_trap(WORD addr, void *data)
+{
+    BYTE *image;
+    size_t size;
+
+    if (!record_active
+        || machine_write_snapshot_memory(&image, &size, 0, 0, 0) < 0)
+        return;
+
+    event_record(EVENT_KEYFRAME, image, (unsigned int)size);
+    lib_free(image);
+}
+
+static void event_seek_warp_stop(void)
+{
+    seek_warp = 0;
+    resources_set_int("WarpMode", seek_warp_mode);
+}
+
 static void event_alarm_handler(CLOCK offset, void *data)
 {
     alarm_unset(event_alarm);
@@ -359,6 +400,10 @@ static void event_alarm_handler(CLOCK offset, void *data)
     /* when recording set a timestamp */
     if (record_active) {
         ui_display_event_time(current_timestamp++, 0);
+        if (event_keyframe_interval > 0
+            && current_timestamp % event_keyframe_interval == 0)
+            interrupt_maincpu_trigger_trap(event_record_keyframe_trap,
+                                           (void *)0);
         next_timestamp_clk = next_timestamp_clk 
                                 + machine_get_cycles_per_second();
         alarm_set(event_alarm, next_timestamp_clk);
@@ -407,11 +452,14 @@ static void event_alarm_handler(CLOCK offset, void *data)
 		    break;
 	    case EVENT_TIMESTAMP:
 		    ui_display_event_time(current_timestamp++, playback_time);
+		    if (seek_warp && current_timestamp > seek_timestamp)
+			    event_seek_warp_stop();
 		    break;
 	    case EVENT_LIST_END:
 		    event_playback_stop();
 		    break;
 	    case EVENT_OVERFLOW:
+	    case EVENT_KEYFRAME:
 		    break;
 	    default:
 	    #ifdef CELL_DEBUG
@@ -437,6 +485,7 @@ void event_playback_event_list(event_list_state_t *list)
 	    switch (current->type)
 	    {
 		    case EVENT_SYNC_TEST:
+		    case EVENT_KEYFRAME:
 			    break;
 		    case EVENT_KEYBOARD_DELAY:
 			    keyboard_register_delay(*(unsigned int*)current->data);
@@ -504,6 +553,45 @@ void event_init_image_list(void)
 	image_number = 0;
 }
 
+static void event_keyframe_add(unsigned int timestamp, event_list_t *event)
+{
+	if (keyframes_num == keyframes_max)
+	{
+		keyframes_max = keyframes_max ? keyframes_max * 2 : 16;
+		keyframes = lib_realloc(keyframes,
+				keyframes_max * sizeof(event_keyframe_t));
+	}
+
+	keyframes[keyframes_num].timestamp = timestamp;
+	keyframes[keyframes_num].event = event;
+	keyframes_num++;
+}
+
+static void event_keyframe_clear(void)
+{
+	lib_free(keyframes);
+	keyframes = NULL;
+	keyframes_num = 0;
+	keyframes_max = 0;
+}
+
+/* Return the last keyframe at or before `timestamp', NULL if none.  */
+static event_keyframe_t *event_keyframe_find(unsigned int timestamp)
+{
+	unsigned int lo = 0, hi = keyframes_num, mid;
+
+	while (lo < hi)
+	{
+		mid = (lo + hi) / 2;
+		if (keyframes[mid].timestamp <= timestamp)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo > 0 ? &keyframes[lo - 1] : NULL;
+}
+
 static void create_list(void)
 {
 	event_list = lib_malloc(sizeof(event_list_state_t));
@@ -553,6 +641,7 @@ void event_clear_list(event_list_state_t *list)
 
 static void destroy_list(void)
 {
+	event_keyframe_clear();
 	event_clear_list(event_list);
 	lib_free(event_list);
 	event_destroy_image_list();
@@ -687,6 +776,7 @@ static void event_record_start_trap(WORD addr, void *data)
 			current_timestamp = 0;
 			break;
 		case EVENT_START_MODE_PLAYBACK:
+			event_keyframe_clear();
 			cut_list(event_list->current->next);
 			event_list->current->next = NULL;
 			event_list->current->type = EVENT_LIST_END;
@@ -793,6 +883,10 @@ static void event_playback_start_trap(WORD addr, void *data)
 {
 	snapshot_t *s;
 	BYTE minor, major;
+	unsigned int start_seek;
+
+	start_seek = playback_start_seek;
+	playback_start_seek = 0;
 
 	event_version[0] = 0;
 
@@ -873,6 +967,9 @@ static void event_playback_start_trap(WORD addr, void *data)
 
 	ui_display_playback(1, event_version);
 
+	if (start_seek > 0)
+		event_playback_seek(start_seek);
+
 #ifdef  DEBUG
 	debug_start_playback();
 #endif
@@ -900,6 +997,9 @@ int event_playback_stop(void)
 
 	alarm_unset(event_alarm);
 
+	if (seek_warp)
+		event_seek_warp_stop();
+
 	ui_display_playback(0, NULL);
 
 #ifdef  DEBUG
@@ -909,6 +1009,68 @@ int event_playback_stop(void)
 	return 0;
 }
 
+static void event_playback_seek_trap(WORD addr, void *data)
+{
+	event_keyframe_t *k;
+
+	seek_pending = 0;
+
+	if (playback_active == 0)
+		return;
+
+	k = event_keyframe_find(seek_timestamp);
+
+	if (k != NULL && (current_timestamp > seek_timestamp
+				|| k->timestamp > current_timestamp))
+	{
+		if (machine_read_snapshot_memory(k->event->data, k->event->size, 0) < 0)
+		{
+#ifdef CELL_DEBUG
+			printf("ERROR: Cannot restore the keyframe at %u\n", k->timestamp);
+#endif
+			event_playback_stop();
+			return;
+		}
+		current_timestamp = k->timestamp;
+		event_list->current = k->event->next;
+		next_alarm_set();
+	}
+	else if (current_timestamp > seek_timestamp)
+	{
+		/* No keyframe before the target, start over.  */
+		alarm_unset(event_alarm);
+		playback_active = 0;
+		event_playback_start_trap(addr, data);
+		if (playback_active == 0)
+			return;
+	}
+
+	/* Warp over the rest.  */
+	if (current_timestamp <= seek_timestamp && !seek_warp)
+	{
+		resources_get_int("WarpMode", &seek_warp_mode);
+		resources_set_int("WarpMode", 1);
+		seek_warp = 1;
+	}
+}
+
+/* Continue playback at second `timestamp' of the history.  */
+int event_playback_seek(unsigned int timestamp)
+{
+	if (playback_active == 0)
+		return -1;
+
+	seek_timestamp = timestamp;
+
+	if (!seek_pending)
+	{
+		seek_pending = 1;
+		interrupt_maincpu_trigger_trap(event_playback_seek_trap, (void *)0);
+	}
+
+	return 0;
+}
+
 static void event_record_set_milestone_trap(WORD addr, void *data)
 {
 	if (machine_write_snapshot(event_snapshot_path(event_end_snapshot), 1, 1, 1) < 0)
@@ -996,12 +1158,79 @@ int event_playback_active(void)
 
 /*-----------------------------------------------------------------------*/
 
+#define EVENT_SNAP_MAJOR 1
+#define EVENT_SNAP_MINOR 0
+
+/* Since version 1 each event is stored as its type byte, followed by the
+   cycles since the previous event and the size of its data as variable
+   length numbers: 7 bits per byte, low bits first, bit 7 set if more
+   bytes follow.  Most events take 3 or 4 bytes instead of 12.  */
+static int event_write_number(snapshot_module_t *m, DWORD value)
+{
+	while (value >= 0x80)
+	{
+		if (SMW_B(m, (BYTE)(value | 0x80)) < 0)
+			return -1;
+		value >>= 7;
+	}
+
+	return SMW_B(m, (BYTE)value);
+}
+
+static int event_read_number(snapshot_module_t *m, DWORD *value)
+{
+	unsigned int shift = 0;
+	BYTE b;
+
+	*value = 0;
+
+	do {
+		if (shift > 28 || SMR_B(m, &b) < 0)
+			return -1;
+		*value |= (DWORD)(b & 0x7f) << shift;
+		shift += 7;
+	} while (b & 0x80);
+
+	return 0;
+}
+
+/* `clk' holds the clock of the previous event on entry.  */
+static int event_read_header(snapshot_module_t *m, BYTE major_version,
+		unsigned int *type, CLOCK *clk, unsigned int *size)
+{
+	DWORD value;
+	BYTE b;
+
+	if (major_version == 0)
+	{
+		if (SMR_DW_UINT(m, type) < 0
+				|| SMR_DW(m, clk) < 0
+				|| SMR_DW_UINT(m, size) < 0)
+			return -1;
+		return 0;
+	}
+
+	if (SMR_B(m, &b) < 0 || event_read_number(m, &value) < 0)
+		return -1;
+
+	*type = b;
+	*clk += value;
+
+	if (event_read_number(m, &value) < 0)
+		return -1;
+
+	*size = value;
+
+	return 0;
+}
+
 int event_snapshot_read_module(struct snapshot_s *s, int event_mode)
 {
 	snapshot_module_t *m;
 	BYTE major_version, minor_version;
 	event_list_t *curr;
 	unsigned int num_of_timestamps;
+	CLOCK clk = 0;
 
 	if (event_mode == 0)
 		return 0;
@@ -1023,7 +1252,6 @@ int event_snapshot_read_module(struct snapshot_s *s, int event_mode)
 	while (1)
 	{
 		unsigned int type, size;
-		CLOCK clk;
 		BYTE *data = NULL;
 
 		/* 
@@ -1031,17 +1259,7 @@ int event_snapshot_read_module(struct snapshot_s *s, int event_mode)
 		   1.14.x so there might exist history files with TIMESTAMP events)
 		 */
 		do {
-			if (SMR_DW_UINT(m, &(type)) < 0) {
-				snapshot_module_close(m);
-				return -1;
-			}
-
-			if (SMR_DW(m, &(clk)) < 0) {
-				snapshot_module_close(m);
-				return -1;
-			}
-
-			if (SMR_DW_UINT(m, &(size)) < 0) {
+			if (event_read_header(m, major_version, &type, &clk, &size) < 0) {
 				snapshot_module_close(m);
 				return -1;
 			}
@@ -1087,6 +1305,9 @@ int event_snapshot_read_module(struct snapshot_s *s, int event_mode)
 		curr->size = size;
 		curr->data = (size > 0 ? data : NULL);
 
+		if (type == EVENT_KEYFRAME)
+			event_keyframe_add(num_of_timestamps, curr);
+
 		if (type == EVENT_LIST_END)
 			break;
 
@@ -1109,11 +1330,12 @@ int event_snapshot_write_module(struct snapshot_s *s, int event_mode)
 {
 	snapshot_module_t *m;
 	event_list_t *curr;
+	CLOCK clk = 0;
 
 	if (event_mode == 0)
 		return 0;
 
-	m = snapshot_module_create(s, "EVENT", 0, 0);
+	m = snapshot_module_create(s, "EVENT", EVENT_SNAP_MAJOR, EVENT_SNAP_MINOR);
 
 	if (m == NULL)
 		return -1;
@@ -1121,14 +1343,15 @@ int event_snapshot_write_module(struct snapshot_s *s, int event_mode)
 	curr = event_list->base;
 
 	while (curr != NULL) {
-		if (curr->type != EVENT_TIMESTAMP
-				&& (0
-					|| SMW_DW(m, (DWORD)curr->type) < 0
-					|| SMW_DW(m, (DWORD)curr->clk) < 0
-					|| SMW_DW(m, (DWORD)curr->size) < 0
-					|| SMW_BA(m, curr->data, curr->size) < 0)) {
-			snapshot_module_close(m);
-			return -1;
+		if (curr->type != EVENT_TIMESTAMP) {
+			if (SMW_B(m, (BYTE)curr->type) < 0
+					|| event_write_number(m, (DWORD)(curr->clk - clk)) < 0
+					|| event_write_number(m, (DWORD)curr->size) < 0
+					|| SMW_BA(m, curr->data, curr->size) < 0) {
+				snapshot_module_close(m);
+				return -1;
+			}
+			clk = curr->clk;
 		}
 		curr = curr->next;
 	}
@@ -1191,6 +1414,15 @@ static int set_event_image_include(int enable, void *param)
     return 0;
 }
 
+static int set_event_keyframe_interval(int val, void *param)
+{
+    if (val < 0)
+        return -1;
+
+    event_keyframe_interval = val;
+    return 0;
+}
+
 static const resource_string_t resources_string[] = {
     { "EventSnapshotDir", 
       FSDEVICE_DEFAULT_DIR FSDEV_DIR_SEP_STR, RES_EVENT_NO, NULL,
@@ -1207,6 +1439,8 @@ static const resource_int_t resources_int[] = {
       &event_start_mode, set_event_start_mode, NULL },
     { "EventImageInclude", 1, RES_EVENT_NO, NULL,
       &event_image_include, set_event_image_include, NULL },
+    { "EventKeyframeInterval", 0, RES_EVENT_NO, NULL,
+      &event_keyframe_interval, set_event_keyframe_interval, NULL },
     { NULL }
 };
 
@@ -1235,12 +1469,39 @@ static int cmdline_help(const char *param, void *extra_param)
 	return event_playback_start();
 }
 
+static int cmdline_playback_seek(const char *param, void *extra_param)
+{
+	char *endptr;
+
+	playback_start_seek = (unsigned int)strtoul(param, &endptr, 10);
+	if (*param == '\0' || *endptr != '\0')
+		return -1;
+
+	if (event_playback_start() < 0)
+	{
+		playback_start_seek = 0;
+		return -1;
+	}
+
+	return 0;
+}
+
 static const cmdline_option_t cmdline_options[] = {
     { "-playback", CALL_FUNCTION, 0,
       cmdline_help, NULL, NULL, NULL,
       USE_PARAM_STRING, USE_DESCRIPTION_ID,
       IDCLS_UNUSED, IDCLS_PLAYBACK_RECORDED_EVENTS,
       NULL, NULL },
+    { "-playbackseek", CALL_FUNCTION, 1,
+      cmdline_playback_seek, NULL, NULL, NULL,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      T_("<seconds>"), T_("Playback recorded events from this second on") },
+    { "-eventkeyframes", SET_RESOURCE, 1,
+      NULL, NULL, "EventKeyframeInterval", NULL,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      T_("<seconds>"), T_("Seconds between keyframes in event histories (0: none)") },
     { NULL }
 };
 
@@ -46,6 +46,7 @@
 #define EVENT_SYNC_TEST         14
 #define EVENT_KEYBOARD_CLEAR    15
 #define EVENT_RESOURCE          16
+#define EVENT_KEYFRAME          17
 
 #define EVENT_START_MODE_FILE_SAVE 0
 #define EVENT_START_MODE_FILE_LOAD 1
@@ -87,6 +88,7 @@ extern int event_record_active(void);
 extern int event_playback_active(void);
 extern int event_record_set_milestone(void);
 extern int event_record_reset_milestone(void);
+extern int event_playback_seek(unsigned int timestamp);
 
 extern void event_reset_ack(void);
 
@@ -167,6 +167,20 @@ unsigned int fliplist_get_unit(fliplist_t fl)
     return fl->unit;
 }
 
+/* Have the image the next flip in `direction' attaches opened ahead.  */
+static void fliplist_prefetch(unsigned int unit, int direction)
+{
+    fliplist_t n;
+
+    if (fliplist[unit - 8] == NULL)
+        return;
+
+    n = direction ? fliplist[unit - 8]->next : fliplist[unit - 8]->prev;
+
+    if (n != fliplist[unit - 8])
+        file_system_prefetch_disk(n->unit, n->image);
+}
+
 void fliplist_add_image(unsigned int unit)
 {
     fliplist_t n;
@@ -193,6 +207,7 @@ void fliplist_add_image(unsigned int unit)
         n->prev = n;
     }
     show_fliplist(unit);
+    fliplist_prefetch(unit, 1);
 }
 
 void fliplist_remove(unsigned int unit, const char *image)
@@ -261,6 +276,8 @@ void fliplist_attach_head (unsigned int unit, int direction)
         /* shouldn't happen, so ignore it */
         ;
     }
+
+    fliplist_prefetch(unit, direction);
 }
 
 fliplist_t fliplist_init_iterate(unsigned int unit)
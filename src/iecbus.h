@@ -77,6 +77,18 @@ typedef struct iecbus_s {
 
     /*! \todo document */
     BYTE iec_fast_1541;
+
+    /*!
+     * nonzero while the drives run on worker threads; every drive then
+     * changes only its own output and reads its own drv_port_unit
+     */
+    int split;
+
+    /*! the computer output and the outputs of all other units */
+    BYTE drv_others[IECBUS_NUM];
+
+    /*! the drive input ports as seen by each drive while split */
+    BYTE drv_port_unit[IECBUS_NUM];
 } iecbus_t;
 
 extern iecbus_t iecbus;
@@ -95,5 +107,19 @@ extern BYTE iecbus_device_read(void);
 extern int  iecbus_device_write(unsigned int unit, BYTE data);
 extern void (*iecbus_update_ports)(void);
 
+extern void iecbus_split_ports(void);
+extern void iecbus_join_ports(void);
+
+/* Drive input port for the bus lines in `port'.  */
+#define IECBUS_DRV_PORT(port, cpu_bus) \
+    ((((port) >> 4) & 0x4) | ((port) >> 7) | (((cpu_bus) << 3) & 0x80))
+
+/* Update the input port of `unit' after it changed its own output while
+   the bus is split.  */
+#define IECBUS_DRV_PORT_UNIT_UPDATE(bus, unit)                          \
+    ((bus)->drv_port_unit[unit]                                         \
+        = IECBUS_DRV_PORT((bus)->drv_others[unit] & (bus)->drv_bus[unit], \
+                          (bus)->cpu_bus))
+
 #endif
 
@@ -192,6 +192,38 @@ void iecbus_init(void)
     iecbus.drv_port = IECBUS_DEVICE_READ_DATA
                       | IECBUS_DEVICE_READ_CLK
                       | IECBUS_DEVICE_READ_ATN;
+    iecbus.split = 0;
+}
+
+/* Give every unit its own view of the bus before the drives run in
+   parallel.  The computer does not run meanwhile, so `cpu_bus' stays
+   put.  */
+void iecbus_split_ports(void)
+{
+    unsigned int unit, other;
+    BYTE others;
+
+    for (unit = 4; unit < 8 + DRIVE_NUM; unit++) {
+        others = iecbus.cpu_bus;
+        for (other = 4; other < 8 + DRIVE_NUM; other++) {
+            if (other != unit)
+                others &= iecbus.drv_bus[other];
+        }
+
+        iecbus.drv_others[unit] = others;
+        IECBUS_DRV_PORT_UNIT_UPDATE(&iecbus, unit);
+    }
+
+    iecbus.split = 1;
+}
+
+/* Combine the outputs of all units again once the drives have met.  */
+void iecbus_join_ports(void)
+{
+    iecbus.split = 0;
+
+    if (iecbus_update_ports != NULL)
+        iecbus_update_ports();
 }
 
 void iecbus_cpu_undump(BYTE data)
@@ -30,6 +30,7 @@
 #include "archdep.h"
 #include "attach.h"
 #include "autostart.h"
+#include "batchrun.h"
 #include "cmdline.h"
 #include "console.h"
 #ifdef DEBUG
@@ -56,10 +57,13 @@
 #endif
 #include "network.h"
 #include "palette.h"
+#include "perfcount.h"
 #include "ram.h"
 #include "resources.h"
+#include "rewind.h"
 #include "romset.h"
 #include "screenshot.h"
+#include "snapshot.h"
 //#include "signals.h"
 #include "sysfile.h"
 #include "uiapi.h"
@@ -129,6 +133,22 @@ int init_resources(void)
         return -1;
     }
 #endif
+    if (batchrun_resources_init() < 0) {
+        init_resource_fail("batch run");
+        return -1;
+    }
+    if (rewind_resources_init() < 0) {
+        init_resource_fail("rewind");
+        return -1;
+    }
+    if (perfcount_resources_init() < 0) {
+        init_resource_fail("performance counters");
+        return -1;
+    }
+    if (snapshot_resources_init() < 0) {
+        init_resource_fail("snapshot");
+        return -1;
+    }
     if (machine_resources_init() < 0) {
         init_resource_fail("machine");
         return -1;
@@ -145,6 +165,10 @@ int init_resources(void)
         init_resource_fail("GFXOUTPUT");
         return -1;
     }
+    if (monitor_profile_resources_init() < 0) {
+        init_resource_fail("monitor profile");
+        return -1;
+    }
 #ifdef HAVE_NETWORK
     if (monitor_network_resources_init() < 0) {
         init_resource_fail("monitor");
@@ -214,6 +238,22 @@ int init_cmdline_options(void)
         return -1;
     }
 #endif
+    if (!vsid_mode && batchrun_cmdline_options_init() < 0) {
+        init_cmdline_options_fail("batch run");
+        return -1;
+    }
+    if (!vsid_mode && rewind_cmdline_options_init() < 0) {
+        init_cmdline_options_fail("rewind");
+        return -1;
+    }
+    if (perfcount_cmdline_options_init() < 0) {
+        init_cmdline_options_fail("performance counters");
+        return -1;
+    }
+    if (!vsid_mode && snapshot_cmdline_options_init() < 0) {
+        init_cmdline_options_fail("snapshot");
+        return -1;
+    }
     if (machine_cmdline_options_init() < 0) {
         init_cmdline_options_fail("machine");
         return -1;
@@ -239,6 +279,10 @@ int init_cmdline_options(void)
         init_cmdline_options_fail("GFXOUTPUT");
         return -1;
     }
+    if (monitor_profile_cmdline_options_init() < 0) {
+        init_cmdline_options_fail("MONITOR_PROFILE");
+        return -1;
+    }
 #ifdef HAVE_NETWORK
     if (monitor_network_cmdline_options_init() < 0) {
         init_cmdline_options_fail("MONITOR_NETWORK");
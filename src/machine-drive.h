@@ -44,6 +44,7 @@ extern void machine_drive_mem_init(struct drive_context_s *drv,
 extern void machine_drive_setup_context(struct drive_context_s *drv);
 extern void machine_drive_idling_method(unsigned int dnr);
 extern void machine_drive_vsync_hook(void);
+extern CLOCK machine_drive_disk_change_clk(unsigned int dnr);
 extern void machine_drive_rom_load(void);
 extern void machine_drive_rom_setup_image(unsigned int dnr);
 extern int machine_drive_rom_read(unsigned int type, WORD addr, BYTE *data);
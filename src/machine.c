@@ -34,6 +34,7 @@
 #include "archdep.h"
 #include "attach.h"
 #include "autostart.h"
+#include "batchrun.h"
 #include "clkguard.h"
 #include "cmdline.h"
 #include "console.h"
@@ -56,7 +57,9 @@
 #include "monitor_network.h"
 #endif
 #include "network.h"
+#include "perfcount.h"
 #include "printer.h"
+#include "rewind.h"
 #include "resources.h"
 #include "romset.h"
 #include "sound.h"
@@ -89,6 +92,7 @@ unsigned int machine_jam(const char *format, ...)
     va_start(ap, format);
 
     str = lib_mvsprintf(format, ap);
+    batchrun_check_jam(str);
     ret = ui_jam_dialog(str);
     lib_free(str);
 
@@ -207,6 +211,10 @@ void machine_shutdown(void)
 
     autostart_shutdown();
 
+    rewind_shutdown();
+
+    perfcount_shutdown();
+
 #ifdef HAS_JOYSTICK
     joystick_close();
 #endif
@@ -256,6 +264,7 @@ void machine_shutdown(void)
     ui_resources_shutdown();
     fliplist_resources_shutdown();
     romset_resources_shutdown();
+    monitor_profile_resources_shutdown();
 #ifdef HAVE_NETWORK
     monitor_network_resources_shutdown();
 #endif
@@ -28,6 +28,8 @@
 #ifndef VICE_MACHINE_H
 #define VICE_MACHINE_H
 
+#include <stddef.h>
+
 #include "types.h"
 
 /* The following stuff must be defined once per every emulated CBM machine.  */
@@ -133,6 +135,15 @@ extern int machine_write_snapshot(const char *name, int save_roms,
 /* Read a snapshot.  */
 extern int machine_read_snapshot(const char *name, int even_mode);
 
+/* Write a snapshot into a buffer allocated with lib_malloc().  */
+extern int machine_write_snapshot_memory(BYTE **data, size_t *size,
+                                         int save_roms, int save_disks,
+                                         int event_mode);
+
+/* Read a snapshot from a buffer.  */
+extern int machine_read_snapshot_memory(const BYTE *data, size_t size,
+                                        int event_mode);
+
 /* handle pending interrupts - needed by libsid.a.  */
 extern void machine_handle_pending_alarms(int num_write_cycles);
 
@@ -31,6 +31,7 @@
 
 #include "6510core.h"
 #include "alarm.h"
+#include "batchrun.h"
 
 #ifdef FEATURE_CPUMEMHISTORY
 #include "c64pla.h"
@@ -31,6 +31,7 @@
 
 #include "6510core.h"
 #include "alarm.h"
+#include "batchrun.h"
 #include "clkguard.h"
 #include "debug.h"
 #include "interrupt.h"
@@ -59,6 +59,7 @@ extern void mem_set_basic_text(WORD start, WORD end);
 extern void mem_toggle_watchpoints(int flag, void *context);
 extern int mem_rom_trap_allowed(WORD addr);
 extern void mem_set_bank_pointer(BYTE **base, int *limit);
+extern BYTE *mem_dma_ram_ptr(WORD addr, int store);
 extern void mem_color_ram_to_snapshot(BYTE *color_ram);
 extern void mem_color_ram_from_snapshot(BYTE *color_ram);
 
@@ -37,11 +37,19 @@
 #define any_watchpoints(mem) \
     (watchpoints_load[(mem)] || watchpoints_store[(mem)])
 
+/* Nonzero if `page' of `mem' contains a load/store watchpoint.  */
+#define monitor_watch_page_load(mem, page) \
+    (watchpoints_load_pages[(mem)][(page) & 0xff])
+#define monitor_watch_page_store(mem, page) \
+    (watchpoints_store_pages[(mem)][(page) & 0xff])
+
 enum mon_int {
     MI_NONE = 0,
     MI_BREAK = 1 << 0,
     MI_WATCH = 1 << 1,
-    MI_STEP = 1 << 2
+    MI_STEP = 1 << 2,
+    MI_PROFILE = 1 << 3,
+    MI_BATCHEXIT = 1 << 4
 };
 
 enum t_memspace {
@@ -106,7 +114,9 @@ struct monitor_interface_s {
 
     struct mem_ioreg_list_s *(*mem_ioreg_list_get)(void *context);
 
-    /* Pointer to a function to disable/enable watchpoint checking.  */
+    /* Pointer to a function to disable/enable watchpoint checking.  It is
+       called with value 1 again whenever the set of watched pages
+       changes.  */
     /*monitor_toggle_func_t *toggle_watchpoints_func;*/
     void (*toggle_watchpoints_func)(int value, void *context);
 
@@ -124,6 +134,8 @@ struct break_list_s;
 extern struct break_list_s *watchpoints_load[NUM_MEMSPACES];
 extern struct break_list_s *watchpoints_store[NUM_MEMSPACES];
 extern struct break_list_s *breakpoints[NUM_MEMSPACES];
+extern BYTE watchpoints_load_pages[NUM_MEMSPACES][0x100];
+extern BYTE watchpoints_store_pages[NUM_MEMSPACES][0x100];
 
 extern MEMSPACE caller_space;
 extern unsigned monitor_mask[NUM_MEMSPACES];
@@ -152,6 +164,12 @@ extern void monitor_cpu_type_set(const char *cpu_type);
 extern void monitor_watch_push_load_addr(WORD addr, MEMSPACE mem);
 extern void monitor_watch_push_store_addr(WORD addr, MEMSPACE mem);
 
+extern void monitor_profile_instruction(MEMSPACE mem, WORD addr, CLOCK clk);
+extern void monitor_profile_interrupt(MEMSPACE mem, CLOCK clk, int nmi);
+extern int monitor_profile_resources_init(void);
+extern void monitor_profile_resources_shutdown(void);
+extern int monitor_profile_cmdline_options_init(void);
+
 extern monitor_interface_t *monitor_interface_new(void);
 extern void monitor_interface_destroy(monitor_interface_t *monitor_interface);
 
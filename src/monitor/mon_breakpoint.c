@@ -68,6 +68,226 @@ typedef struct break_list_s break_list_t;
 static int breakpoint_count;
 break_list_t *breakpoints[NUM_MEMSPACES];
 
+/* Pages holding at least one load/store watchpoint, so the machine can
+   route only those pages through its watch handlers.  */
+BYTE watchpoints_load_pages[NUM_MEMSPACES][0x100];
+BYTE watchpoints_store_pages[NUM_MEMSPACES][0x100];
+
+/* The checkpoint lists stay the primary storage.  Every list is mirrored
+   by an interval tree kept in an array sorted by start address, where
+   each element is the root of the subtree spanning its half of the array
+   and stores the highest end address found in there.  Ranges wrapping
+   around $ffff are stored as two intervals.  */
+struct checkpoint_node_s {
+    unsigned int start;
+    unsigned int end;
+    unsigned int max_end;
+    int order;
+    breakpoint_t *brkpt;
+};
+typedef struct checkpoint_node_s checkpoint_node_t;
+
+struct checkpoint_tree_s {
+    checkpoint_node_t *nodes;
+    int count;
+};
+typedef struct checkpoint_tree_s checkpoint_tree_t;
+
+#define CHECKPOINT_TREE_BREAK       0
+#define CHECKPOINT_TREE_WATCH_LOAD  1
+#define CHECKPOINT_TREE_WATCH_STORE 2
+
+static checkpoint_tree_t checkpoint_trees[NUM_MEMSPACES][3];
+
+/* Upper limit of checkpoints reported for a single address.  */
+#define CHECKPOINT_HITS_MAX 64
+
+static int checkpoint_node_compare(const void *a, const void *b)
+{
+    const checkpoint_node_t *n1 = (const checkpoint_node_t *)a;
+    const checkpoint_node_t *n2 = (const checkpoint_node_t *)b;
+
+    if (n1->start != n2->start)
+        return (n1->start < n2->start) ? -1 : 1;
+
+    return n1->order - n2->order;
+}
+
+static unsigned int checkpoint_tree_augment(checkpoint_node_t *nodes,
+                                            int lo, int hi)
+{
+    int mid;
+    unsigned int max_end, sub_end;
+
+    if (lo >= hi)
+        return 0;
+
+    mid = (lo + hi) / 2;
+    max_end = nodes[mid].end;
+
+    sub_end = checkpoint_tree_augment(nodes, lo, mid);
+    if (sub_end > max_end)
+        max_end = sub_end;
+    sub_end = checkpoint_tree_augment(nodes, mid + 1, hi);
+    if (sub_end > max_end)
+        max_end = sub_end;
+
+    nodes[mid].max_end = max_end;
+    return max_end;
+}
+
+static void checkpoint_tree_build(checkpoint_tree_t *tree, break_list_t *head)
+{
+    break_list_t *ptr;
+    checkpoint_node_t *node;
+    unsigned int start, end;
+    int count, order;
+
+    lib_free(tree->nodes);
+    tree->nodes = NULL;
+    tree->count = 0;
+
+    for (count = 0, ptr = head; ptr; ptr = ptr->next)
+        count += 2;
+
+    if (count == 0)
+        return;
+
+    tree->nodes = lib_malloc(sizeof(checkpoint_node_t) * count);
+    node = tree->nodes;
+
+    for (order = 0, ptr = head; ptr; ptr = ptr->next, order++) {
+        start = addr_location(ptr->brkpt->start_addr);
+        end = start;
+        if (mon_is_valid_addr(ptr->brkpt->end_addr))
+            end = addr_location(ptr->brkpt->end_addr);
+
+        if (end < start) {
+            node->start = 0;
+            node->end = end;
+            node->order = order;
+            node->brkpt = ptr->brkpt;
+            node++;
+            end = 0xffff;
+        }
+        node->start = start;
+        node->end = end;
+        node->order = order;
+        node->brkpt = ptr->brkpt;
+        node++;
+    }
+
+    tree->count = (int)(node - tree->nodes);
+    qsort(tree->nodes, tree->count, sizeof(checkpoint_node_t),
+          checkpoint_node_compare);
+    checkpoint_tree_augment(tree->nodes, 0, tree->count);
+}
+
+static void checkpoint_tree_query(const checkpoint_node_t *nodes, int lo,
+                                  int hi, unsigned int loc,
+                                  const checkpoint_node_t **hits, int *num)
+{
+    int mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+
+        /* Nothing below this node reaches up to loc.  */
+        if (nodes[mid].max_end < loc)
+            return;
+
+        checkpoint_tree_query(nodes, lo, mid, loc, hits, num);
+
+        /* This node and everything to its right start after loc.  */
+        if (nodes[mid].start > loc)
+            return;
+
+        if (nodes[mid].end >= loc && *num < CHECKPOINT_HITS_MAX)
+            hits[(*num)++] = &nodes[mid];
+
+        lo = mid + 1;
+    }
+}
+
+/* Fill `hits' with the checkpoints covering loc, in list order.  */
+static int checkpoint_tree_search(const checkpoint_tree_t *tree,
+                                  unsigned int loc, breakpoint_t **hits)
+{
+    const checkpoint_node_t *found[CHECKPOINT_HITS_MAX];
+    const checkpoint_node_t *tmp;
+    int num = 0, i, j;
+
+    checkpoint_tree_query(tree->nodes, 0, tree->count, loc, found, &num);
+
+    for (i = 1; i < num; i++) {
+        tmp = found[i];
+        for (j = i; j > 0 && found[j - 1]->order > tmp->order; j--)
+            found[j] = found[j - 1];
+        found[j] = tmp;
+    }
+
+    for (i = 0; i < num; i++)
+        hits[i] = found[i]->brkpt;
+
+    return num;
+}
+
+static void watch_pages_update(BYTE *pages, const checkpoint_tree_t *tree)
+{
+    unsigned int page;
+    int i;
+
+    memset(pages, 0, 0x100);
+
+    for (i = 0; i < tree->count; i++) {
+        for (page = tree->nodes[i].start >> 8;
+             page <= (tree->nodes[i].end >> 8); page++) {
+            pages[page] = 1;
+        }
+    }
+}
+
+/* Rebuild the lookup structures after the list at head has changed.  */
+static void checkpoint_list_changed(break_list_t **head)
+{
+    int i;
+
+    for (i = FIRST_SPACE; i <= LAST_SPACE; i++) {
+        if (head == &breakpoints[i]) {
+            checkpoint_tree_build(&checkpoint_trees[i][CHECKPOINT_TREE_BREAK],
+                                  *head);
+            return;
+        }
+        if (head == &watchpoints_load[i]) {
+            checkpoint_tree_build(&checkpoint_trees[i][CHECKPOINT_TREE_WATCH_LOAD],
+                                  *head);
+            watch_pages_update(watchpoints_load_pages[i],
+                               &checkpoint_trees[i][CHECKPOINT_TREE_WATCH_LOAD]);
+            return;
+        }
+        if (head == &watchpoints_store[i]) {
+            checkpoint_tree_build(&checkpoint_trees[i][CHECKPOINT_TREE_WATCH_STORE],
+                                  *head);
+            watch_pages_update(watchpoints_store_pages[i],
+                               &checkpoint_trees[i][CHECKPOINT_TREE_WATCH_STORE]);
+            return;
+        }
+    }
+}
+
+static checkpoint_tree_t *checkpoint_tree_find(MEMSPACE mem,
+                                               break_list_t *list)
+{
+    if (list == breakpoints[mem])
+        return &checkpoint_trees[mem][CHECKPOINT_TREE_BREAK];
+    if (list == watchpoints_load[mem])
+        return &checkpoint_trees[mem][CHECKPOINT_TREE_WATCH_LOAD];
+    if (list == watchpoints_store[mem])
+        return &checkpoint_trees[mem][CHECKPOINT_TREE_WATCH_STORE];
+
+    return NULL;
+}
+
 void mon_breakpoint_init(void)
 {
     breakpoint_count = 1;
@@ -102,6 +322,7 @@ static void remove_checkpoint_from_list(break_list_t **head, breakpoint_t *bp)
 		else
 			prev_entry->next = cur_entry->next;
 		lib_free(cur_entry);
+		checkpoint_list_changed(head);
 	}
 }
 
@@ -259,7 +480,11 @@ void mon_breakpoint_delete_checkpoint(int brknum)
                     mon_interfaces[mem]->context);
 
                 if (!monitor_mask[mem])
-                    interrupt_monitor_trap_off(mon_interfaces[mem]->int_status);            }
+                    interrupt_monitor_trap_off(mon_interfaces[mem]->int_status);
+            } else {
+                mon_interfaces[mem]->toggle_watchpoints_func(1,
+                    mon_interfaces[mem]->context);
+            }
         }
     }
     if (bp != NULL) {
@@ -301,24 +526,15 @@ void mon_breakpoint_set_checkpoint_command(int brk_num, char *cmd)
     }
 }
 
-static break_list_t *search_checkpoint_list(break_list_t *head, unsigned loc)
+static breakpoint_t *search_breakpoint(MEMSPACE mem, unsigned loc)
 {
-    break_list_t *cur_entry;
-
-    cur_entry = head;
-
-    /* The list should be sorted in increasing order. If the current entry
-       is > than the search item, we can drop out early.
-    */
-    while (cur_entry) {
-        if (mon_is_in_range(cur_entry->brkpt->start_addr,
-            cur_entry->brkpt->end_addr, loc))
-            return cur_entry;
+    breakpoint_t *hits[CHECKPOINT_HITS_MAX];
 
-        cur_entry = cur_entry->next;
-    }
+    if (checkpoint_tree_search(&checkpoint_trees[mem][CHECKPOINT_TREE_BREAK],
+                               loc, hits) == 0)
+        return NULL;
 
-    return NULL;
+    return hits[0];
 }
 
 static int compare_checkpoints(breakpoint_t *bp1, breakpoint_t *bp2)
@@ -344,18 +560,21 @@ static int compare_checkpoints(breakpoint_t *bp1, breakpoint_t *bp2)
 bool monitor_breakpoint_check_checkpoint(MEMSPACE mem, WORD addr,
                                          break_list_t *list)
 {
-    break_list_t *ptr;
+    checkpoint_tree_t *tree;
+    breakpoint_t *hits[CHECKPOINT_HITS_MAX];
     breakpoint_t *bp;
     bool result = FALSE;
     MON_ADDR temp;
     const char *type;
+    int num, i;
+
+    if (list == NULL || (tree = checkpoint_tree_find(mem, list)) == NULL)
+        return FALSE;
 
-    ptr = search_checkpoint_list(list, addr);
+    num = checkpoint_tree_search(tree, addr, hits);
 
-    while (ptr && mon_is_in_range(ptr->brkpt->start_addr,
-           ptr->brkpt->end_addr, addr)) {
-        bp = ptr->brkpt;
-        ptr = ptr->next;
+    for (i = 0; i < num; i++) {
+        bp = hits[i];
         if (bp && bp->enabled==e_ON) {
             /* If condition test fails, skip this checkpoint */
             if (bp->condition) {
@@ -414,10 +633,8 @@ static void add_to_checkpoint_list(break_list_t **head, breakpoint_t *bp)
     prev_entry = NULL;
 
     /* Make sure the list is in increasing order. (Ranges are entered
-       based on the lower bound) This way if the searched for address is
-       less than the current ptr, we can skip the rest of the list. Note
-       that ranges that wrap around 0xffff aren't handled in this scheme.
-       Suggestion: Split the range and create two entries.
+       based on the lower bound) The checkpoint tree reports hits in this
+       order.
     */
     while (cur_entry && (compare_checkpoints(cur_entry->brkpt, bp) <= 0) ) {
         prev_entry = cur_entry;
@@ -426,12 +643,12 @@ static void add_to_checkpoint_list(break_list_t **head, breakpoint_t *bp)
 
     if (!prev_entry) {
         *head = new_entry;
-        new_entry->next = cur_entry;
-        return;
+    } else {
+        prev_entry->next = new_entry;
     }
-
-    prev_entry->next = new_entry;
     new_entry->next = cur_entry;
+
+    checkpoint_list_changed(head);
 }
 
 static 
@@ -470,8 +687,6 @@ int breakpoint_add_checkpoint(MON_ADDR start_addr, MON_ADDR end_addr,
     } else {
         if (!any_watchpoints(mem)) {
             monitor_mask[mem] |= MI_WATCH;
-            mon_interfaces[mem]->toggle_watchpoints_func(1,
-                mon_interfaces[mem]->context);
             interrupt_monitor_trap_on(mon_interfaces[mem]->int_status);
         }
 
@@ -479,6 +694,10 @@ int breakpoint_add_checkpoint(MON_ADDR start_addr, MON_ADDR end_addr,
             add_to_checkpoint_list(&(watchpoints_load[mem]), new_bp);
         if (is_store)
             add_to_checkpoint_list(&(watchpoints_store[mem]), new_bp);
+
+        /* Called on every change so that the watched pages get updated.  */
+        mon_interfaces[mem]->toggle_watchpoints_func(1,
+            mon_interfaces[mem]->context);
     }
 
     if (is_temp)
@@ -503,27 +722,27 @@ mon_breakpoint_type_t mon_breakpoint_is(MON_ADDR address)
 {
     MEMSPACE mem = addr_memspace(address);
     WORD addr = addr_location(address);
-    break_list_t *ptr;
+    breakpoint_t *bp;
 
-    ptr = search_checkpoint_list(breakpoints[mem], addr);
+    bp = search_breakpoint(mem, addr);
     
-    if (!ptr)
+    if (!bp)
         return BP_NONE;
 
-    return (ptr->brkpt->enabled == e_ON) ? BP_ACTIVE : BP_INACTIVE;
+    return (bp->enabled == e_ON) ? BP_ACTIVE : BP_INACTIVE;
 }
 
 void mon_breakpoint_set(MON_ADDR address)
 {
     MEMSPACE mem = addr_memspace(address);
     WORD addr = addr_location(address);
-    break_list_t *ptr;
+    breakpoint_t *bp;
 
-    ptr = search_checkpoint_list(breakpoints[mem], addr);
+    bp = search_breakpoint(mem, addr);
     
-    if (ptr) {
+    if (bp) {
         /* there's a breakpoint, so enable it */
-        ptr->brkpt->enabled = e_ON;
+        bp->enabled = e_ON;
     } else {
         /* there's no breakpoint, so set a new one */
         breakpoint_add_checkpoint(address, address,
@@ -535,13 +754,13 @@ void mon_breakpoint_unset(MON_ADDR address)
 {
     MEMSPACE mem = addr_memspace(address);
     WORD addr = addr_location(address);
-    break_list_t *ptr;
+    breakpoint_t *bp;
 
-    ptr = search_checkpoint_list(breakpoints[mem], addr);
+    bp = search_breakpoint(mem, addr);
     
-    if (ptr) {
+    if (bp) {
         /* there's a breakpoint, so remove it */
-        remove_checkpoint_from_list( &breakpoints[mem], ptr->brkpt );
+        remove_checkpoint_from_list( &breakpoints[mem], bp );
     }
 }
 
@@ -549,13 +768,13 @@ void mon_breakpoint_enable(MON_ADDR address)
 {
     MEMSPACE mem = addr_memspace(address);
     WORD addr = addr_location(address);
-    break_list_t *ptr;
+    breakpoint_t *bp;
 
-    ptr = search_checkpoint_list(breakpoints[mem], addr);
+    bp = search_breakpoint(mem, addr);
     
-    if (ptr) {
+    if (bp) {
         /* there's a breakpoint, so enable it */
-        ptr->brkpt->enabled = e_ON;
+        bp->enabled = e_ON;
     }
 }
 
@@ -563,13 +782,13 @@ void mon_breakpoint_disable(MON_ADDR address)
 {
     MEMSPACE mem = addr_memspace(address);
     WORD addr = addr_location(address);
-    break_list_t *ptr;
+    breakpoint_t *bp;
 
-    ptr = search_checkpoint_list(breakpoints[mem], addr);
+    bp = search_breakpoint(mem, addr);
     
-    if (ptr) {
+    if (bp) {
         /* there's a breakpoint, so disable it */
-        ptr->brkpt->enabled = e_OFF;
+        bp->enabled = e_OFF;
     }
 }
 
@@ -0,0 +1,802 @@
+/*
+ * mon_profile.c - The VICE built-in monitor profiler.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* The profiler hooks into the monitor trap of every CPU it watches, so
+   nothing is spent on it while it is off.  Before each instruction the
+   cycles since the previous one are charged to the previous instruction
+   and to the function it belongs to.  Functions are entered through JSR,
+   BRK, IRQ and NMI; a function has returned as soon as the stack pointer
+   rises above the value it had on entry, which also covers RTS, RTI and
+   code that drops its return address from the stack.  */
+
+#include "vice.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "archdep.h"
+#include "cmdline.h"
+#include "interrupt.h"
+#include "lib.h"
+#include "mon_disassemble.h"
+#include "mon_profile.h"
+#include "monitor.h"
+#include "montypes.h"
+#include "resources.h"
+#include "translate.h"
+#include "util.h"
+
+
+#define PROFILE_STACK_SIZE 256
+#define PROFILE_HASH_SIZE 1024
+
+#define PROFILE_OP_BRK 0x00
+#define PROFILE_OP_JSR 0x20
+
+enum profile_kind_e {
+    PROFILE_ROOT,
+    PROFILE_SUB,
+    PROFILE_IRQ,
+    PROFILE_NMI
+};
+
+/* Cycles spent at `pc' inside the function at `fn', or the calls from
+   `pc' inside `fn' to `callee'.  */
+struct profile_cost_s {
+    WORD fn;
+    WORD pc;
+    WORD callee;
+    CLOCK cycles;
+    CLOCK calls;
+    struct profile_cost_s *next;
+};
+typedef struct profile_cost_s profile_cost_t;
+
+struct profile_func_s {
+    WORD addr;
+    CLOCK self;
+    CLOCK total;
+    CLOCK calls;
+    CLOCK irqs;
+    CLOCK nmis;
+    struct profile_func_s *next;
+};
+typedef struct profile_func_s profile_func_t;
+
+struct profile_frame_s {
+    WORD fn;
+    WORD call_pc;
+    unsigned int sp;
+    CLOCK entry;
+    profile_func_t *func;
+};
+typedef struct profile_frame_s profile_frame_t;
+
+struct profile_s {
+    int started;
+    int pending_int;
+    CLOCK last_clk;
+    CLOCK clk;
+    WORD last_pc;
+    BYTE last_op;
+    int depth;
+    profile_frame_t stack[PROFILE_STACK_SIZE];
+    profile_cost_t *self_hash[PROFILE_HASH_SIZE];
+    profile_cost_t *call_hash[PROFILE_HASH_SIZE];
+    profile_func_t *func_hash[PROFILE_HASH_SIZE];
+};
+typedef struct profile_s profile_t;
+
+static profile_t *profiles[NUM_MEMSPACES];
+
+static int monitor_ready = 0;
+
+/* ------------------------------------------------------------------------- */
+
+static unsigned int profile_hash(WORD fn, WORD pc)
+{
+    return (fn * 31 + pc) & (PROFILE_HASH_SIZE - 1);
+}
+
+static profile_cost_t *profile_cost_get(profile_cost_t **table, WORD fn,
+                                        WORD pc, WORD callee)
+{
+    profile_cost_t *cost, **bucket;
+
+    bucket = &table[profile_hash(fn, (WORD)(pc ^ callee))];
+
+    for (cost = *bucket; cost; cost = cost->next) {
+        if (cost->fn == fn && cost->pc == pc && cost->callee == callee)
+            return cost;
+    }
+
+    cost = lib_calloc(1, sizeof(profile_cost_t));
+    cost->fn = fn;
+    cost->pc = pc;
+    cost->callee = callee;
+    cost->next = *bucket;
+    *bucket = cost;
+
+    return cost;
+}
+
+static profile_func_t *profile_func_get(profile_t *p, WORD addr)
+{
+    profile_func_t *func, **bucket;
+
+    bucket = &p->func_hash[profile_hash(addr, 0)];
+
+    for (func = *bucket; func; func = func->next) {
+        if (func->addr == addr)
+            return func;
+    }
+
+    func = lib_calloc(1, sizeof(profile_func_t));
+    func->addr = addr;
+    func->next = *bucket;
+    *bucket = func;
+
+    return func;
+}
+
+static void profile_clear(profile_t *p)
+{
+    profile_cost_t *cost, *cost_next;
+    profile_func_t *func, *func_next;
+    int i;
+
+    for (i = 0; i < PROFILE_HASH_SIZE; i++) {
+        for (cost = p->self_hash[i]; cost; cost = cost_next) {
+            cost_next = cost->next;
+            lib_free(cost);
+        }
+        for (cost = p->call_hash[i]; cost; cost = cost_next) {
+            cost_next = cost->next;
+            lib_free(cost);
+        }
+        for (func = p->func_hash[i]; func; func = func_next) {
+            func_next = func->next;
+            lib_free(func);
+        }
+    }
+
+    memset(p, 0, sizeof(profile_t));
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* Advance the profile clock to `clk'.  The CPU clock goes backwards on
+   reset and clock overflow, the cycles in between are lost.  */
+static CLOCK profile_advance(profile_t *p, CLOCK clk)
+{
+    CLOCK delta;
+
+    delta = (clk >= p->last_clk) ? clk - p->last_clk : 0;
+    p->last_clk = clk;
+    p->clk += delta;
+
+    return delta;
+}
+
+static void profile_charge(profile_t *p, WORD pc, CLOCK cycles)
+{
+    profile_frame_t *top = &p->stack[p->depth - 1];
+
+    profile_cost_get(p->self_hash, top->fn, pc, 0)->cycles += cycles;
+    top->func->self += cycles;
+}
+
+/* Recursive calls only count once towards the inclusive cycles.  */
+static int profile_on_stack(profile_t *p, WORD fn, int depth)
+{
+    int i;
+
+    for (i = 0; i < depth; i++) {
+        if (p->stack[i].fn == fn)
+            return 1;
+    }
+    return 0;
+}
+
+static void profile_push(profile_t *p, WORD fn, WORD call_pc, unsigned int sp,
+                         CLOCK entry, int kind)
+{
+    profile_frame_t *frame;
+    profile_func_t *func;
+
+    func = profile_func_get(p, fn);
+
+    switch (kind) {
+      case PROFILE_IRQ:
+        func->irqs++;
+        break;
+      case PROFILE_NMI:
+        func->nmis++;
+        break;
+      default:
+        func->calls++;
+        break;
+    }
+
+    /* Only runaway code gets this deep, keep the outer frames.  */
+    if (p->depth == PROFILE_STACK_SIZE)
+        return;
+
+    frame = &p->stack[p->depth++];
+    frame->fn = fn;
+    frame->call_pc = call_pc;
+    frame->sp = sp;
+    frame->entry = entry;
+    frame->func = func;
+}
+
+static void profile_pop(profile_t *p)
+{
+    profile_frame_t *frame, *caller;
+    profile_cost_t *call;
+    CLOCK cycles;
+
+    frame = &p->stack[--p->depth];
+    caller = &p->stack[p->depth - 1];
+    cycles = p->clk - frame->entry;
+
+    call = profile_cost_get(p->call_hash, caller->fn, frame->call_pc,
+                            frame->fn);
+    call->calls++;
+    call->cycles += cycles;
+
+    if (!profile_on_stack(p, frame->fn, p->depth))
+        frame->func->total += cycles;
+}
+
+/* Add (sign 1) or take back (sign -1) the cycles of the frames which are
+   still active, so that they show up in a profile written meanwhile.  */
+static void profile_open_frames(profile_t *p, int sign)
+{
+    profile_frame_t *frame;
+    profile_cost_t *call;
+    CLOCK cycles;
+    int i;
+
+    for (i = 0; i < p->depth; i++) {
+        frame = &p->stack[i];
+        cycles = p->clk - frame->entry;
+
+        if (!profile_on_stack(p, frame->fn, i)) {
+            frame->func->total += (sign > 0) ? cycles : -cycles;
+        }
+        if (i > 0) {
+            call = profile_cost_get(p->call_hash, p->stack[i - 1].fn,
+                                    frame->call_pc, frame->fn);
+            call->calls += sign;
+            call->cycles += (sign > 0) ? cycles : -cycles;
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+
+void monitor_profile_instruction(MEMSPACE mem, WORD addr, CLOCK clk)
+{
+    profile_t *p = profiles[mem];
+    unsigned int sp;
+    CLOCK delta, entry;
+    WORD fn;
+
+    if (p == NULL)
+        return;
+
+    sp = (monitor_cpu_for_memspace[mem]->mon_register_get_val)(mem, e_SP);
+
+    if (!p->started) {
+        p->started = 1;
+        p->last_clk = clk;
+        p->last_pc = addr;
+        p->last_op = mon_get_mem_val(mem, addr);
+        /* The root frame lies above the whole stack and is never left.  */
+        p->depth = 0;
+        profile_push(p, addr, addr, 0x100, 0, PROFILE_ROOT);
+        return;
+    }
+
+    delta = profile_advance(p, clk);
+    if (!p->pending_int)
+        profile_charge(p, p->last_pc, delta);
+
+    while (p->depth > 1 && sp > p->stack[p->depth - 1].sp)
+        profile_pop(p);
+
+    /* The interrupt sequence is part of the handler.  */
+    entry = p->pending_int ? p->clk - delta : p->clk;
+
+    if (p->last_op == PROFILE_OP_JSR) {
+        fn = addr;
+        if (p->pending_int) {
+            /* Interrupted before the first instruction of the callee.  */
+            fn = (WORD)(mon_get_mem_val(mem, (WORD)(p->last_pc + 1))
+                 | (mon_get_mem_val(mem, (WORD)(p->last_pc + 2)) << 8));
+        }
+        profile_push(p, fn, p->last_pc, p->pending_int ? sp + 3 : sp,
+                     entry, PROFILE_SUB);
+    } else if (p->last_op == PROFILE_OP_BRK && !p->pending_int) {
+        profile_push(p, addr, p->last_pc, sp, entry, PROFILE_IRQ);
+    }
+
+    if (p->pending_int) {
+        profile_push(p, addr, p->last_pc, sp, entry, p->pending_int);
+        profile_charge(p, addr, delta);
+        p->pending_int = 0;
+    }
+
+    p->last_pc = addr;
+    p->last_op = mon_get_mem_val(mem, addr);
+}
+
+void monitor_profile_interrupt(MEMSPACE mem, CLOCK clk, int nmi)
+{
+    profile_t *p = profiles[mem];
+
+    if (p == NULL || !p->started)
+        return;
+
+    profile_charge(p, p->last_pc, profile_advance(p, clk));
+    p->pending_int = nmi ? PROFILE_NMI : PROFILE_IRQ;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static int profile_have_data(void)
+{
+    int i;
+
+    for (i = FIRST_SPACE; i <= LAST_SPACE; i++) {
+        if (profiles[i] != NULL && profiles[i]->started)
+            return 1;
+    }
+    return 0;
+}
+
+static char *profile_func_name(MEMSPACE mem, WORD addr)
+{
+    const char *label;
+
+    label = mon_symbol_table_lookup_name(mem, addr);
+    if (label != NULL)
+        return lib_msprintf("%s:%s", mon_memspace_string[mem], label);
+
+    return lib_msprintf("%s:$%04x", mon_memspace_string[mem], addr);
+}
+
+static double profile_percent(CLOCK part, CLOCK whole)
+{
+    return whole ? (100.0 * part) / whole : 0.0;
+}
+
+static int profile_compare_cycles(const void *a, const void *b)
+{
+    const profile_cost_t *c1 = *(const profile_cost_t * const *)a;
+    const profile_cost_t *c2 = *(const profile_cost_t * const *)b;
+
+    if (c1->cycles != c2->cycles)
+        return (c1->cycles > c2->cycles) ? -1 : 1;
+
+    return (int)c1->pc - (int)c2->pc;
+}
+
+static int profile_compare_total(const void *a, const void *b)
+{
+    const profile_func_t *f1 = *(const profile_func_t * const *)a;
+    const profile_func_t *f2 = *(const profile_func_t * const *)b;
+
+    if (f1->total != f2->total)
+        return (f1->total > f2->total) ? -1 : 1;
+
+    return (int)f1->addr - (int)f2->addr;
+}
+
+static int profile_compare_site(const void *a, const void *b)
+{
+    const profile_cost_t *c1 = *(const profile_cost_t * const *)a;
+    const profile_cost_t *c2 = *(const profile_cost_t * const *)b;
+
+    if (c1->fn != c2->fn)
+        return (int)c1->fn - (int)c2->fn;
+    if (c1->pc != c2->pc)
+        return (int)c1->pc - (int)c2->pc;
+
+    return (int)c1->callee - (int)c2->callee;
+}
+
+static profile_cost_t **profile_cost_list(profile_cost_t **table, int *count)
+{
+    profile_cost_t *cost, **list;
+    int i, n = 0;
+
+    for (i = 0; i < PROFILE_HASH_SIZE; i++) {
+        for (cost = table[i]; cost; cost = cost->next)
+            n++;
+    }
+
+    list = lib_malloc(sizeof(profile_cost_t *) * (n + 1));
+
+    for (n = 0, i = 0; i < PROFILE_HASH_SIZE; i++) {
+        for (cost = table[i]; cost; cost = cost->next)
+            list[n++] = cost;
+    }
+
+    *count = n;
+    return list;
+}
+
+static profile_func_t **profile_func_list(profile_t *p, int *count)
+{
+    profile_func_t *func, **list;
+    int i, n = 0;
+
+    for (i = 0; i < PROFILE_HASH_SIZE; i++) {
+        for (func = p->func_hash[i]; func; func = func->next)
+            n++;
+    }
+
+    list = lib_malloc(sizeof(profile_func_t *) * (n + 1));
+
+    for (n = 0, i = 0; i < PROFILE_HASH_SIZE; i++) {
+        for (func = p->func_hash[i]; func; func = func->next)
+            list[n++] = func;
+    }
+
+    *count = n;
+    return list;
+}
+
+static void profile_write_flat_space(FILE *fp, MEMSPACE mem, profile_t *p)
+{
+    profile_cost_t **costs, *pcs;
+    profile_func_t **funcs;
+    const char *dis;
+    char *name;
+    unsigned int len;
+    int num_costs, num_funcs, num_pcs, i;
+
+    fprintf(fp, "%s: %lu cycles\n\n", _mon_space_strings[mem],
+            (unsigned long)p->clk);
+
+    /* Sum up the cycles per address over all functions.  */
+    costs = profile_cost_list(p->self_hash, &num_costs);
+    pcs = lib_calloc(0x10000, sizeof(profile_cost_t));
+    for (i = 0; i < num_costs; i++) {
+        pcs[costs[i]->pc].pc = costs[i]->pc;
+        pcs[costs[i]->pc].cycles += costs[i]->cycles;
+    }
+    for (num_pcs = 0, i = 0; i < 0x10000; i++) {
+        if (pcs[i].cycles != 0)
+            costs[num_pcs++] = &pcs[i];
+    }
+    qsort(costs, num_pcs, sizeof(profile_cost_t *), profile_compare_cycles);
+
+    fprintf(fp, "Cycles per address:\n");
+    fprintf(fp, "    cycles       %%  addr  instruction\n");
+    for (i = 0; i < num_pcs; i++) {
+        dis = mon_disassemble_to_string_ex(mem, costs[i]->pc,
+                  mon_get_mem_val(mem, costs[i]->pc),
+                  mon_get_mem_val(mem, (WORD)(costs[i]->pc + 1)),
+                  mon_get_mem_val(mem, (WORD)(costs[i]->pc + 2)),
+                  mon_get_mem_val(mem, (WORD)(costs[i]->pc + 3)),
+                  1, &len);
+        fprintf(fp, "%10lu  %6.2f  %04x  %s\n",
+                (unsigned long)costs[i]->cycles,
+                profile_percent(costs[i]->cycles, p->clk), costs[i]->pc, dis);
+    }
+    lib_free(pcs);
+    lib_free(costs);
+
+    funcs = profile_func_list(p, &num_funcs);
+    qsort(funcs, num_funcs, sizeof(profile_func_t *), profile_compare_total);
+
+    fprintf(fp, "\nCycles per subroutine:\n");
+    fprintf(fp, "     total       %%      self       %%     calls  function\n");
+    for (i = 0; i < num_funcs; i++) {
+        name = profile_func_name(mem, funcs[i]->addr);
+        fprintf(fp, "%10lu  %6.2f  %8lu  %6.2f  %8lu  %s\n",
+                (unsigned long)funcs[i]->total,
+                profile_percent(funcs[i]->total, p->clk),
+                (unsigned long)funcs[i]->self,
+                profile_percent(funcs[i]->self, p->clk),
+                (unsigned long)funcs[i]->calls, name);
+        lib_free(name);
+    }
+
+    fprintf(fp, "\nCycles per interrupt handler:\n");
+    fprintf(fp, "     total       %%      irqs      nmis   average  handler\n");
+    for (i = 0; i < num_funcs; i++) {
+        if (funcs[i]->irqs == 0 && funcs[i]->nmis == 0)
+            continue;
+        name = profile_func_name(mem, funcs[i]->addr);
+        fprintf(fp, "%10lu  %6.2f  %8lu  %8lu  %8lu  %s\n",
+                (unsigned long)funcs[i]->total,
+                profile_percent(funcs[i]->total, p->clk),
+                (unsigned long)funcs[i]->irqs,
+                (unsigned long)funcs[i]->nmis,
+                (unsigned long)(funcs[i]->total
+                                / (funcs[i]->irqs + funcs[i]->nmis)),
+                name);
+        lib_free(name);
+    }
+    fprintf(fp, "\n");
+
+    lib_free(funcs);
+}
+
+static void profile_write_callgrind_space(FILE *fp, MEMSPACE mem,
+                                          profile_t *p)
+{
+    profile_cost_t **costs, **calls;
+    char *name;
+    int num_costs, num_calls, i, j;
+    int fn = -1;
+
+    fprintf(fp, "\nob=%s\n", _mon_space_strings[mem]);
+
+    costs = profile_cost_list(p->self_hash, &num_costs);
+    calls = profile_cost_list(p->call_hash, &num_calls);
+    qsort(costs, num_costs, sizeof(profile_cost_t *), profile_compare_site);
+    qsort(calls, num_calls, sizeof(profile_cost_t *), profile_compare_site);
+
+    /* Both lists are sorted by function, merge them.  */
+    for (i = 0, j = 0; i < num_costs || j < num_calls; ) {
+        if (j >= num_calls
+            || (i < num_costs && costs[i]->fn <= calls[j]->fn)) {
+            if (costs[i]->fn != fn) {
+                fn = costs[i]->fn;
+                name = profile_func_name(mem, (WORD)fn);
+                fprintf(fp, "fn=%s\n", name);
+                lib_free(name);
+            }
+            if (costs[i]->cycles != 0) {
+                fprintf(fp, "0x%04x %lu\n", costs[i]->pc,
+                        (unsigned long)costs[i]->cycles);
+            }
+            i++;
+        } else {
+            if (calls[j]->fn != fn) {
+                fn = calls[j]->fn;
+                name = profile_func_name(mem, (WORD)fn);
+                fprintf(fp, "fn=%s\n", name);
+                lib_free(name);
+            }
+            if (calls[j]->calls != 0) {
+                name = profile_func_name(mem, calls[j]->callee);
+                fprintf(fp, "cfn=%s\n", name);
+                fprintf(fp, "calls=%lu 0x%04x\n",
+                        (unsigned long)calls[j]->calls, calls[j]->callee);
+                fprintf(fp, "0x%04x %lu\n", calls[j]->pc,
+                        (unsigned long)calls[j]->cycles);
+                lib_free(name);
+            }
+            j++;
+        }
+    }
+
+    lib_free(costs);
+    lib_free(calls);
+}
+
+static int profile_write(const char *filename, int callgrind)
+{
+    FILE *fp;
+    CLOCK summary = 0;
+    int i;
+
+    if (NULL == (fp = fopen(filename, MODE_WRITE_TEXT)))
+        return -1;
+
+    for (i = FIRST_SPACE; i <= LAST_SPACE; i++) {
+        if (profiles[i] != NULL && profiles[i]->started) {
+            profile_open_frames(profiles[i], 1);
+            summary += profiles[i]->clk;
+        }
+    }
+
+    if (callgrind) {
+        fprintf(fp, "# callgrind format\n");
+        fprintf(fp, "version: 1\n");
+        fprintf(fp, "creator: VICE\n");
+        fprintf(fp, "positions: instr\n");
+        fprintf(fp, "events: Cycles\n");
+        fprintf(fp, "summary: %lu\n", (unsigned long)summary);
+    }
+
+    for (i = FIRST_SPACE; i <= LAST_SPACE; i++) {
+        if (profiles[i] == NULL || !profiles[i]->started)
+            continue;
+        if (callgrind)
+            profile_write_callgrind_space(fp, i, profiles[i]);
+        else
+            profile_write_flat_space(fp, i, profiles[i]);
+        profile_open_frames(profiles[i], -1);
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static int profile_enabled;
+static char *profile_flat_file = NULL;
+static char *profile_callgrind_file = NULL;
+
+static void profile_start(void)
+{
+    int i;
+
+    for (i = FIRST_SPACE; i <= LAST_SPACE; i++) {
+        if (mon_interfaces[i] == NULL)
+            continue;
+
+        if (profiles[i] == NULL)
+            profiles[i] = lib_calloc(1, sizeof(profile_t));
+        else
+            profile_clear(profiles[i]);
+
+        monitor_mask[i] |= MI_PROFILE;
+        interrupt_monitor_trap_on(mon_interfaces[i]->int_status);
+    }
+}
+
+static void profile_stop(void)
+{
+    int i;
+
+    for (i = FIRST_SPACE; i <= LAST_SPACE; i++) {
+        if (mon_interfaces[i] == NULL || !(monitor_mask[i] & MI_PROFILE))
+            continue;
+
+        monitor_mask[i] &= ~MI_PROFILE;
+        if (!monitor_mask[i])
+            interrupt_monitor_trap_off(mon_interfaces[i]->int_status);
+    }
+}
+
+static int set_profile_enabled(int val, void *param)
+{
+    val = val ? 1 : 0;
+
+    if (monitor_ready && val != profile_enabled) {
+        if (val)
+            profile_start();
+        else
+            profile_stop();
+    }
+
+    profile_enabled = val;
+    return 0;
+}
+
+static int set_profile_file(const char *name, void *param)
+{
+    char **file = (char **)param;
+
+    util_string_set(file, name);
+
+    if (*file != NULL && **file != '\0' && profile_have_data()) {
+        if (profile_write(*file, file == &profile_callgrind_file) < 0)
+            mon_out("Writing profile to `%s' failed.\n", *file);
+    }
+
+    return 0;
+}
+
+static const resource_string_t resources_string[] = {
+    { "MonitorProfileFlatFile", "", RES_EVENT_NO, NULL,
+      &profile_flat_file, set_profile_file, (void *)&profile_flat_file },
+    { "MonitorProfileCallgrindFile", "", RES_EVENT_NO, NULL,
+      &profile_callgrind_file, set_profile_file,
+      (void *)&profile_callgrind_file },
+    { NULL }
+};
+
+static const resource_int_t resources_int[] = {
+    { "MonitorProfile", 0, RES_EVENT_NO, NULL,
+      &profile_enabled, set_profile_enabled, NULL },
+    { NULL }
+};
+
+int monitor_profile_resources_init(void)
+{
+    if (resources_register_string(resources_string) < 0)
+        return -1;
+
+    return resources_register_int(resources_int);
+}
+
+void monitor_profile_resources_shutdown(void)
+{
+    lib_free(profile_flat_file);
+    lib_free(profile_callgrind_file);
+    profile_flat_file = NULL;
+    profile_callgrind_file = NULL;
+}
+
+static const cmdline_option_t cmdline_options[] = {
+    { "-monprofile", SET_RESOURCE, 0,
+      NULL, NULL, "MonitorProfile", (resource_value_t)1,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      NULL, T_("Profile the cycles spent by the emulated CPUs") },
+    { "+monprofile", SET_RESOURCE, 0,
+      NULL, NULL, "MonitorProfile", (resource_value_t)0,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      NULL, T_("Do not profile the emulated CPUs") },
+    { "-monprofileflat", SET_RESOURCE, 1,
+      NULL, NULL, "MonitorProfileFlatFile", NULL,
+      USE_PARAM_ID, USE_DESCRIPTION_STRING,
+      IDCLS_P_NAME, IDCLS_UNUSED,
+      NULL, T_("Write the flat profile to this file on exit") },
+    { "-monprofilecallgrind", SET_RESOURCE, 1,
+      NULL, NULL, "MonitorProfileCallgrindFile", NULL,
+      USE_PARAM_ID, USE_DESCRIPTION_STRING,
+      IDCLS_P_NAME, IDCLS_UNUSED,
+      NULL, T_("Write the profile in callgrind format to this file on exit") },
+    { NULL }
+};
+
+int monitor_profile_cmdline_options_init(void)
+{
+    return cmdline_register_options(cmdline_options);
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* Called by monitor_init() once the CPU interfaces are known.  */
+void mon_profile_init(void)
+{
+    monitor_ready = 1;
+
+    if (profile_enabled)
+        profile_start();
+}
+
+void mon_profile_shutdown(void)
+{
+    int i;
+
+    if (profile_have_data()) {
+        if (profile_flat_file != NULL && *profile_flat_file != '\0')
+            profile_write(profile_flat_file, 0);
+        if (profile_callgrind_file != NULL && *profile_callgrind_file != '\0')
+            profile_write(profile_callgrind_file, 1);
+    }
+
+    for (i = 0; i < NUM_MEMSPACES; i++) {
+        if (profiles[i] != NULL) {
+            profile_clear(profiles[i]);
+            lib_free(profiles[i]);
+            profiles[i] = NULL;
+        }
+    }
+
+    monitor_ready = 0;
+}
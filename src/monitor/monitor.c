@@ -65,6 +65,7 @@
 #include "mon_disassemble.h"
 #include "mon_memory.h"
 #include "mon_parse.h"
+#include "mon_profile.h"
 #include "mon_register.h"
 #include "mon_ui.h"
 #include "mon_util.h"
@@ -1219,6 +1220,8 @@ void monitor_init(monitor_interface_t *maincpu_interface_init,
     if (mon_init_break != -1)
         mon_breakpoint_add_checkpoint((WORD)mon_init_break, BAD_ADDR, FALSE, FALSE,FALSE, FALSE);
 
+    mon_profile_init();
+
     if (playback > 0) {
         playback_commands(playback);
     }
@@ -1230,6 +1233,8 @@ void monitor_shutdown(void)
     supported_cpu_type_list_t *slist, *slist_next;
     int i;
 
+    mon_profile_shutdown();
+
     list = monitor_cpu_type_list;
 
     while (list != NULL) {
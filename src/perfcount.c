@@ -0,0 +1,355 @@
+/*
+ * perfcount.c - Host time spent per frame in the emulated subsystems.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* The subsystems bracket their work with PERFCOUNT_ENTER/PERFCOUNT_LEAVE.
+   The brackets nest (the drives run from inside a CPU memory access, the
+   renderer from inside the raster line), so the counters are kept on a
+   small stack and every tick is charged to the innermost open counter
+   only; whatever is left over is main CPU time.  Only the emulation
+   thread is measured, time spent on the sound and drive worker threads
+   shows up as the time the emulation thread waits for them.
+   `vsync_do_vsync()' closes a frame: every `PerfCountInterval' frames a
+   summary is logged and with `PerfCountFile' set every frame is written
+   to that file as CSV.  Switching `PerfCount' off, e.g. with `resset' in
+   the monitor, prints the totals of the whole measurement.  */
+
+#include "vice.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "archdep.h"
+#include "cmdline.h"
+#include "lib.h"
+#include "monitor.h"
+#include "perfcount.h"
+#include "resources.h"
+#include "translate.h"
+#include "types.h"
+#include "util.h"
+#include "vsyncapi.h"
+
+
+#define PERFCOUNT_STACK_MAX 16
+
+int perfcount_enabled = 0;
+
+static int perfcount_interval;
+static char *perfcount_file_name = NULL;
+static FILE *perfcount_file = NULL;
+
+static const char *const perfcount_names[PERFCOUNT_NUM] = {
+    "cpu", "raster", "render", "sid", "drive", "sound", "vsync"
+};
+
+/* The thread that enabled the counters; the others are ignored.  */
+static pthread_t perfcount_thread;
+
+static int stack[PERFCOUNT_STACK_MAX];
+static int stack_depth = 0;
+
+/* Number of brackets opened while the stack was full.  */
+static int stack_lost = 0;
+
+/* Flag: Has the first frame been started?  */
+static int started = 0;
+static unsigned long last_ticks;
+
+static unsigned long frame_ticks[PERFCOUNT_NUM];
+static double interval_ticks[PERFCOUNT_NUM];
+static double total_ticks[PERFCOUNT_NUM];
+
+static unsigned long frame_number;
+static unsigned int interval_frames;
+static unsigned long total_frames;
+
+/* ------------------------------------------------------------------------- */
+
+static void perfcount_charge(unsigned long now)
+{
+    int id;
+
+    id = stack_depth ? stack[stack_depth - 1] : PERFCOUNT_CPU;
+    frame_ticks[id] += now - last_ticks;
+    last_ticks = now;
+}
+
+void perfcount_enter(int id)
+{
+    if (!pthread_equal(pthread_self(), perfcount_thread) || !started)
+        return;
+
+    if (stack_depth == PERFCOUNT_STACK_MAX) {
+        stack_lost++;
+        return;
+    }
+
+    perfcount_charge(vsyncarch_perf_ticks());
+    stack[stack_depth++] = id;
+}
+
+void perfcount_leave(int id)
+{
+    if (!pthread_equal(pthread_self(), perfcount_thread) || !started)
+        return;
+
+    if (stack_lost > 0) {
+        stack_lost--;
+        return;
+    }
+
+    /* A bracket opened before the counters were enabled.  */
+    if (stack_depth == 0 || stack[stack_depth - 1] != id)
+        return;
+
+    perfcount_charge(vsyncarch_perf_ticks());
+    stack_depth--;
+}
+
+/* Print the share of every counter over `frames' frames.  */
+static void perfcount_print(const char *what, const double *ticks,
+                            unsigned long frames, int to_monitor)
+{
+    char line[256];
+    double sum, freq;
+    size_t len;
+    int i;
+
+    if (frames == 0)
+        return;
+
+    sum = 0.0;
+    for (i = 0; i < PERFCOUNT_NUM; i++)
+        sum += ticks[i];
+
+    if (sum <= 0.0)
+        return;
+
+    freq = (double)vsyncarch_perf_frequency();
+
+    sprintf(line, "%s %lu frames, %.3f ms/frame:", what, frames,
+            sum * 1000.0 / freq / (double)frames);
+    for (i = 0; i < PERFCOUNT_NUM; i++) {
+        len = strlen(line);
+        sprintf(line + len, " %s %.1f%%", perfcount_names[i],
+                ticks[i] * 100.0 / sum);
+    }
+
+    printf("INFO: %s\n", line);
+    if (to_monitor)
+        mon_out("%s\n", line);
+}
+
+static void perfcount_write_row(void)
+{
+    double freq, sum;
+    int i;
+
+    freq = (double)vsyncarch_perf_frequency() / 1000000.0;
+    sum = 0.0;
+
+    fprintf(perfcount_file, "%lu", frame_number);
+    for (i = 0; i < PERFCOUNT_NUM; i++) {
+        fprintf(perfcount_file, ",%.1f", (double)frame_ticks[i] / freq);
+        sum += (double)frame_ticks[i];
+    }
+    fprintf(perfcount_file, ",%.1f\n", sum / freq);
+}
+
+void perfcount_frame(void)
+{
+    int i;
+
+    if (!pthread_equal(pthread_self(), perfcount_thread))
+        return;
+
+    if (!started) {
+        last_ticks = vsyncarch_perf_ticks();
+        started = 1;
+        return;
+    }
+
+    perfcount_charge(vsyncarch_perf_ticks());
+
+    if (perfcount_file != NULL)
+        perfcount_write_row();
+
+    for (i = 0; i < PERFCOUNT_NUM; i++) {
+        interval_ticks[i] += (double)frame_ticks[i];
+        total_ticks[i] += (double)frame_ticks[i];
+        frame_ticks[i] = 0;
+    }
+
+    frame_number++;
+    total_frames++;
+
+    if (perfcount_interval > 0
+        && ++interval_frames >= (unsigned int)perfcount_interval) {
+        perfcount_print("perf", interval_ticks, interval_frames, 0);
+        memset(interval_ticks, 0, sizeof(interval_ticks));
+        interval_frames = 0;
+    }
+}
+
+static void perfcount_reset(void)
+{
+    perfcount_thread = pthread_self();
+    stack_depth = 0;
+    stack_lost = 0;
+    started = 0;
+
+    memset(frame_ticks, 0, sizeof(frame_ticks));
+    memset(interval_ticks, 0, sizeof(interval_ticks));
+    memset(total_ticks, 0, sizeof(total_ticks));
+    interval_frames = 0;
+    total_frames = 0;
+}
+
+static void perfcount_close_file(void)
+{
+    if (perfcount_file != NULL) {
+        fclose(perfcount_file);
+        perfcount_file = NULL;
+    }
+}
+
+static int perfcount_open_file(void)
+{
+    int i;
+
+    perfcount_close_file();
+
+    if (perfcount_file_name == NULL || *perfcount_file_name == '\0')
+        return 0;
+
+    perfcount_file = fopen(perfcount_file_name, MODE_WRITE_TEXT);
+    if (perfcount_file == NULL) {
+        printf("WARNING: Cannot open `%s' for the performance counters.\n",
+               perfcount_file_name);
+        return -1;
+    }
+
+    fprintf(perfcount_file, "frame");
+    for (i = 0; i < PERFCOUNT_NUM; i++)
+        fprintf(perfcount_file, ",%s_us", perfcount_names[i]);
+    fprintf(perfcount_file, ",total_us\n");
+
+    frame_number = 0;
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static int set_perfcount_enabled(int val, void *param)
+{
+    val = val ? 1 : 0;
+
+    if (val && !perfcount_enabled)
+        perfcount_reset();
+
+    if (!val && perfcount_enabled)
+        perfcount_print("perf total", total_ticks, total_frames, 1);
+
+    perfcount_enabled = val;
+    return 0;
+}
+
+static int set_perfcount_interval(int val, void *param)
+{
+    if (val < 0)
+        return -1;
+
+    perfcount_interval = val;
+    interval_frames = 0;
+    memset(interval_ticks, 0, sizeof(interval_ticks));
+
+    return 0;
+}
+
+static int set_perfcount_file(const char *val, void *param)
+{
+    util_string_set(&perfcount_file_name, val);
+
+    return perfcount_open_file();
+}
+
+static const resource_string_t resources_string[] = {
+    { "PerfCountFile", "", RES_EVENT_NO, NULL,
+      &perfcount_file_name, set_perfcount_file, NULL },
+    { NULL }
+};
+
+static const resource_int_t resources_int[] = {
+    { "PerfCount", 0, RES_EVENT_NO, NULL,
+      &perfcount_enabled, set_perfcount_enabled, NULL },
+    { "PerfCountInterval", 50, RES_EVENT_NO, NULL,
+      &perfcount_interval, set_perfcount_interval, NULL },
+    { NULL }
+};
+
+int perfcount_resources_init(void)
+{
+    if (resources_register_string(resources_string) < 0)
+        return -1;
+
+    return resources_register_int(resources_int);
+}
+
+void perfcount_shutdown(void)
+{
+    perfcount_close_file();
+    lib_free(perfcount_file_name);
+    perfcount_file_name = NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static const cmdline_option_t cmdline_options[] = {
+    { "-perfcount", SET_RESOURCE, 0,
+      NULL, NULL, "PerfCount", (resource_value_t)1,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      NULL, T_("Measure the host time spent per frame in each subsystem") },
+    { "+perfcount", SET_RESOURCE, 0,
+      NULL, NULL, "PerfCount", (resource_value_t)0,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      NULL, T_("Do not measure the host time spent per frame") },
+    { "-perfcountinterval", SET_RESOURCE, 1,
+      NULL, NULL, "PerfCountInterval", NULL,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      T_("<frames>"), T_("Log the performance counters every this many frames (0: never)") },
+    { "-perfcountfile", SET_RESOURCE, 1,
+      NULL, NULL, "PerfCountFile", NULL,
+      USE_PARAM_ID, USE_DESCRIPTION_STRING,
+      IDCLS_P_NAME, IDCLS_UNUSED,
+      NULL, T_("Write the performance counters of every frame to this CSV file") },
+    { NULL }
+};
+
+int perfcount_cmdline_options_init(void)
+{
+    return cmdline_register_options(cmdline_options);
+}
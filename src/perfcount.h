@@ -0,0 +1,58 @@
+/*
+ * perfcount.h - Host time spent per frame in the emulated subsystems.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef VICE_PERFCOUNT_H
+#define VICE_PERFCOUNT_H
+
+/* Time not claimed by any other counter is charged to PERFCOUNT_CPU.  */
+#define PERFCOUNT_CPU    0
+#define PERFCOUNT_RASTER 1
+#define PERFCOUNT_RENDER 2
+#define PERFCOUNT_SID    3
+#define PERFCOUNT_DRIVE  4
+#define PERFCOUNT_SOUND  5
+#define PERFCOUNT_VSYNC  6
+#define PERFCOUNT_NUM    7
+
+extern int perfcount_enabled;
+
+extern int perfcount_resources_init(void);
+extern int perfcount_cmdline_options_init(void);
+extern void perfcount_shutdown(void);
+extern void perfcount_enter(int id);
+extern void perfcount_leave(int id);
+extern void perfcount_frame(void);
+
+#define PERFCOUNT_ENTER(id)       \
+    do {                          \
+        if (perfcount_enabled)    \
+            perfcount_enter(id);  \
+    } while (0)
+
+#define PERFCOUNT_LEAVE(id)       \
+    do {                          \
+        if (perfcount_enabled)    \
+            perfcount_leave(id);  \
+    } while (0)
+
+#endif
@@ -56,17 +56,11 @@
 #define SNAP_MINOR 0
 
 
-int pet_snapshot_write(const char *name, int save_roms, int save_disks,
-                       int event_mode)
+static int pet_snapshot_write_snapshot(snapshot_t *s, int save_roms,
+                                       int save_disks, int event_mode)
 {
-    snapshot_t *s;
     int ef = 0;
 
-    s = snapshot_create(name, SNAP_MAJOR, SNAP_MINOR, machine_name);
-
-    if (s == NULL)
-        return -1;
-
     sound_snapshot_prepare();
 
     if (maincpu_snapshot_write_module(s) < 0
@@ -86,25 +80,52 @@ int pet_snapshot_write(const char *name, int save_roms, int save_disks,
     if ((!ef) && petres.superpet)
         ef = acia1_snapshot_write_module(s);
 
+    return ef;
+}
+
+int pet_snapshot_write(const char *name, int save_roms, int save_disks,
+                       int event_mode)
+{
+    snapshot_t *s;
+    int retval;
+
+    s = snapshot_create(name, SNAP_MAJOR, SNAP_MINOR, machine_name);
+    if (s == NULL)
+        return -1;
+
+    retval = pet_snapshot_write_snapshot(s, save_roms, save_disks, event_mode);
     snapshot_close(s);
 
-    if (ef)
+    if (retval != 0)
         ioutil_remove(name);
 
-    return ef;
+    return retval;
 }
 
-int pet_snapshot_read(const char *name, int event_mode)
+int pet_snapshot_write_memory(BYTE **data, size_t *size, int save_roms,
+                              int save_disks, int event_mode)
 {
     snapshot_t *s;
-    BYTE minor, major;
-    int ef = 0;
-
-    s = snapshot_open(name, &major, &minor, machine_name);
 
+    s = snapshot_memory_create(SNAP_MAJOR, SNAP_MINOR, machine_name);
     if (s == NULL)
         return -1;
 
+    if (pet_snapshot_write_snapshot(s, save_roms, save_disks, event_mode) != 0) {
+        snapshot_close(s);
+        return -1;
+    }
+
+    *data = snapshot_memory_release(s, size);
+    snapshot_close(s);
+    return 0;
+}
+
+static int pet_snapshot_read_snapshot(snapshot_t *s, BYTE major, BYTE minor,
+                                      int event_mode)
+{
+    int ef = 0;
+
     if (major != SNAP_MAJOR || minor != SNAP_MINOR) {
         log_error(LOG_DEFAULT,
                   "Snapshot version (%d.%d) not valid: expecting %d.%d.",
@@ -142,3 +163,27 @@ int pet_snapshot_read(const char *name, int event_mode)
     return ef;
 }
 
+int pet_snapshot_read(const char *name, int event_mode)
+{
+    snapshot_t *s;
+    BYTE minor, major;
+
+    s = snapshot_open(name, &major, &minor, machine_name);
+    if (s == NULL)
+        return -1;
+
+    return pet_snapshot_read_snapshot(s, major, minor, event_mode);
+}
+
+int pet_snapshot_read_memory(const BYTE *data, size_t size, int event_mode)
+{
+    snapshot_t *s;
+    BYTE minor, major;
+
+    s = snapshot_memory_open(data, size, &major, &minor, machine_name);
+    if (s == NULL)
+        return -1;
+
+    return pet_snapshot_read_snapshot(s, major, minor, event_mode);
+}
+
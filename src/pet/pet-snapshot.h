@@ -27,9 +27,18 @@
 #ifndef VICE_PET_SNAPSHOT_H
 #define VICE_PET_SNAPSHOT_H
 
+#include <stddef.h>
+
+#include "types.h"
+
 extern int pet_snapshot_write(const char *name, int save_roms, int save_disks,
                               int event_mode);
 extern int pet_snapshot_read(const char *name, int event_mode);
+extern int pet_snapshot_write_memory(BYTE **data, size_t *size,
+                                     int save_roms, int save_disks,
+                                     int event_mode);
+extern int pet_snapshot_read_memory(const BYTE *data, size_t size,
+                                    int event_mode);
 
 #endif
 
@@ -31,6 +31,7 @@
 
 #include "lib.h"
 #include "machine.h"
+#include "perfcount.h"
 #include "raster-canvas.h"
 #include "raster.h"
 #include "video.h"
@@ -38,27 +39,27 @@
 #include "viewport.h"
 
 
-inline static void refresh_canvas(raster_t *raster)
+/* Number of lines converted and skipped by the renderer so far.  */
+static unsigned long converted_lines = 0;
+static unsigned long skipped_lines = 0;
+
+/* Render the area from (xs, ys) to (xe, ye) and return the number of lines
+   that were converted.  */
+static int refresh_area(raster_t *raster, unsigned int xs, unsigned int ys,
+                        unsigned int xe, unsigned int ye)
 {
-    raster_canvas_area_t *update_area;
     viewport_t *viewport;
     int x, y, xx, yy;
     int w, h;
 
-    update_area = raster->update_area;
     viewport = raster->canvas->viewport;
 
-#if (!defined(GP2X) || defined(GP2X_SDL)) && (!defined(WIZ) || defined(WIZ_SDL))
-    if (update_area->is_null)
-        return;
-#endif
-
-    x = update_area->xs;
-    y = update_area->ys;
-    xx = update_area->xs - viewport->first_x;
-    yy = update_area->ys - viewport->first_line;
-    w = update_area->xe - update_area->xs + 1;
-    h = update_area->ye - update_area->ys + 1;
+    x = xs;
+    y = ys;
+    xx = xs - viewport->first_x;
+    yy = ys - viewport->first_line;
+    w = xe - xs + 1;
+    h = ye - ys + 1;
 
     if (video_render_get_fake_pal_state()) {
         /* if pal emu is activated, more pixels have to be updated: around,
@@ -96,17 +97,63 @@ inline static void refresh_canvas(raster_t *raster)
     yy += viewport->y_offset;
 
     if ((int)(raster->canvas->draw_buffer->canvas_height) >= yy
-        && (int)(raster->canvas->draw_buffer->canvas_width) >= xx)
+        && (int)(raster->canvas->draw_buffer->canvas_width) >= xx) {
+        h = MIN(h, (int)(raster->canvas->draw_buffer->canvas_height - yy));
         video_canvas_refresh(raster->canvas, x, y, xx, yy,
-            MIN(w, (int)(raster->canvas->draw_buffer->canvas_width - xx)),
-            MIN(h, (int)(raster->canvas->draw_buffer->canvas_height - yy)));
+            MIN(w, (int)(raster->canvas->draw_buffer->canvas_width - xx)), h);
+        return h > 0 ? h : 0;
+    }
+
+    return 0;
+}
+
+inline static void refresh_canvas(raster_t *raster)
+{
+    raster_canvas_area_t *update_area;
+    viewport_t *viewport;
+    unsigned int i;
+    int lines, converted;
+
+    update_area = raster->update_area;
+    viewport = raster->canvas->viewport;
+
+    lines = viewport->last_line - viewport->first_line + 1;
+    converted = 0;
+
+#if (!defined(GP2X) || defined(GP2X_SDL)) && (!defined(WIZ) || defined(WIZ_SDL))
+    if (update_area->is_null) {
+        skipped_lines += lines;
+        return;
+    }
+#endif
+
+    /* Only convert the lines that have actually changed.  */
+    for (i = 0; i < update_area->num_spans; i++)
+        converted += refresh_area(raster, update_area->spans[i].xs,
+                                  update_area->spans[i].ys,
+                                  update_area->spans[i].xe,
+                                  update_area->spans[i].ye);
+
+    video_canvas_refresh_done(raster->canvas);
+
+    converted_lines += converted;
+    if (converted < lines)
+        skipped_lines += lines - converted;
 
     update_area->is_null = 1;
+    update_area->num_spans = 0;
+}
+
+void raster_canvas_get_line_stats(unsigned long *converted,
+                                  unsigned long *skipped)
+{
+    *converted = converted_lines;
+    *skipped = skipped_lines;
 }
 
 void raster_canvas_handle_end_of_frame(raster_t *raster)
 {
-    if (video_disabled_mode)
+    if (video_disabled_mode || raster_drawing_disabled)
         return;
 
     if (raster->skip_frame)
@@ -115,10 +162,14 @@ void raster_canvas_handle_end_of_frame(raster_t *raster)
     if (!raster->canvas->viewport->update_canvas)
         return;
 
+    PERFCOUNT_ENTER(PERFCOUNT_RENDER);
+
     if (raster->dont_cache)
         video_canvas_refresh_all(raster->canvas);
     else
         refresh_canvas(raster);
+
+    PERFCOUNT_LEAVE(PERFCOUNT_RENDER);
 }
 
 void raster_canvas_init(raster_t *raster)
@@ -126,6 +177,7 @@ void raster_canvas_init(raster_t *raster)
     raster->update_area = lib_malloc(sizeof(raster_canvas_area_t));
 
     raster->update_area->is_null = 1;
+    raster->update_area->num_spans = 0;
 }
 
 void raster_canvas_shutdown(raster_t *raster)
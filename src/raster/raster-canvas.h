@@ -29,13 +29,32 @@
 
 struct raster_s;
 
-/* A simple convenience type for defining a rectangular area on the screen.  */
+/* Maximum number of separate runs of changed lines tracked per frame.  */
+#define RASTER_CANVAS_MAX_SPANS 8
+
+/* Changed lines closer than this are merged into one span, so that the
+   extra lines updated around each span for PAL emulation never overlap.  */
+#define RASTER_CANVAS_SPAN_GAP  3
+
+/* A run of changed lines.  */
+struct raster_canvas_span_s {
+    unsigned int xs;
+    unsigned int ys;
+    unsigned int xe;
+    unsigned int ye;
+};
+typedef struct raster_canvas_span_s raster_canvas_span_t;
+
+/* A simple convenience type for defining a rectangular area on the screen,
+   together with the runs of lines that have actually changed in it.  */
 struct raster_canvas_area_s {
     unsigned int xs;
     unsigned int ys;
     unsigned int xe;
     unsigned int ye;
     int is_null;
+    unsigned int num_spans;
+    raster_canvas_span_t spans[RASTER_CANVAS_MAX_SPANS];
 };
 typedef struct raster_canvas_area_s raster_canvas_area_t;
 
@@ -44,6 +63,8 @@ extern void raster_canvas_shutdown(struct raster_s *raster);
 
 extern void raster_canvas_handle_end_of_frame(struct raster_s *raster);
 extern void raster_canvas_update_all(struct raster_s *raster);
+extern void raster_canvas_get_line_stats(unsigned long *converted,
+                                         unsigned long *skipped);
 
 #endif
 
@@ -33,6 +33,7 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "perfcount.h"
 #include "raster-cache.h"
 #include "raster-canvas.h"
 #include "raster-line.h"
@@ -55,17 +56,38 @@ unsigned int raster_line_get_real_mode(raster_t *raster)
 inline static void add_line_to_area(raster_canvas_area_t *area, unsigned int y,
                                     unsigned int xs, unsigned int xe)
 {
+    raster_canvas_span_t *span;
+
     if (area->is_null) {
         area->ys = area->ye = y;
         area->xs = xs;
         area->xe = xe;
         area->is_null = 0;
+        area->num_spans = 0;
     } else {
         area->xs = MIN(xs, area->xs);
         area->xe = MAX(xe, area->xe);
         area->ys = MIN(y, area->ys);
         area->ye = MAX(y, area->ye);
     }
+
+    span = area->num_spans > 0 ? &area->spans[area->num_spans - 1] : NULL;
+
+    /* Start a new span unless the line is next to the last one or we have
+       run out of spans.  */
+    if (span == NULL
+        || (area->num_spans < RASTER_CANVAS_MAX_SPANS
+        && (y < span->ys || y > span->ye + RASTER_CANVAS_SPAN_GAP))) {
+        span = &area->spans[area->num_spans++];
+        span->ys = span->ye = y;
+        span->xs = xs;
+        span->xe = xe;
+    } else {
+        span->xs = MIN(xs, span->xs);
+        span->xe = MAX(xe, span->xe);
+        span->ys = MIN(y, span->ys);
+        span->ye = MAX(y, span->ye);
+    }
 }
 
 inline void raster_line_draw_blank(raster_t *raster, unsigned int start,
@@ -622,8 +644,20 @@ inline static void handle_visible_line(raster_t *raster)
         raster->xsmooth_color = raster->idle_background_color;
 }
 
+/* When drawing is disabled, a line only has to be drawn if sprites are
+   displayed on it, as only they can cause collisions.  */
+inline static int can_skip_line(raster_t *raster)
+{
+    return raster_drawing_disabled
+        && (raster->sprite_status == NULL
+        || (raster->sprite_status->visible_msk == 0
+        && raster->sprite_status->dma_msk == 0));
+}
+
 void raster_line_emulate(raster_t *raster)
 {
+    PERFCOUNT_ENTER(PERFCOUNT_RASTER);
+
     raster_draw_buffer_ptr_update(raster);
 
     /* Emulate the vertical blank flip-flops.  (Well, sort of.)  */
@@ -633,12 +667,12 @@ void raster_line_emulate(raster_t *raster)
     if (raster->current_line == raster->display_ystop)
         raster->blank_enabled = 1;
 
-    if ((raster->current_line >= raster->geometry->first_displayed_line
+    if (((raster->current_line >= raster->geometry->first_displayed_line
         && raster->current_line <= raster->geometry->last_displayed_line)
         /* handle the case when lines 0+ are displayed in the lower border */
        || (raster->current_line <= raster->geometry->last_displayed_line - raster->geometry->screen_size.height
         && raster->geometry->screen_size.height <= raster->geometry->last_displayed_line)
-       )
+       ) && !can_skip_line(raster))
    {
         /* handle lines with no border or with changes that may affect
            the border as visible lines */
@@ -669,6 +703,12 @@ void raster_line_emulate(raster_t *raster)
                *raster->draw_buffer_ptr, 4);
 #endif
     } else {
+        if (raster_drawing_disabled) {
+            /* Redraw everything once drawing is enabled again.  */
+            raster->dont_cache = 1;
+            raster->num_cached_lines = 0;
+        }
+
         update_sprite_collisions(raster);
 
         if (raster->changes->have_on_this_line) {
@@ -707,5 +747,7 @@ void raster_line_emulate(raster_t *raster)
         raster->sprite_status->dma_msk = raster->sprite_status->new_dma_msk;
 
     raster->blank_this_line = 0;
+
+    PERFCOUNT_LEAVE(PERFCOUNT_RASTER);
 }
 
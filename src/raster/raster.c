@@ -51,6 +51,8 @@
 #include "viewport.h"
 
 
+int raster_drawing_disabled = 0;
+
 int raster_calc_frame_buffer_width(raster_t *raster)
 {
     return raster->geometry->screen_size.width
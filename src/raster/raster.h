@@ -226,6 +226,10 @@ extern int raster_calc_frame_buffer_width(raster_t *raster);
 extern void raster_line_changes_init(raster_t *raster);
 extern void raster_line_changes_sprite_init(raster_t *raster);
 
+/* If nonzero, lines are only drawn when needed for sprite collisions and
+   frames are never refreshed.  */
+extern int raster_drawing_disabled;
+
 /* Inlined functions.  These need to be *fast*.  */
 
 inline static void raster_changes_next_line_add_int(raster_t *raster,
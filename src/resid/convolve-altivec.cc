@@ -0,0 +1,71 @@
+//  ---------------------------------------------------------------------------
+//  This file is part of reSID, a MOS6581 SID emulator engine.
+//  Copyright (C) 2004  Dag Lem <resid@nimrod.no>
+//
+//  Updated by TimRex for Altivec routines (December 2010)
+// 
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//  ---------------------------------------------------------------------------
+
+#include "sid.h"
+
+#if (RESID_USE_ALTIVEC==1)
+
+#include <altivec.h>
+
+// ----------------------------------------------------------------------------
+// Convolution of the sample ring buffer with a FIR table, AltiVec version.
+// Neither the ring buffer position nor the FIR table is 16 byte aligned,
+// so aligned vectors are loaded and shifted into place with vec_perm.
+// This reads up to 16 bytes beyond the end of both arrays, which are
+// padded for it. The products are summed with wraparound like the C
+// version, so the result is bit identical.
+// ----------------------------------------------------------------------------
+int convolve_altivec(const short *a, const short *b, int n)
+{
+  vector signed int vsum = vec_splat_s32(0);
+  vector unsigned char perm_a = vec_lvsl(0, a);
+  vector unsigned char perm_b = vec_lvsl(0, b);
+  vector signed short a_lo = vec_ld(0, a);
+  vector signed short b_lo = vec_ld(0, b);
+  vector signed short a_hi, b_hi;
+  union {
+    vector signed int v;
+    int i32[4];
+  } usum;
+  int out;
+
+  while (n >= 8) {
+    a_hi = vec_ld(16, a);
+    b_hi = vec_ld(16, b);
+    vsum = vec_msum(vec_perm(a_lo, a_hi, perm_a),
+                    vec_perm(b_lo, b_hi, perm_b), vsum);
+    a_lo = a_hi;
+    b_lo = b_hi;
+    a += 8;
+    b += 8;
+    n -= 8;
+  }
+
+  usum.v = vsum;
+  out = usum.i32[0] + usum.i32[1] + usum.i32[2] + usum.i32[3];
+
+  while (n--)
+    out += (*(a++)) * (*(b++));
+
+  return out;
+}
+
+#endif
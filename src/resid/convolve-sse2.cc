@@ -0,0 +1,60 @@
+//  ---------------------------------------------------------------------------
+//  This file is part of reSID, a MOS6581 SID emulator engine.
+//  Copyright (C) 2004  Dag Lem <resid@nimrod.no>
+//
+//  Updated by TimRex for Altivec routines (December 2010)
+// 
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//  ---------------------------------------------------------------------------
+
+#include "sid.h"
+
+#if (RESID_USE_SSE2==1)
+
+#include <emmintrin.h>
+
+// ----------------------------------------------------------------------------
+// Convolution of the sample ring buffer with a FIR table, SSE2 version.
+// The products are summed with wraparound like the C version, so the
+// result is bit identical.
+// ----------------------------------------------------------------------------
+int convolve_sse2(const short *a, const short *b, int n)
+{
+  __m128i vsum = _mm_setzero_si128();
+  union {
+    __m128i v;
+    int i32[4];
+  } usum;
+  int out;
+
+  while (n >= 8) {
+    vsum = _mm_add_epi32(vsum,
+                         _mm_madd_epi16(_mm_loadu_si128((const __m128i *)a),
+                                        _mm_loadu_si128((const __m128i *)b)));
+    a += 8;
+    b += 8;
+    n -= 8;
+  }
+
+  usum.v = vsum;
+  out = usum.i32[0] + usum.i32[1] + usum.i32[2] + usum.i32[3];
+
+  while (n--)
+    out += (*(a++)) * (*(b++));
+
+  return out;
+}
+
+#endif
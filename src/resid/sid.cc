@@ -22,10 +22,32 @@
 #include "sid.h"
 #include <math.h>
 
-#if defined(__MMX__) && (HAVE_MMINTRIN_H==1)
-#include <mmintrin.h>
-#elif defined (__ALTIVEC__)
-#include <altivec.h>
+extern int convolve(const short *a, const short *b, int n);
+extern int convolve_sse2(const short *a, const short *b, int n);
+extern int convolve_altivec(const short *a, const short *b, int n);
+
+// The SIMD kernels read up to 16 bytes beyond the sample ring buffer and
+// the FIR tables.
+enum { SIMD_PADDING = 8 };
+
+#if (RESID_USE_SSE2==1)
+// SSE2 is part of x86-64; on 32 bit x86 ask CPUID.
+static bool host_cpu_has_sse2()
+{
+#if defined(__x86_64__) || defined(_M_X64)
+  return true;
+#elif defined(__GNUC__) && defined(__i386__)
+  unsigned int eax, ebx, ecx, edx;
+
+  asm("pushl %%ebx; cpuid; movl %%ebx, %1; popl %%ebx"
+      : "=a" (eax), "=r" (ebx), "=c" (ecx), "=d" (edx)
+      : "a" (1));
+
+  return (edx & (1 << 26)) != 0;
+#else
+  return false;
+#endif
+}
 #endif
 
 // ----------------------------------------------------------------------------
@@ -36,6 +58,22 @@ RESID::RESID()
   // Initialize pointers.
   sample = 0;
   fir = 0;
+  decimated = 0;
+  fir_decim = 0;
+
+  two_stage = false;
+  two_stage_active = false;
+
+#if (RESID_USE_SSE2==1)
+  can_use_sse2 = host_cpu_has_sse2();
+#else
+  can_use_sse2 = false;
+#endif
+#if (RESID_USE_ALTIVEC==1)
+  can_use_altivec = true;
+#else
+  can_use_altivec = false;
+#endif
 
   voice[0].set_sync_source(&voice[2]);
   voice[1].set_sync_source(&voice[0]);
@@ -57,6 +95,8 @@ RESID::~RESID()
 {
   delete[] sample;
   delete[] fir;
+  delete[] decimated;
+  delete[] fir_decim;
 }
 
 
@@ -394,6 +434,16 @@ void RESID::enable_external_filter(bool enable)
 }
 
 
+// ----------------------------------------------------------------------------
+// Resampling in two steps for SAMPLE_RESAMPLE_INTERPOLATE; this takes
+// effect with the next call of set_sampling_parameters().
+// ----------------------------------------------------------------------------
+void RESID::enable_two_stage_resampling(bool enable)
+{
+  two_stage = enable;
+}
+
+
 // ----------------------------------------------------------------------------
 // I0() computes the 0th order modified Bessel function of the first kind.
 // This function is originally from resample-1.5/filterkit.c by J. O. Smith.
@@ -487,11 +537,96 @@ bool RESID::set_sampling_parameters(double clock_freq, sampling_method method,
   {
     delete[] sample;
     delete[] fir;
+    delete[] decimated;
+    delete[] fir_decim;
     sample = 0;
     fir = 0;
+    decimated = 0;
+    fir_decim = 0;
+    two_stage_active = false;
     return true;
   }
 
+  // Resample in two steps if that cuts the work, see
+  // clock_resample_two_stage().
+  two_stage_active = false;
+  if (two_stage && method == SAMPLE_RESAMPLE_INTERPOLATE) {
+    double f = 2*pass_freq + sqrt(2*pass_freq*clock_freq
+				  *(sample_freq - 2*pass_freq)/sample_freq);
+
+    if (f > sample_freq && 4*f < clock_freq) {
+      // Pick the intermediate frequency near f such that the product of
+      // the two fixpoint ratios comes closest to the one step ratio.
+      double ratio = clock_freq/sample_freq*(1 << FIXP_SHIFT)
+	*(1 << FIXP_SHIFT);
+      cycle_count c = cycle_count(clock_freq/f*(1 << FIXP_SHIFT) + 0.5);
+      double error = -1;
+      for (cycle_count d = c - 1024; d <= c + 1024; d++) {
+	cycle_count q = cycle_count(ratio/d + 0.5);
+	double e = fabs(double(d)*q - ratio);
+	if (error < 0 || e < error) {
+	  error = e;
+	  cycles_per_decim = d;
+	  cycles_per_sample = q;
+	}
+      }
+      decim_frequency = clock_freq*(1 << FIXP_SHIFT)/cycles_per_decim;
+
+      // The filter scaling is applied once, in the first step.
+      build_fir(fir_decim, fir_decim_N, fir_decim_RES, method,
+		clock_freq, decim_frequency, pass_freq, filter_scale);
+      build_fir(fir, fir_N, fir_RES, method,
+		decim_frequency, sample_freq, pass_freq, 1.0);
+
+      decim_offset = 0;
+      decim_pending = cycles_per_sample >> FIXP_SHIFT;
+      sample_offset = cycles_per_sample & FIXP_MASK;
+
+      if (!decimated) {
+	decimated = new short[RINGSIZE*2 + SIMD_PADDING];
+      }
+      for (int j = 0; j < RINGSIZE*2 + SIMD_PADDING; j++) {
+	decimated[j] = 0;
+      }
+      decimated_index = 0;
+
+      two_stage_active = true;
+    }
+  }
+
+  if (!two_stage_active) {
+    delete[] decimated;
+    delete[] fir_decim;
+    decimated = 0;
+    fir_decim = 0;
+
+    build_fir(fir, fir_N, fir_RES, method,
+	      clock_freq, sample_freq, pass_freq, filter_scale);
+  }
+
+  // Allocate sample buffer.
+  if (!sample) {
+    sample = new short[RINGSIZE*2 + SIMD_PADDING];
+  }
+  // Clear sample buffer.
+  for (int j = 0; j < RINGSIZE*2 + SIMD_PADDING; j++) {
+    sample[j] = 0;
+  }
+  sample_index = 0;
+
+  return true;
+}
+
+
+// ----------------------------------------------------------------------------
+// Calculation of the FIR tables for resampling from clock_freq to
+// sample_freq.
+// ----------------------------------------------------------------------------
+void RESID::build_fir(short*& table, int& table_N, int& table_RES,
+		      sampling_method method, double clock_freq,
+		      double sample_freq, double pass_freq,
+		      double filter_scale)
+{
   const double pi = 3.1415926535897932385;
 
   // 16 bits -> -96dB stopband attenuation.
@@ -519,51 +654,43 @@ bool RESID::set_sampling_parameters(double clock_freq, sampling_method method,
 
   // The filter length is equal to the filter order + 1.
   // The filter length must be an odd number (sinc is symmetric about x = 0).
-  fir_N = int(N*f_cycles_per_sample) + 1;
-  fir_N |= 1;
+  table_N = int(N*f_cycles_per_sample) + 1;
+  table_N |= 1;
 
   // We clamp the filter table resolution to 2^n, making the fixpoint
   // sample_offset a whole multiple of the filter table resolution.
   int res = method == SAMPLE_RESAMPLE_INTERPOLATE ?
     (int)FIR_RES_INTERPOLATE : (int)FIR_RES_FAST;
   int n = (int)ceil(log(res/f_cycles_per_sample)/log(2.0));
-  fir_RES = 1 << n;
+  table_RES = 1 << n;
 
   // Allocate memory for FIR tables.
-  delete[] fir;
-  fir = new short[fir_N*fir_RES];
+  delete[] table;
+  table = new short[table_N*table_RES + SIMD_PADDING];
 
-  // Calculate fir_RES FIR tables for linear interpolation.
-  for (int i = 0; i < fir_RES; i++) {
-    int fir_offset = i*fir_N + fir_N/2;
-    double j_offset = double(i)/fir_RES;
+  // Calculate table_RES FIR tables for linear interpolation.
+  for (int i = 0; i < table_RES; i++) {
+    int fir_offset = i*table_N + table_N/2;
+    double j_offset = double(i)/table_RES;
     // Calculate FIR table. This is the sinc function, weighted by the
     // Kaiser window.
-    for (int j = -fir_N/2; j <= fir_N/2; j++) {
+    for (int j = -table_N/2; j <= table_N/2; j++) {
       double jx = j - j_offset;
       double wt = wc*jx/f_cycles_per_sample;
-      double temp = jx/(fir_N/2);
+      double temp = jx/(table_N/2);
       double Kaiser =
 	fabs(temp) <= 1 ? I0(beta*sqrt(1 - temp*temp))/I0beta : 0;
       double sincwt =
 	fabs(wt) >= 1e-6 ? sin(wt)/wt : 1;
       double val =
 	(1 << FIR_SHIFT)*filter_scale*f_samples_per_cycle*wc/pi*sincwt*Kaiser;
-      fir[fir_offset + j] = short(val + 0.5);
+      table[fir_offset + j] = short(val + 0.5);
     }
   }
 
-  // Allocate sample buffer.
-  if (!sample) {
-    sample = new short[RINGSIZE*2];
-  }
-  // Clear sample buffer.
-  for (int j = 0; j < RINGSIZE*2; j++) {
-    sample[j] = 0;
+  for (int j = table_N*table_RES; j < table_N*table_RES + SIMD_PADDING; j++) {
+    table[j] = 0;
   }
-  sample_index = 0;
-
-  return true;
 }
 
 
@@ -581,8 +708,12 @@ bool RESID::set_sampling_parameters(double clock_freq, sampling_method method,
 // ----------------------------------------------------------------------------
 void RESID::adjust_sampling_frequency(double sample_freq)
 {
+  // With two-stage resampling, the second step runs from the
+  // intermediate frequency.
+  double freq = two_stage_active ? decim_frequency : clock_frequency;
+
   cycles_per_sample =
-    cycle_count(clock_frequency/sample_freq*(1 << FIXP_SHIFT) + 0.5);
+    cycle_count(freq/sample_freq*(1 << FIXP_SHIFT) + 0.5);
 }
 
 
@@ -744,6 +875,9 @@ int RESID::clock(cycle_count& delta_t, short* buf, int n, int interleave)
   case SAMPLE_INTERPOLATE:
     return clock_interpolate(delta_t, buf, n, interleave);
   case SAMPLE_RESAMPLE_INTERPOLATE:
+    if (two_stage_active) {
+      return clock_resample_two_stage(delta_t, buf, n, interleave);
+    }
     return clock_resample_interpolate(delta_t, buf, n, interleave);
   case SAMPLE_RESAMPLE_FAST:
     return clock_resample_fast(delta_t, buf, n, interleave);
@@ -835,56 +969,74 @@ int RESID::clock_interpolate(cycle_count& delta_t, short* buf, int n,
   return s;
 }
 
-// Helper function to calculate convolution. When MMX is available, it is also
-// several times faster than the straightforward C loop.
-static inline int convolve(const short *a, const short *b, int n)
+// ----------------------------------------------------------------------------
+// Convolution with the fastest kernel the host has; all kernels give the
+// same result.
+// ----------------------------------------------------------------------------
+RESID_INLINE
+int RESID::convolve_fir(const short* a, const short* b, int n)
 {
-    int out = 0;
-#if defined(__MMX__) && (HAVE_MMINTRIN_H==1)
-    union {
-        __m64 m64;
-        int i32[2];
-    } tmp;
-    tmp.i32[0] = 0;
-    tmp.i32[1] = 0;    
-    while (n >= 4) {
-        tmp.m64 = _mm_add_pi32(tmp.m64,
-                               _mm_madd_pi16(*((__m64 *)a),
-                                             *((__m64 *)b)));
-        a += 4;
-        b += 4;
-        n -= 4;
-    }
-    out = tmp.i32[0] + tmp.i32[1];
-    _mm_empty();
-#elif defined (__ALTIVEC__)
-    union {
-        vector signed int m128;
-        int i32[4];
-    } tmp;
-
-    const vector int zero = {0, 0, 0, 0};
-
-    tmp.m128 = zero;
-
-    while (n >= 8)
-    {
-        tmp.m128 = vec_msum(*((vector signed short *)a),
-                            *((vector signed short *)b), tmp.m128);
-
-        a += 8;
-        b += 8;
-        n -= 8;
-    }
-
-    out = tmp.i32[0] + tmp.i32[1] + tmp.i32[2] + tmp.i32[3];
+#if (RESID_USE_SSE2==1)
+  if (can_use_sse2) {
+    return convolve_sse2(a, b, n);
+  }
+#endif
+#if (RESID_USE_ALTIVEC==1)
+  if (can_use_altivec) {
+    return convolve_altivec(a, b, n);
+  }
 #endif
+  return convolve(a, b, n);
+}
 
-    while (n --)
-        out += (*(a++)) * (*(b++));
-    return out;
+// ----------------------------------------------------------------------------
+// Convolution of the last samples in a ring buffer with two neighbouring
+// FIR tables, interpolated linearly.
+// ----------------------------------------------------------------------------
+RESID_INLINE
+int RESID::resample_fir(const short* ring, int index, const short* table,
+			int table_N, int table_RES, cycle_count offset)
+{
+  int fir_offset = offset*table_RES >> FIXP_SHIFT;
+  int fir_offset_rmd = offset*table_RES & FIXP_MASK;
+  const short* fir_start = table + fir_offset*table_N;
+  const short* sample_start = ring + index - table_N + RINGSIZE - 1;
+
+  // Convolution with filter impulse response.
+  int v1 = convolve_fir(sample_start, fir_start, table_N);
+
+  // Use next FIR table, wrap around to first FIR table using
+  // previous sample.
+  if (++fir_offset == table_RES) {
+    fir_offset = 0;
+    ++sample_start;
+  }
+  fir_start = table + fir_offset*table_N;
+
+  // Convolution with filter impulse response.
+  int v2 = convolve_fir(sample_start, fir_start, table_N);
+
+  // Linear interpolation.
+  // fir_offset_rmd is equal for all samples, it can thus be factorized out:
+  // sum(v1 + rmd*(v2 - v1)) = sum(v1) + rmd*(sum(v2) - sum(v1))
+  // The product does not fit in 32 bits for steep signals.
+  int v = v1 + int((long long)fir_offset_rmd*(v2 - v1) >> FIXP_SHIFT);
+
+  v >>= FIR_SHIFT;
+
+  // Saturated arithmetics to guard against 16 bit sample overflow.
+  const int half = 1 << 15;
+  if (v >= half) {
+    v = half - 1;
+  }
+  else if (v < -half) {
+    v = -half;
+  }
+
+  return v;
 }
 
+
 // ----------------------------------------------------------------------------
 // SID clocking with audio sampling - cycle based with audio resampling.
 //
@@ -917,6 +1069,7 @@ static inline int convolve(const short *a, const short *b, int n)
 //   to be (via derivation of sum of two steps):
 //     2 * pass_freq + sqrt [ 2 * pass_freq * orig_sample_freq
 //       * (dest_sample_freq - 2 * pass_freq) / dest_sample_freq ]
+//   This is done by clock_resample_two_stage().
 //
 // NB! the result of right shifting negative numbers is really
 // implementation dependent in the C++ standard.
@@ -945,42 +1098,8 @@ int RESID::clock_resample_interpolate(cycle_count& delta_t, short* buf, int n,
     delta_t -= delta_t_sample;
     sample_offset = next_sample_offset & FIXP_MASK;
 
-    int fir_offset = sample_offset*fir_RES >> FIXP_SHIFT;
-    int fir_offset_rmd = sample_offset*fir_RES & FIXP_MASK;
-    short* fir_start = fir + fir_offset*fir_N;
-    short* sample_start = sample + sample_index - fir_N + RINGSIZE - 1;
-
-    // Convolution with filter impulse response.
-    int v1 = convolve(sample_start, fir_start, fir_N);
-
-    // Use next FIR table, wrap around to first FIR table using
-    // previous sample.
-    if (++fir_offset == fir_RES) {
-      fir_offset = 0;
-      ++sample_start;
-    }
-    fir_start = fir + fir_offset*fir_N;
-
-    // Convolution with filter impulse response.
-    int v2 = convolve(sample_start, fir_start, fir_N);
-
-    // Linear interpolation.
-    // fir_offset_rmd is equal for all samples, it can thus be factorized out:
-    // sum(v1 + rmd*(v2 - v1)) = sum(v1) + rmd*(sum(v2) - sum(v1))
-    int v = v1 + (fir_offset_rmd*(v2 - v1) >> FIXP_SHIFT);
-
-    v >>= FIR_SHIFT;
-
-    // Saturated arithmetics to guard against 16 bit sample overflow.
-    const int half = 1 << 15;
-    if (v >= half) {
-      v = half - 1;
-    }
-    else if (v < -half) {
-      v = -half;
-    }
-
-    buf[s++*interleave] = v;
+    buf[s++*interleave] =
+      resample_fir(sample, sample_index, fir, fir_N, fir_RES, sample_offset);
   }
 
   for (int i = 0; i < delta_t; i++) {
@@ -1027,7 +1146,7 @@ int RESID::clock_resample_fast(cycle_count& delta_t, short* buf, int n,
     short* sample_start = sample + sample_index - fir_N + RINGSIZE;
 
     // Convolution with filter impulse response.
-    int v = convolve(sample_start, fir_start, fir_N);
+    int v = convolve_fir(sample_start, fir_start, fir_N);
     v >>= FIR_SHIFT;
 
     // Saturated arithmetics to guard against 16 bit sample overflow.
@@ -1052,3 +1171,71 @@ int RESID::clock_resample_fast(cycle_count& delta_t, short* buf, int n,
   delta_t = 0;
   return s;
 }
+
+
+// ----------------------------------------------------------------------------
+// SID clocking with audio sampling - cycle based with audio resampling in
+// two steps.
+//
+// The first step decimates the cycle samples to decim_frequency. Its
+// transition band reaches from the passband up to decim_frequency less the
+// passband, so the filter is short. The second step resamples to the
+// sampling frequency like clock_resample_interpolate(); its filter has the
+// same order as for one step, but spans far fewer samples. E.g. for PAL at
+// 48kHz with a passband up to 21.6kHz, this takes about a third of the
+// multiplications. The output differs from one step resampling only by the
+// rounding of the intermediate samples to 16 bits.
+// ----------------------------------------------------------------------------
+RESID_INLINE
+int RESID::clock_resample_two_stage(cycle_count& delta_t, short* buf, int n,
+				   int interleave)
+{
+  int s = 0;
+
+  for (;;) {
+    cycle_count next_decim_offset = decim_offset + cycles_per_decim;
+    cycle_count delta_t_sample = next_decim_offset >> FIXP_SHIFT;
+    if (delta_t_sample > delta_t) {
+      break;
+    }
+    // Stop before the intermediate sample completing the next output
+    // sample if there is no room for it.
+    if (decim_pending == 1 && s >= n) {
+      return s;
+    }
+    for (int i = 0; i < delta_t_sample; i++) {
+      clock();
+      sample[sample_index] = sample[sample_index + RINGSIZE] = output();
+      ++sample_index;
+      sample_index &= RINGSIZE - 1;
+    }
+    delta_t -= delta_t_sample;
+    decim_offset = next_decim_offset & FIXP_MASK;
+
+    decimated[decimated_index] = decimated[decimated_index + RINGSIZE] =
+      resample_fir(sample, sample_index, fir_decim, fir_decim_N,
+		   fir_decim_RES, decim_offset);
+    ++decimated_index;
+    decimated_index &= RINGSIZE - 1;
+
+    if (--decim_pending == 0) {
+      buf[s++*interleave] =
+	resample_fir(decimated, decimated_index, fir, fir_N, fir_RES,
+		     sample_offset);
+
+      cycle_count next_sample_offset = sample_offset + cycles_per_sample;
+      decim_pending = next_sample_offset >> FIXP_SHIFT;
+      sample_offset = next_sample_offset & FIXP_MASK;
+    }
+  }
+
+  for (int i = 0; i < delta_t; i++) {
+    clock();
+    sample[sample_index] = sample[sample_index + RINGSIZE] = output();
+    ++sample_index;
+    sample_index &= RINGSIZE - 1;
+  }
+  decim_offset -= delta_t << FIXP_SHIFT;
+  delta_t = 0;
+  return s;
+}
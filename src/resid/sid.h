@@ -35,6 +35,7 @@ public:
   void set_chip_model(chip_model model);
   void enable_filter(bool enable);
   void enable_external_filter(bool enable);
+  void enable_two_stage_resampling(bool enable);
   bool set_sampling_parameters(double clock_freq, sampling_method method,
 			       double sample_freq, double pass_freq = -1,
 			       double filter_scale = 0.97);
@@ -95,6 +96,16 @@ protected:
 					      int n, int interleave);
   RESID_INLINE int clock_resample_fast(cycle_count& delta_t, short* buf,
 				       int n, int interleave);
+  RESID_INLINE int clock_resample_two_stage(cycle_count& delta_t, short* buf,
+					    int n, int interleave);
+  RESID_INLINE int convolve_fir(const short* a, const short* b, int n);
+  RESID_INLINE int resample_fir(const short* ring, int index,
+				const short* table, int table_N, int table_RES,
+				cycle_count offset);
+  static void build_fir(short*& table, int& table_N, int& table_RES,
+			sampling_method method, double clock_freq,
+			double sample_freq, double pass_freq,
+			double filter_scale);
 
   Voice voice[3];
   Filter filter;
@@ -141,6 +152,25 @@ protected:
 
   // FIR_RES filter tables (FIR_N*FIR_RES).
   short* fir;
+
+  // Two-stage resampling: the cycle samples are decimated to
+  // decim_frequency first, then fir resamples these to the sampling
+  // frequency.
+  bool two_stage;
+  bool two_stage_active;
+  double decim_frequency;
+  cycle_count cycles_per_decim;
+  cycle_count decim_offset;
+  int decim_pending;
+  int decimated_index;
+  int fir_decim_N;
+  int fir_decim_RES;
+  short* decimated;
+  short* fir_decim;
+
+  // Run time selection of the convolution kernel.
+  bool can_use_sse2;
+  bool can_use_altivec;
 };
 
 #endif // not __SID_H__
@@ -0,0 +1,338 @@
+/*
+ * rewind.c - Rewind buffer built from in-memory snapshots.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* Every `RewindInterval' frames a memory snapshot of the machine is taken.
+   Only the newest snapshot is kept in full; for every older one the ring
+   holds the 256 byte pages that differ from the next newer snapshot.
+   As RAM, color RAM, expansion RAM and drive RAM are stored as plain byte
+   arrays, a frame usually costs a few pages only.  Stepping back applies
+   the newest delta to the full snapshot and restores it.  */
+
+#include "vice.h"
+
+#include <string.h>
+
+#include "cmdline.h"
+#include "interrupt.h"
+#include "lib.h"
+#include "machine.h"
+#include "resources.h"
+#include "rewind.h"
+#include "translate.h"
+#include "types.h"
+
+
+#define REWIND_PAGE_SIZE 0x100
+
+typedef struct rewind_entry_s {
+    /* Pages of the older snapshot that differ from the next newer one,
+       each preceded by its page number.  */
+    BYTE *delta;
+    size_t delta_size;
+} rewind_entry_t;
+
+int rewind_enabled = 0;
+
+static int rewind_frames;
+static int rewind_interval;
+
+/* Ring of deltas, oldest first.  */
+static rewind_entry_t *entries = NULL;
+static unsigned int entries_first = 0;
+static unsigned int entries_num = 0;
+static unsigned long entries_memory = 0;
+
+/* The newest snapshot.  */
+static BYTE *current = NULL;
+static size_t current_size = 0;
+
+static int frame_count = 0;
+static int capture_pending = 0;
+static int step_pending = 0;
+
+/* Flag: Has `current' just been restored?  */
+static int restored = 0;
+
+/* ------------------------------------------------------------------------- */
+
+/* Return the pages of `older' that differ from `newer'.  */
+static BYTE *rewind_delta_encode(const BYTE *older, const BYTE *newer,
+                                 size_t size, size_t *delta_size)
+{
+    BYTE *delta, *p;
+    size_t offset, len;
+    DWORD page;
+
+    delta = p = lib_malloc(size + (size / REWIND_PAGE_SIZE + 1) * sizeof(DWORD));
+
+    for (offset = 0; offset < size; offset += REWIND_PAGE_SIZE) {
+        len = size - offset;
+        if (len > REWIND_PAGE_SIZE)
+            len = REWIND_PAGE_SIZE;
+
+        if (memcmp(older + offset, newer + offset, len) != 0) {
+            page = (DWORD)(offset / REWIND_PAGE_SIZE);
+            memcpy(p, &page, sizeof(DWORD));
+            memcpy(p + sizeof(DWORD), older + offset, len);
+            p += sizeof(DWORD) + len;
+        }
+    }
+
+    *delta_size = (size_t)(p - delta);
+
+    if (*delta_size == 0) {
+        lib_free(delta);
+        return NULL;
+    }
+
+    return lib_realloc(delta, *delta_size);
+}
+
+static void rewind_delta_apply(BYTE *image, size_t size, const BYTE *delta,
+                               size_t delta_size)
+{
+    const BYTE *p, *end;
+    size_t offset, len;
+    DWORD page;
+
+    for (p = delta, end = delta + delta_size; p < end; p += len) {
+        memcpy(&page, p, sizeof(DWORD));
+        p += sizeof(DWORD);
+
+        offset = (size_t)page * REWIND_PAGE_SIZE;
+        len = size - offset;
+        if (len > REWIND_PAGE_SIZE)
+            len = REWIND_PAGE_SIZE;
+
+        memcpy(image + offset, p, len);
+    }
+}
+
+static rewind_entry_t *rewind_newest(void)
+{
+    return &entries[(entries_first + entries_num - 1) % rewind_frames];
+}
+
+static void rewind_free_entry(rewind_entry_t *e)
+{
+    entries_memory -= (unsigned long)e->delta_size;
+    lib_free(e->delta);
+    e->delta = NULL;
+    e->delta_size = 0;
+}
+
+static void rewind_push(BYTE *delta, size_t delta_size)
+{
+    rewind_entry_t *e;
+
+    if (entries_num == (unsigned int)rewind_frames) {
+        rewind_free_entry(&entries[entries_first]);
+        entries_first = (entries_first + 1) % rewind_frames;
+        entries_num--;
+    }
+
+    entries_num++;
+    e = rewind_newest();
+    e->delta = delta;
+    e->delta_size = delta_size;
+    entries_memory += (unsigned long)delta_size;
+}
+
+/* ------------------------------------------------------------------------- */
+
+void rewind_clear(void)
+{
+    unsigned int i;
+
+    for (i = 0; i < entries_num; i++)
+        rewind_free_entry(&entries[(entries_first + i) % rewind_frames]);
+
+    entries_first = 0;
+    entries_num = 0;
+
+    lib_free(current);
+    current = NULL;
+    current_size = 0;
+    restored = 0;
+}
+
+static void rewind_capture_trap(WORD addr, void *data)
+{
+    BYTE *image, *delta;
+    size_t size, delta_size;
+    rewind_entry_t *e;
+
+    capture_pending = 0;
+
+    if (!rewind_enabled
+        || machine_write_snapshot_memory(&image, &size, 0, 0, 0) < 0)
+        return;
+
+    if (current == NULL || size != current_size) {
+        /* The machine configuration has changed.  */
+        rewind_clear();
+    } else if (!restored) {
+        delta = rewind_delta_encode(current, image, size, &delta_size);
+        rewind_push(delta, delta_size);
+    } else if (entries_num > 0) {
+        /* Drop the state we have just stepped back to, so that stepping
+           back again goes further back instead of returning to it: the
+           newest delta is rebased onto the new snapshot.  */
+        e = rewind_newest();
+        rewind_delta_apply(current, size, e->delta, e->delta_size);
+        rewind_free_entry(e);
+        e->delta = rewind_delta_encode(current, image, size, &e->delta_size);
+        entries_memory += (unsigned long)e->delta_size;
+    }
+
+    lib_free(current);
+    current = image;
+    current_size = size;
+    restored = 0;
+}
+
+static void rewind_step_trap(WORD addr, void *data)
+{
+    rewind_entry_t *e;
+
+    step_pending = 0;
+
+    if (current == NULL)
+        return;
+
+    if (entries_num > 0) {
+        e = rewind_newest();
+        rewind_delta_apply(current, current_size, e->delta, e->delta_size);
+        rewind_free_entry(e);
+        entries_num--;
+    }
+
+    if (machine_read_snapshot_memory(current, current_size, 0) < 0) {
+        rewind_clear();
+        return;
+    }
+
+    restored = 1;
+    frame_count = 0;
+}
+
+/* Called at the end of every frame.  */
+void rewind_vsync(void)
+{
+    if (!rewind_enabled || ++frame_count < rewind_interval)
+        return;
+
+    frame_count = 0;
+
+    if (!capture_pending) {
+        capture_pending = 1;
+        interrupt_maincpu_trigger_trap(rewind_capture_trap, NULL);
+    }
+}
+
+/* Go back to the previous state in the buffer.  */
+void rewind_step(void)
+{
+    if (!rewind_enabled || step_pending)
+        return;
+
+    step_pending = 1;
+    interrupt_maincpu_trigger_trap(rewind_step_trap, NULL);
+}
+
+unsigned int rewind_get_depth(void)
+{
+    return entries_num;
+}
+
+unsigned long rewind_get_memory(void)
+{
+    return entries_memory + (unsigned long)current_size;
+}
+
+void rewind_shutdown(void)
+{
+    rewind_clear();
+    lib_free(entries);
+    entries = NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static int set_rewind_frames(int val, void *param)
+{
+    if (val < 0)
+        return -1;
+
+    rewind_shutdown();
+
+    rewind_frames = val;
+    rewind_enabled = (val > 0);
+
+    if (rewind_enabled)
+        entries = lib_calloc((size_t)val, sizeof(rewind_entry_t));
+
+    return 0;
+}
+
+static int set_rewind_interval(int val, void *param)
+{
+    if (val < 1)
+        return -1;
+
+    rewind_interval = val;
+
+    return 0;
+}
+
+static const resource_int_t resources_int[] = {
+    { "RewindFrames", 0, RES_EVENT_NO, NULL,
+      &rewind_frames, set_rewind_frames, NULL },
+    { "RewindInterval", 1, RES_EVENT_NO, NULL,
+      &rewind_interval, set_rewind_interval, NULL },
+    { NULL }
+};
+
+int rewind_resources_init(void)
+{
+    return resources_register_int(resources_int);
+}
+
+static const cmdline_option_t cmdline_options[] = {
+    { "-rewindframes", SET_RESOURCE, 1,
+      NULL, NULL, "RewindFrames", NULL,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      T_("<number>"), T_("Number of states kept for rewinding (0: disabled)") },
+    { "-rewindinterval", SET_RESOURCE, 1,
+      NULL, NULL, "RewindInterval", NULL,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      T_("<frames>"), T_("Number of frames between two rewind states") },
+    { NULL }
+};
+
+int rewind_cmdline_options_init(void)
+{
+    return cmdline_register_options(cmdline_options);
+}
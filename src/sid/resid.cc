@@ -80,6 +80,7 @@ static int resid_init(sound_t *psid, int speed, int cycles_per_sec)
 	char method_text[100];
 	double passband, gain;
 	int filters_enabled, model, sampling, passband_percentage, gain_percentage;
+	int two_stage;
 
 	if (resources_get_int("SidFilters", &filters_enabled) < 0)
 		return 0;
@@ -96,6 +97,9 @@ static int resid_init(sound_t *psid, int speed, int cycles_per_sec)
 	if (resources_get_int("SidResidGain", &gain_percentage) < 0)
 		return 0;
 
+	if (resources_get_int("SidResidTwoStage", &two_stage) < 0)
+		return 0;
+
 	passband = speed * passband_percentage / 200.0;
 	gain = gain_percentage / 100.0;
 
@@ -143,7 +147,7 @@ static int resid_init(sound_t *psid, int speed, int cycles_per_sec)
 			break;
 		case 2:
 			method = SAMPLE_RESAMPLE_INTERPOLATE;
-			sprintf(method_text, "resampling, pass to %dHz", (int)passband);
+			sprintf(method_text, "resampling%s, pass to %dHz", two_stage ? " in two steps" : "", (int)passband);
 			break;
 		case 3:
 			method = SAMPLE_RESAMPLE_FAST;
@@ -151,6 +155,8 @@ static int resid_init(sound_t *psid, int speed, int cycles_per_sec)
 			break;
 	}
 
+	psid->sid->enable_two_stage_resampling(two_stage ? true : false);
+
 	if (!psid->sid->set_sampling_parameters(cycles_per_sec, method, speed, passband, gain))
 	{
 #ifdef CELL_DEBUG
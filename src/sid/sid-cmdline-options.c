@@ -112,6 +112,16 @@ static const cmdline_option_t resid_cmdline_options[] = {
       USE_PARAM_ID, USE_DESCRIPTION_ID,
       IDCLS_P_PERCENT, IDCLS_RESID_GAIN_PERCENTAGE,
       NULL, NULL },
+    { "-residtwostage", SET_RESOURCE, 0,
+      NULL, NULL, "SidResidTwoStage", (void *)1,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      NULL, T_("Resample reSID output in two steps") },
+    { "+residtwostage", SET_RESOURCE, 0,
+      NULL, NULL, "SidResidTwoStage", (void *)0,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      NULL, T_("Resample reSID output in one step") },
     { NULL }
 };
 #endif
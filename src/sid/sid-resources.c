@@ -52,6 +52,7 @@ static int sid_model;                 /* app_resources.sidModel */
 static int sid_resid_sampling;
 static int sid_resid_passband;
 static int sid_resid_gain;
+static int sid_resid_two_stage;
 #endif
 int sid_stereo;
 int checking_sid_stereo;
@@ -241,6 +242,13 @@ static int set_sid_resid_gain(int i, void *param)
     return 0;
 }
 
+static int set_sid_resid_two_stage(int val, void *param)
+{
+    sid_resid_two_stage = val;
+    sid_state_changed = 1;
+    return 0;
+}
+
 #endif
 
 #ifdef HAVE_HARDSID
@@ -319,6 +327,8 @@ static const resource_int_t resid_resources_int[] = {
       &sid_resid_passband, set_sid_resid_passband, NULL },
     { "SidResidGain", 97, RES_EVENT_NO, NULL,
       &sid_resid_gain, set_sid_resid_gain, NULL },
+    { "SidResidTwoStage", 0, RES_EVENT_NO, NULL,
+      &sid_resid_two_stage, set_sid_resid_two_stage, NULL },
     { NULL }
 };
 #endif
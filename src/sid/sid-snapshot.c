@@ -122,6 +122,24 @@ static int sid_snapshot_read_module_simple(snapshot_t *s)
 	{
 		int res_sound = (int)(tmp[0]);
 		int res_engine = (int)(tmp[1]);
+		int cur_sound, cur_engine;
+
+		/* Keep the sound device open if the engine does not change and
+		   its state comes with the extended module anyway.  This makes
+		   restoring memory snapshots cheap.  */
+		resources_get_int("Sound", &cur_sound);
+		resources_get_int("SidEngine", &cur_engine);
+		if (res_sound && res_sound == cur_sound && res_engine == cur_engine
+			&& sound_get_psid(0) != NULL
+			&& (res_engine == SID_ENGINE_FASTSID
+#ifdef HAVE_RESID
+				|| res_engine == SID_ENGINE_RESID
+#endif
+			))
+		{
+			memcpy(sid_get_siddata(0), &tmp[2], 32);
+			return snapshot_module_close(m);
+		}
 
 		//screenshot_prepare_reopen();
 		sound_close();
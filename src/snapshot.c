@@ -26,27 +26,62 @@
 
 #include "vice.h"
 
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
 #include "archdep.h"
+#include "cmdline.h"
 #include "lib.h"
 #include "ioutil.h"
+#include "resources.h"
 #include "snapshot.h"
+#include "translate.h"
 #include "types.h"
 #include "vsync.h"
 #include "zfile.h"
 
 
 char snapshot_magic_string[] = "VICE Snapshot File\032";
+char snapshot_pack_magic_string[] = "VICE Snapshot Pack\032";
 
 #define SNAPSHOT_MAGIC_LEN              19
 
-struct snapshot_module_s {
-    /* File descriptor.  */
+/* Name, version and size of a module.  */
+#define SNAPSHOT_MODULE_HEADER_LEN      (SNAPSHOT_MODULE_NAME_LEN + 6)
+
+/* Number of threads compressing the modules of a packed snapshot.  */
+#define SNAPSHOT_PACK_THREADS           2
+
+/* zlib level for packed snapshots; 0 writes plain snapshots.  */
+static int snapshot_compression = 0;
+
+/* Snapshots are written to and read from either a file or a memory
+   buffer.  */
+typedef struct snapshot_stream_s {
+    /* File descriptor, or NULL for a memory snapshot.  */
     FILE *file;
 
+    /* Memory buffer, its allocated and used size and the current
+       position.  */
+    BYTE *data;
+    size_t alloc;
+    size_t size;
+    size_t pos;
+} snapshot_stream_t;
+
+/* Initial size of the buffer of a memory snapshot.  */
+#define SNAPSHOT_MEMORY_CHUNK 0x10000
+
+struct snapshot_module_s {
+    /* Stream of the snapshot.  */
+    snapshot_stream_t *file;
+
     /* Flag: are we writing it?  */
     int write_mode;
 
@@ -58,30 +93,136 @@ struct snapshot_module_s {
 
     /* Offset of the size field in the file.  */
     long size_offset;
+
+    /* Uncompressed module of a packed snapshot.  */
+    snapshot_stream_t stream;
 };
 
+/* Packed snapshots start with the usual header, followed by an index of
+   all modules and the modules themselves, each compressed on its own.
+   Modules can so be compressed in parallel and a single module can be
+   read without touching the others.  */
+typedef struct snapshot_pack_entry_s {
+    /* Module header as in plain snapshots.  */
+    BYTE header[SNAPSHOT_MODULE_HEADER_LEN];
+
+    /* Size of the whole module and of its compressed data.  */
+    DWORD size;
+    DWORD packed_size;
+
+    /* Offset of the compressed data in the file.  */
+    DWORD offset;
+
+    /* Module to compress and the compressed data when writing.  */
+    const BYTE *raw;
+    BYTE *data;
+} snapshot_pack_entry_t;
+
 struct snapshot_s {
-    /* File descriptor.  */
-    FILE *file;
+    /* File descriptor or memory buffer.  */
+    snapshot_stream_t stream;
+    snapshot_stream_t *file;
 
     /* Offset of the first module.  */
     long first_module_offset;
 
     /* Flag: are we writing it?  */
     int write_mode;
+
+    /* Packed snapshots are built in memory and written to `pack_file'
+       when closed.  */
+    FILE *pack_file;
+    int pack_level;
+
+    /* Module index of a packed snapshot that is read.  */
+    snapshot_pack_entry_t *index;
+    unsigned int index_num;
 };
 
 /* ------------------------------------------------------------------------- */
 
-static int snapshot_write_byte(FILE *f, BYTE data)
+static int snapshot_stream_reserve(snapshot_stream_t *f, size_t num)
 {
-    if (fputc(data, f) == EOF)
+    size_t alloc;
+
+    if (f->pos + num <= f->alloc)
+        return 0;
+
+    for (alloc = f->alloc ? f->alloc : SNAPSHOT_MEMORY_CHUNK;
+         alloc < f->pos + num; alloc *= 2);
+
+    f->data = lib_realloc(f->data, alloc);
+    f->alloc = alloc;
+
+    return 0;
+}
+
+static int snapshot_stream_write(snapshot_stream_t *f, const BYTE *data,
+                                 size_t num)
+{
+    if (f->file != NULL)
+        return (fwrite(data, num, 1, f->file) < 1) ? -1 : 0;
+
+    snapshot_stream_reserve(f, num);
+    memcpy(f->data + f->pos, data, num);
+    f->pos += num;
+    if (f->pos > f->size)
+        f->size = f->pos;
+
+    return 0;
+}
+
+static int snapshot_stream_read(snapshot_stream_t *f, BYTE *data, size_t num)
+{
+    if (f->file != NULL)
+        return (fread(data, num, 1, f->file) < 1) ? -1 : 0;
+
+    if (f->pos + num > f->size)
         return -1;
 
+    memcpy(data, f->data + f->pos, num);
+    f->pos += num;
+
     return 0;
 }
 
-static int snapshot_write_word(FILE *f, WORD data)
+static long snapshot_stream_tell(snapshot_stream_t *f)
+{
+    if (f->file != NULL)
+        return ftell(f->file);
+
+    return (long)f->pos;
+}
+
+static int snapshot_stream_seek(snapshot_stream_t *f, long offset)
+{
+    if (f->file != NULL)
+        return fseek(f->file, offset, SEEK_SET);
+
+    if (offset < 0 || (size_t)offset > f->size)
+        return -1;
+
+    f->pos = (size_t)offset;
+
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static int snapshot_write_byte(snapshot_stream_t *f, BYTE data)
+{
+    if (f->file != NULL)
+        return (fputc(data, f->file) == EOF) ? -1 : 0;
+
+    if (f->pos < f->size) {
+        f->data[f->pos++] = data;
+        return 0;
+    }
+
+    return snapshot_stream_write(f, &data, 1);
+}
+
+static int snapshot_write_word(snapshot_stream_t *f, WORD data)
 {
     if (snapshot_write_byte(f, (BYTE)(data & 0xff)) < 0
         || snapshot_write_byte(f, (BYTE)(data >> 8)) < 0)
@@ -90,7 +231,7 @@ static int snapshot_write_word(FILE *f, WORD data)
     return 0;
 }
 
-static int snapshot_write_dword(FILE *f, DWORD data)
+static int snapshot_write_dword(snapshot_stream_t *f, DWORD data)
 {
     if (snapshot_write_word(f, (WORD)(data & 0xffff)) < 0
         || snapshot_write_word(f, (WORD)(data >> 16)) < 0)
@@ -99,8 +240,8 @@ static int snapshot_write_dword(FILE *f, DWORD data)
     return 0;
 }
 
-static int snapshot_write_padded_string(FILE *f, const char *s, BYTE pad_char,
-                                        int len)
+static int snapshot_write_padded_string(snapshot_stream_t *f, const char *s,
+                                        BYTE pad_char, int len)
 {
     int i, found_zero;
     BYTE c;
@@ -116,16 +257,18 @@ static int snapshot_write_padded_string(FILE *f, const char *s, BYTE pad_char,
     return 0;
 }
 
-static int snapshot_write_byte_array(FILE *f, BYTE *data, unsigned int num)
+static int snapshot_write_byte_array(snapshot_stream_t *f, BYTE *data,
+                                     unsigned int num)
 {
-    if (num > 0 && fwrite(data, (size_t)num, 1, f) < 1)
+    if (num > 0 && snapshot_stream_write(f, data, (size_t)num) < 0)
         return -1;
 
     return 0;
 }
 
 
-static int snapshot_write_word_array(FILE *f, WORD *data, unsigned int num)
+static int snapshot_write_word_array(snapshot_stream_t *f, WORD *data,
+                                     unsigned int num)
 {
     unsigned int i;
 
@@ -136,7 +279,8 @@ static int snapshot_write_word_array(FILE *f, WORD *data, unsigned int num)
     return 0;
 }
 
-static int snapshot_write_dword_array(FILE *f, DWORD *data, unsigned int num)
+static int snapshot_write_dword_array(snapshot_stream_t *f, DWORD *data,
+                                      unsigned int num)
 {
     unsigned int i;
 
@@ -148,7 +292,7 @@ static int snapshot_write_dword_array(FILE *f, DWORD *data, unsigned int num)
 }
 
 
-static int snapshot_write_string(FILE *f, const char *s)
+static int snapshot_write_string(snapshot_stream_t *f, const char *s)
 {
     size_t len, i;
 
@@ -164,18 +308,25 @@ static int snapshot_write_string(FILE *f, const char *s)
     return (int)(len + sizeof(WORD));
 }
 
-static int snapshot_read_byte(FILE *f, BYTE *b_return)
+static int snapshot_read_byte(snapshot_stream_t *f, BYTE *b_return)
 {
     int c;
 
-    c = fgetc(f);
+    if (f->file == NULL) {
+        if (f->pos >= f->size)
+            return -1;
+        *b_return = f->data[f->pos++];
+        return 0;
+    }
+
+    c = fgetc(f->file);
     if (c == EOF)
         return -1;
     *b_return = (BYTE)c;
     return 0;
 }
 
-static int snapshot_read_word(FILE *f, WORD *w_return)
+static int snapshot_read_word(snapshot_stream_t *f, WORD *w_return)
 {
     BYTE lo, hi;
 
@@ -186,7 +337,7 @@ static int snapshot_read_word(FILE *f, WORD *w_return)
     return 0;
 }
 
-static int snapshot_read_dword(FILE *f, DWORD *dw_return)
+static int snapshot_read_dword(snapshot_stream_t *f, DWORD *dw_return)
 {
     WORD lo, hi;
 
@@ -197,16 +348,18 @@ static int snapshot_read_dword(FILE *f, DWORD *dw_return)
     return 0;
 }
 
-static int snapshot_read_byte_array(FILE *f, BYTE *b_return, unsigned int num)
+static int snapshot_read_byte_array(snapshot_stream_t *f, BYTE *b_return,
+                                    unsigned int num)
 {
-    if (num > 0 && fread(b_return, (size_t)num, 1, f) < 1)
+    if (num > 0 && snapshot_stream_read(f, b_return, (size_t)num) < 0)
         return -1;
 
     return 0;
 }
 
 
-static int snapshot_read_word_array(FILE *f, WORD *w_return, unsigned int num)
+static int snapshot_read_word_array(snapshot_stream_t *f, WORD *w_return,
+                                    unsigned int num)
 {
     unsigned int i;
 
@@ -217,7 +370,7 @@ static int snapshot_read_word_array(FILE *f, WORD *w_return, unsigned int num)
     return 0;
 }
 
-static int snapshot_read_dword_array(FILE *f, DWORD *dw_return,
+static int snapshot_read_dword_array(snapshot_stream_t *f, DWORD *dw_return,
                                      unsigned int num)
 {
     unsigned int i;
@@ -230,7 +383,7 @@ static int snapshot_read_dword_array(FILE *f, DWORD *dw_return,
 }
 
 
-static int snapshot_read_string(FILE *f, char **s)
+static int snapshot_read_string(snapshot_stream_t *f, char **s)
 {
     int i, len;
     WORD w;
@@ -345,7 +498,7 @@ int snapshot_module_write_string(snapshot_module_t *m, const char *s)
 
 int snapshot_module_read_byte(snapshot_module_t *m, BYTE *b_return)
 {
-    if (ftell(m->file) + sizeof(BYTE) > m->offset + m->size)
+    if (snapshot_stream_tell(m->file) + sizeof(BYTE) > m->offset + m->size)
         return -1;
 
     return snapshot_read_byte(m->file, b_return);
@@ -353,7 +506,7 @@ int snapshot_module_read_byte(snapshot_module_t *m, BYTE *b_return)
 
 int snapshot_module_read_word(snapshot_module_t *m, WORD *w_return)
 {
-    if (ftell(m->file) + sizeof(WORD) > m->offset + m->size)
+    if (snapshot_stream_tell(m->file) + sizeof(WORD) > m->offset + m->size)
         return -1;
 
     return snapshot_read_word(m->file, w_return);
@@ -361,7 +514,7 @@ int snapshot_module_read_word(snapshot_module_t *m, WORD *w_return)
 
 int snapshot_module_read_dword(snapshot_module_t *m, DWORD *dw_return)
 {
-    if (ftell(m->file) + sizeof(DWORD) > m->offset + m->size)
+    if (snapshot_stream_tell(m->file) + sizeof(DWORD) > m->offset + m->size)
         return -1;
 
     return snapshot_read_dword(m->file, dw_return);
@@ -370,7 +523,7 @@ int snapshot_module_read_dword(snapshot_module_t *m, DWORD *dw_return)
 int snapshot_module_read_byte_array(snapshot_module_t *m, BYTE *b_return,
                                     unsigned int num)
 {
-    if ((long)(ftell(m->file) + num) > (long)(m->offset + m->size))
+    if ((long)(snapshot_stream_tell(m->file) + num) > (long)(m->offset + m->size))
         return -1;
 
     return snapshot_read_byte_array(m->file, b_return, num);
@@ -379,7 +532,7 @@ int snapshot_module_read_byte_array(snapshot_module_t *m, BYTE *b_return,
 int snapshot_module_read_word_array(snapshot_module_t *m, WORD *w_return,
                                     unsigned int num)
 {
-    if ((long)(ftell(m->file) + num * sizeof(WORD))
+    if ((long)(snapshot_stream_tell(m->file) + num * sizeof(WORD))
         > (long)(m->offset + m->size))
         return -1;
 
@@ -389,7 +542,7 @@ int snapshot_module_read_word_array(snapshot_module_t *m, WORD *w_return,
 int snapshot_module_read_dword_array(snapshot_module_t *m, DWORD *dw_return,
                                      unsigned int num)
 {
-    if ((long)(ftell(m->file) + num * sizeof(DWORD))
+    if ((long)(snapshot_stream_tell(m->file) + num * sizeof(DWORD))
         > (long)(m->offset + m->size))
         return -1;
 
@@ -398,7 +551,7 @@ int snapshot_module_read_dword_array(snapshot_module_t *m, DWORD *dw_return,
 
 int snapshot_module_read_string(snapshot_module_t *m, char **charp_return)
 {
-    if (ftell(m->file) + sizeof(WORD) > m->offset + m->size)
+    if (snapshot_stream_tell(m->file) + sizeof(WORD) > m->offset + m->size)
         return -1;
 
     return snapshot_read_string(m->file, charp_return);
@@ -465,9 +618,9 @@ snapshot_module_t *snapshot_module_create(snapshot_t *s,
 {
     snapshot_module_t *m;
 
-    m = lib_malloc(sizeof(snapshot_module_t));
+    m = lib_calloc(1, sizeof(snapshot_module_t));
     m->file = s->file;
-    m->offset = ftell(s->file);
+    m->offset = snapshot_stream_tell(s->file);
     if (m->offset == -1) {
         lib_free(m);
         return NULL;
@@ -481,12 +634,17 @@ snapshot_module_t *snapshot_module_create(snapshot_t *s,
         || snapshot_write_dword(s->file, 0) < 0)
         return NULL;
 
-    m->size = ftell(s->file) - m->offset;
-    m->size_offset = ftell(s->file) - sizeof(DWORD);
+    m->size = snapshot_stream_tell(s->file) - m->offset;
+    m->size_offset = snapshot_stream_tell(s->file) - sizeof(DWORD);
 
     return m;
 }
 
+static snapshot_module_t *snapshot_pack_module_open(snapshot_t *s,
+                                                    const char *name,
+                                                    BYTE *major_version_return,
+                                                    BYTE *minor_version_return);
+
 snapshot_module_t *snapshot_module_open(snapshot_t *s,
                                         const char *name,
                                         BYTE *major_version_return,
@@ -496,10 +654,14 @@ snapshot_module_t *snapshot_module_open(snapshot_t *s,
     char n[SNAPSHOT_MODULE_NAME_LEN];
     unsigned int name_len = (unsigned int)strlen(name);
 
-    if (fseek(s->file, s->first_module_offset, SEEK_SET) < 0)
+    if (s->index != NULL)
+        return snapshot_pack_module_open(s, name, major_version_return,
+                                         minor_version_return);
+
+    if (snapshot_stream_seek(s->file, s->first_module_offset) < 0)
         return NULL;
 
-    m = lib_malloc(sizeof(snapshot_module_t));
+    m = lib_calloc(1, sizeof(snapshot_module_t));
     m->file = s->file;
     m->write_mode = 0;
 
@@ -521,30 +683,37 @@ snapshot_module_t *snapshot_module_open(snapshot_t *s,
             break;
 
         m->offset += m->size;
-        if (fseek(s->file, m->offset, SEEK_SET) < 0)
+        if (snapshot_stream_seek(s->file, m->offset) < 0)
             goto fail;
     }
 
-    m->size_offset = ftell(s->file) - sizeof(DWORD);
+    m->size_offset = snapshot_stream_tell(s->file) - sizeof(DWORD);
 
     return m;
 
 fail:
-    fseek(s->file, s->first_module_offset, SEEK_SET);
+    snapshot_stream_seek(s->file, s->first_module_offset);
     lib_free(m);
     return NULL;
 }
 
 int snapshot_module_close(snapshot_module_t *m)
 {
+    /* Modules of packed snapshots are read from their own buffer.  */
+    if (m->file == &m->stream) {
+        lib_free(m->stream.data);
+        lib_free(m);
+        return 0;
+    }
+
     /* Backpatch module size if writing.  */
     if (m->write_mode
-        && (fseek(m->file, m->size_offset, SEEK_SET) < 0
+        && (snapshot_stream_seek(m->file, m->size_offset) < 0
             || snapshot_write_dword(m->file, m->size) < 0))
         return -1;
 
     /* Skip module.  */
-    if (fseek(m->file, m->offset + m->size, SEEK_SET) < 0)
+    if (snapshot_stream_seek(m->file, m->offset + m->size) < 0)
         return -1;
 
     lib_free(m);
@@ -553,74 +722,291 @@ int snapshot_module_close(snapshot_module_t *m)
 
 /* ------------------------------------------------------------------------- */
 
-snapshot_t *snapshot_create(const char *filename,
-                            BYTE major_version, BYTE minor_version,
-                            const char *snapshot_machine_name)
+static DWORD snapshot_get_dword(const BYTE *p)
 {
-    FILE *f;
-    snapshot_t *s;
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((DWORD)p[3] << 24);
+}
 
-    f = fopen(filename, MODE_WRITE);
-    if (f == NULL)
+#ifdef HAVE_ZLIB
+
+typedef struct snapshot_pack_job_s {
+    snapshot_pack_entry_t *entries;
+    unsigned int num;
+    int level;
+    volatile unsigned int next;
+    volatile int failed;
+} snapshot_pack_job_t;
+
+static void *snapshot_pack_thread(void *data)
+{
+    snapshot_pack_job_t *job = (snapshot_pack_job_t *)data;
+    snapshot_pack_entry_t *e;
+    unsigned int i;
+    uLongf len;
+
+    while ((i = __sync_fetch_and_add(&job->next, 1)) < job->num) {
+        e = &job->entries[i];
+        len = compressBound(e->size);
+        e->data = lib_malloc(len);
+
+        if (compress2(e->data, &len, e->raw, e->size, job->level) != Z_OK)
+            job->failed = 1;
+
+        e->packed_size = (DWORD)len;
+    }
+
+    return NULL;
+}
+
+/* Compress the modules of the snapshot built in memory and write them to
+   the pack file.  */
+static int snapshot_pack_write(snapshot_t *s)
+{
+    snapshot_stream_t out;
+    snapshot_pack_entry_t *entries;
+    snapshot_pack_job_t job;
+    pthread_t threads[SNAPSHOT_PACK_THREADS - 1];
+    int started[SNAPSHOT_PACK_THREADS - 1];
+    unsigned int i, num;
+    size_t pos;
+    DWORD offset;
+    int retval = 0;
+
+    /* Collect the modules.  */
+    num = 0;
+    for (pos = s->first_module_offset;
+         pos + SNAPSHOT_MODULE_HEADER_LEN <= s->stream.size;
+         pos += snapshot_get_dword(s->stream.data + pos
+                                   + SNAPSHOT_MODULE_NAME_LEN + 2))
+        num++;
+
+    entries = lib_calloc(num ? num : 1, sizeof(snapshot_pack_entry_t));
+
+    for (i = 0, pos = s->first_module_offset; i < num; i++) {
+        entries[i].raw = s->stream.data + pos;
+        entries[i].size = snapshot_get_dword(entries[i].raw
+                                             + SNAPSHOT_MODULE_NAME_LEN + 2);
+        memcpy(entries[i].header, entries[i].raw, SNAPSHOT_MODULE_HEADER_LEN);
+        pos += entries[i].size;
+    }
+
+    /* Compress them in parallel.  */
+    job.entries = entries;
+    job.num = num;
+    job.level = s->pack_level;
+    job.next = 0;
+    job.failed = 0;
+
+    for (i = 0; i < SNAPSHOT_PACK_THREADS - 1; i++)
+        started[i] = (pthread_create(&threads[i], NULL, snapshot_pack_thread,
+                                     &job) == 0);
+
+    snapshot_pack_thread(&job);
+
+    for (i = 0; i < SNAPSHOT_PACK_THREADS - 1; i++)
+        if (started[i])
+            pthread_join(threads[i], NULL);
+
+    /* Header, index and data.  */
+    memset(&out, 0, sizeof(out));
+    out.file = s->pack_file;
+
+    offset = (DWORD)(s->first_module_offset + sizeof(DWORD)
+                     + num * (SNAPSHOT_MODULE_HEADER_LEN + 2 * sizeof(DWORD)));
+
+    if (job.failed
+        || snapshot_write_padded_string(&out, snapshot_pack_magic_string,
+                                        (BYTE)0, SNAPSHOT_MAGIC_LEN) < 0
+        || snapshot_write_byte_array(&out, s->stream.data + SNAPSHOT_MAGIC_LEN,
+                                     (unsigned int)(s->first_module_offset
+                                                    - SNAPSHOT_MAGIC_LEN)) < 0
+        || snapshot_write_dword(&out, (DWORD)num) < 0)
+        retval = -1;
+
+    for (i = 0; i < num && retval == 0; i++) {
+        entries[i].offset = offset;
+        offset += entries[i].packed_size;
+
+        if (snapshot_write_byte_array(&out, entries[i].header,
+                                      SNAPSHOT_MODULE_HEADER_LEN) < 0
+            || snapshot_write_dword(&out, entries[i].packed_size) < 0
+            || snapshot_write_dword(&out, entries[i].offset) < 0)
+            retval = -1;
+    }
+
+    for (i = 0; i < num && retval == 0; i++) {
+        if (snapshot_write_byte_array(&out, entries[i].data,
+                                      entries[i].packed_size) < 0)
+            retval = -1;
+    }
+
+    for (i = 0; i < num; i++)
+        lib_free(entries[i].data);
+    lib_free(entries);
+
+    return retval;
+}
+
+static int snapshot_pack_read_index(snapshot_t *s)
+{
+    snapshot_pack_entry_t *e;
+    DWORD num;
+    unsigned int i;
+
+    if (snapshot_read_dword(s->file, &num) < 0 || num > 0x10000)
+        return -1;
+
+    s->index = lib_calloc(num ? num : 1, sizeof(snapshot_pack_entry_t));
+    s->index_num = (unsigned int)num;
+
+    for (i = 0; i < num; i++) {
+        e = &s->index[i];
+        if (snapshot_read_byte_array(s->file, e->header,
+                                     SNAPSHOT_MODULE_HEADER_LEN) < 0
+            || snapshot_read_dword(s->file, &e->packed_size) < 0
+            || snapshot_read_dword(s->file, &e->offset) < 0)
+            return -1;
+
+        e->size = snapshot_get_dword(e->header + SNAPSHOT_MODULE_NAME_LEN + 2);
+        if (e->size < SNAPSHOT_MODULE_HEADER_LEN)
+            return -1;
+    }
+
+    return 0;
+}
+
+static snapshot_module_t *snapshot_pack_module_open(snapshot_t *s,
+                                                    const char *name,
+                                                    BYTE *major_version_return,
+                                                    BYTE *minor_version_return)
+{
+    snapshot_module_t *m;
+    snapshot_pack_entry_t *e = NULL;
+    unsigned int i, name_len = (unsigned int)strlen(name);
+    BYTE *packed;
+    uLongf len;
+
+    for (i = 0; i < s->index_num; i++) {
+        if (memcmp(s->index[i].header, name, name_len) == 0
+            && (name_len == SNAPSHOT_MODULE_NAME_LEN
+                || s->index[i].header[name_len] == 0)) {
+            e = &s->index[i];
+            break;
+        }
+    }
+
+    if (e == NULL || snapshot_stream_seek(s->file, (long)e->offset) < 0)
+        return NULL;
+
+    packed = lib_malloc(e->packed_size ? e->packed_size : 1);
+    if (snapshot_read_byte_array(s->file, packed, e->packed_size) < 0) {
+        lib_free(packed);
         return NULL;
+    }
 
+    m = lib_calloc(1, sizeof(snapshot_module_t));
+    m->stream.data = lib_malloc(e->size);
+    len = e->size;
+
+    if (uncompress(m->stream.data, &len, packed, e->packed_size) != Z_OK
+        || len != e->size) {
+        lib_free(packed);
+        lib_free(m->stream.data);
+        lib_free(m);
+        return NULL;
+    }
+    lib_free(packed);
+
+    m->stream.alloc = m->stream.size = e->size;
+    m->stream.pos = SNAPSHOT_MODULE_HEADER_LEN;
+    m->file = &m->stream;
+    m->write_mode = 0;
+    m->offset = 0;
+    m->size = e->size;
+    m->size_offset = SNAPSHOT_MODULE_HEADER_LEN - sizeof(DWORD);
+
+    *major_version_return = e->header[SNAPSHOT_MODULE_NAME_LEN];
+    *minor_version_return = e->header[SNAPSHOT_MODULE_NAME_LEN + 1];
+
+    return m;
+}
+
+#else
+
+static int snapshot_pack_write(snapshot_t *s)
+{
+    return -1;
+}
+
+static int snapshot_pack_read_index(snapshot_t *s)
+{
+    return -1;
+}
+
+static snapshot_module_t *snapshot_pack_module_open(snapshot_t *s,
+                                                    const char *name,
+                                                    BYTE *major_version_return,
+                                                    BYTE *minor_version_return)
+{
+    return NULL;
+}
+
+#endif
+
+/* ------------------------------------------------------------------------- */
+
+static int snapshot_write_header(snapshot_stream_t *f,
+                                 BYTE major_version, BYTE minor_version,
+                                 const char *snapshot_machine_name)
+{
     /* Magic string.  */
     if (snapshot_write_padded_string(f, snapshot_magic_string,
                                      (BYTE)0, SNAPSHOT_MAGIC_LEN) < 0)
-        goto fail;
+        return -1;
 
     /* Version number.  */
     if (snapshot_write_byte(f, major_version) < 0
         || snapshot_write_byte(f, minor_version) < 0)
-        goto fail;
+        return -1;
 
     /* Machine.  */
     if (snapshot_write_padded_string(f, snapshot_machine_name, (BYTE)0,
                                      SNAPSHOT_MACHINE_NAME_LEN) < 0)
-        goto fail;
-
-    s = lib_malloc(sizeof(snapshot_t));
-    s->file = f;
-    s->first_module_offset = ftell(f);
-    s->write_mode = 1;
-
-    return s;
+        return -1;
 
-fail:
-    fclose(f);
-    ioutil_remove(filename);
-    return NULL;
+    return 0;
 }
 
-snapshot_t *snapshot_open(const char *filename,
-                          BYTE *major_version_return,
-                          BYTE *minor_version_return,
-                          const char *snapshot_machine_name)
+static int snapshot_read_header(snapshot_stream_t *f, int *packed_return,
+                                BYTE *major_version_return,
+                                BYTE *minor_version_return,
+                                const char *snapshot_machine_name)
 {
-    FILE *f;
     char magic[SNAPSHOT_MAGIC_LEN];
     char read_name[SNAPSHOT_MACHINE_NAME_LEN];
-    snapshot_t *s = NULL;
     int machine_name_len;
 
-    f = zfile_fopen(filename, MODE_READ);
-    if (f == NULL)
-        return NULL;
-
     /* Magic string.  */
-    if (snapshot_read_byte_array(f, (BYTE *)magic, SNAPSHOT_MAGIC_LEN) < 0
-        || memcmp(magic, snapshot_magic_string, SNAPSHOT_MAGIC_LEN) != 0)
-        goto fail;
+    if (snapshot_read_byte_array(f, (BYTE *)magic, SNAPSHOT_MAGIC_LEN) < 0)
+        return -1;
+
+    if (memcmp(magic, snapshot_magic_string, SNAPSHOT_MAGIC_LEN) == 0)
+        *packed_return = 0;
+    else if (memcmp(magic, snapshot_pack_magic_string,
+                    SNAPSHOT_MAGIC_LEN) == 0)
+        *packed_return = 1;
+    else
+        return -1;
 
     /* Version number.  */
     if (snapshot_read_byte(f, major_version_return) < 0
         || snapshot_read_byte(f, minor_version_return) < 0)
-        goto fail;
+        return -1;
 
     /* Machine.  */
     if (snapshot_read_byte_array(f, (BYTE *)read_name,
                                  SNAPSHOT_MACHINE_NAME_LEN) < 0)
-        goto fail;
+        return -1;
 
     /* Check machine name.  */
     machine_name_len = (int)strlen(snapshot_machine_name);
@@ -628,39 +1014,230 @@ snapshot_t *snapshot_open(const char *filename,
         || (machine_name_len != SNAPSHOT_MODULE_NAME_LEN
             && read_name[machine_name_len] != 0)) {
         //log_error(LOG_DEFAULT, "SNAPSHOT: Wrong machine type.");
-        goto fail;
+        return -1;
     }
 
-    s = lib_malloc(sizeof(snapshot_t));
-    s->file = f;
-    s->first_module_offset = ftell(f);
-    s->write_mode = 0;
+    return 0;
+}
+
+static snapshot_t *snapshot_new(FILE *f, int write_mode)
+{
+    snapshot_t *s;
+
+    s = lib_calloc(1, sizeof(snapshot_t));
+    s->stream.file = f;
+    s->file = &s->stream;
+    s->write_mode = write_mode;
 
-    vsync_suspend_speed_eval();
     return s;
+}
 
-fail:
-    fclose(f);
-    return NULL;
+/* Read the rest of the header after the first module offset.  */
+static int snapshot_open_modules(snapshot_t *s, int packed)
+{
+    if (packed && snapshot_pack_read_index(s) < 0)
+        return -1;
+
+    s->first_module_offset = snapshot_stream_tell(s->file);
+
+    return 0;
+}
+
+snapshot_t *snapshot_create(const char *filename,
+                            BYTE major_version, BYTE minor_version,
+                            const char *snapshot_machine_name)
+{
+    FILE *f;
+    snapshot_t *s;
+
+    f = fopen(filename, MODE_WRITE);
+    if (f == NULL)
+        return NULL;
+
+#ifdef HAVE_ZLIB
+    /* A packed snapshot is built in memory first.  */
+    if (snapshot_compression > 0) {
+        s = snapshot_new(NULL, 1);
+        s->pack_file = f;
+        s->pack_level = snapshot_compression;
+    } else
+#endif
+        s = snapshot_new(f, 1);
+
+    if (snapshot_write_header(s->file, major_version, minor_version,
+                              snapshot_machine_name) < 0) {
+        fclose(f);
+        lib_free(s->stream.data);
+        lib_free(s);
+        ioutil_remove(filename);
+        return NULL;
+    }
+
+    s->first_module_offset = snapshot_stream_tell(s->file);
+
+    return s;
+}
+
+snapshot_t *snapshot_open(const char *filename,
+                          BYTE *major_version_return,
+                          BYTE *minor_version_return,
+                          const char *snapshot_machine_name)
+{
+    FILE *f;
+    snapshot_t *s;
+    int packed;
+
+    f = zfile_fopen(filename, MODE_READ);
+    if (f == NULL)
+        return NULL;
+
+    s = snapshot_new(f, 0);
+
+    if (snapshot_read_header(s->file, &packed, major_version_return,
+                             minor_version_return,
+                             snapshot_machine_name) < 0
+        || snapshot_open_modules(s, packed) < 0) {
+        snapshot_close(s);
+        return NULL;
+    }
+
+    vsync_suspend_speed_eval();
+    return s;
 }
 
 int snapshot_close(snapshot_t *s)
 {
-    int retval;
+    int retval = 0;
 
-    if (!s->write_mode) {
-        if (zfile_fclose(s->file) == EOF)
+    if (s->pack_file != NULL) {
+        if (snapshot_pack_write(s) < 0)
+            retval = -1;
+        if (fclose(s->pack_file) == EOF)
+            retval = -1;
+        lib_free(s->stream.data);
+    } else if (s->stream.file == NULL) {
+        if (s->write_mode)
+            lib_free(s->stream.data);
+    } else if (!s->write_mode) {
+        if (zfile_fclose(s->stream.file) == EOF)
             retval = -1;
-        else
-            retval = 0;
     } else {
-        if (fclose(s->file) == EOF)
+        if (fclose(s->stream.file) == EOF)
             retval = -1;
-        else
-            retval = 0;
     }
 
+    lib_free(s->index);
     lib_free(s);
     return retval;
 }
 
+/* ------------------------------------------------------------------------- */
+
+/* Memory snapshots use the same layout as snapshot files, but are written
+   to a growing buffer instead.  They are meant for frequent saving and
+   restoring, e.g. for rewinding, and do not suspend the speed
+   evaluation.  */
+
+snapshot_t *snapshot_memory_create(BYTE major_version, BYTE minor_version,
+                                   const char *snapshot_machine_name)
+{
+    snapshot_t *s;
+
+    s = snapshot_new(NULL, 1);
+
+    if (snapshot_write_header(s->file, major_version, minor_version,
+                              snapshot_machine_name) < 0) {
+        snapshot_close(s);
+        return NULL;
+    }
+
+    s->first_module_offset = snapshot_stream_tell(s->file);
+
+    return s;
+}
+
+snapshot_t *snapshot_memory_open(const BYTE *data, size_t size,
+                                 BYTE *major_version_return,
+                                 BYTE *minor_version_return,
+                                 const char *snapshot_machine_name)
+{
+    snapshot_t *s;
+    int packed;
+
+    s = snapshot_new(NULL, 0);
+
+    /* The buffer is only read and stays owned by the caller.  */
+    s->stream.data = (BYTE *)data;
+    s->stream.alloc = size;
+    s->stream.size = size;
+
+    if (snapshot_read_header(s->file, &packed, major_version_return,
+                             minor_version_return,
+                             snapshot_machine_name) < 0
+        || snapshot_open_modules(s, packed) < 0) {
+        snapshot_close(s);
+        return NULL;
+    }
+
+    return s;
+}
+
+/* Take the buffer of a memory snapshot that has been written.  The caller
+   must free it with lib_free(); the snapshot must still be closed.  */
+BYTE *snapshot_memory_release(snapshot_t *s, size_t *size_return)
+{
+    BYTE *data;
+
+    if (s->stream.file != NULL || !s->write_mode)
+        return NULL;
+
+    data = s->stream.data;
+    *size_return = s->stream.size;
+
+    s->stream.data = NULL;
+    s->stream.alloc = s->stream.size = s->stream.pos = 0;
+
+    return data;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static int set_snapshot_compression(int val, void *param)
+{
+    if (val < 0 || val > 9)
+        return -1;
+
+#ifndef HAVE_ZLIB
+    if (val > 0)
+        return -1;
+#endif
+
+    snapshot_compression = val;
+
+    return 0;
+}
+
+static const resource_int_t resources_int[] = {
+    { "SnapshotCompression", 0, RES_EVENT_NO, NULL,
+      &snapshot_compression, set_snapshot_compression, NULL },
+    { NULL }
+};
+
+int snapshot_resources_init(void)
+{
+    return resources_register_int(resources_int);
+}
+
+static const cmdline_option_t cmdline_options[] = {
+    { "-snapshotcompression", SET_RESOURCE, 1,
+      NULL, NULL, "SnapshotCompression", NULL,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      T_("<level>"), T_("Compress snapshot files with the given zlib level (0: plain snapshots)") },
+    { NULL }
+};
+
+int snapshot_cmdline_options_init(void)
+{
+    return cmdline_register_options(cmdline_options);
+}
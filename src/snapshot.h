@@ -27,6 +27,8 @@
 #ifndef SNAPSHOT_H
 #define SNAPSHOT_H
 
+#include <stddef.h>
+
 #include "types.h"
 
 #define SNAPSHOT_MACHINE_NAME_LEN       16
@@ -111,4 +113,16 @@ extern snapshot_t *snapshot_open(const char *filename,
                                  const char *snapshot_machine_name);
 extern int snapshot_close(snapshot_t *s);
 
+extern snapshot_t *snapshot_memory_create(BYTE major_version,
+                                          BYTE minor_version,
+                                          const char *snapshot_machine_name);
+extern snapshot_t *snapshot_memory_open(const BYTE *data, size_t size,
+                                        BYTE *major_version_return,
+                                        BYTE *minor_version_return,
+                                        const char *snapshot_machine_name);
+extern BYTE *snapshot_memory_release(snapshot_t *s, size_t *size_return);
+
+extern int snapshot_resources_init(void);
+extern int snapshot_cmdline_options_init(void);
+
 #endif
@@ -29,6 +29,8 @@
 
 #include "vice.h"
 
+#include <pthread.h>
+#include <sched.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -46,6 +48,7 @@
 #include "lib.h"
 #include "machine.h"
 #include "maincpu.h"
+#include "perfcount.h"
 #include "resources.h"
 #include "sound.h"
 #include "translate.h"
@@ -72,6 +75,7 @@ static int suspend_time;              /* app_resources.soundSuspendTime */
 static int speed_adjustment_setting;  /* app_resources.soundSpeedAdjustment */
 static int volume;
 static int fragment_size;
+static int sound_thread_enabled;      /* render on a worker thread */
 
 /* divisors for fragment size calculation */
 static int fragment_divisor[] = {
@@ -168,6 +172,17 @@ static int set_speed_adjustment_setting(int val, void *param)
     return 0;
 }
 
+static void sound_thread_shutdown(void);
+
+static int set_sound_thread(int val, void *param)
+{
+    if (!val)
+        sound_thread_shutdown();
+
+    sound_thread_enabled = val ? 1 : 0;
+    return 0;
+}
+
 static int set_volume(int val, void *param)
 {
     volume = val;
@@ -210,6 +225,8 @@ static const resource_int_t resources_int[] = {
       (void *)&speed_adjustment_setting, set_speed_adjustment_setting, NULL },
     { "SoundVolume", 100, RES_EVENT_NO, NULL,
       (void *)&volume, set_volume, NULL },
+    { "SoundThread", 0, RES_EVENT_NO, NULL,
+      (void *)&sound_thread_enabled, set_sound_thread, NULL },
     { NULL }
 };
 
@@ -223,6 +240,8 @@ int sound_resources_init(void)
 
 void sound_resources_shutdown(void)
 {
+    sound_thread_shutdown();
+
     lib_free(device_name);
     lib_free(device_arg);
     lib_free(recorddevice_name);
@@ -282,6 +301,16 @@ static const cmdline_option_t cmdline_options[] = {
       USE_PARAM_ID, USE_DESCRIPTION_ID,
       IDCLS_P_SYNC, IDCLS_SET_SOUND_SPEED_ADJUST,
       NULL, NULL },
+    { "-soundthread", SET_RESOURCE, 0,
+      NULL, NULL, "SoundThread", (resource_value_t)1,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      NULL, T_("Render sound on a separate thread") },
+    { "+soundthread", SET_RESOURCE, 0,
+      NULL, NULL, "SoundThread", (resource_value_t)0,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      NULL, T_("Render sound on the emulation thread") },
     { NULL }
 };
 
@@ -361,6 +390,78 @@ typedef struct
 
 static snddata_t snddata;
 
+/* Threaded rendering.  When enabled, SID writes are queued together with
+   the main CPU clock they happened at, and a worker thread runs the sound
+   engine up to each write in order and writes the samples to the device
+   at the end of every frame.  SID reads are queued as well; the worker
+   answers them as soon as it has caught up with the read's clock and
+   holds back the device writes of the frames in between until then.
+   Everything else that touches `snddata' on the emulation thread calls
+   sound_thread_sync() first, which waits until the worker has emptied the
+   queue.  */
+
+#define SOUND_QUEUE_SIZE 0x4000
+#define SOUND_QUEUE_MASK (SOUND_QUEUE_SIZE - 1)
+
+/* `chipno' of a queue entry that marks the end of a frame.  */
+#define SOUND_EVENT_FLUSH 0xff
+
+/* Flag in `chipno' of a queue entry for a register read.  */
+#define SOUND_EVENT_READ 0x80
+
+/* Number of frames the worker may lag behind the emulation.  */
+#define SOUND_THREAD_MAX_FRAMES 2
+
+/* Number of busy-wait rounds before the worker blocks on its condition.  */
+#define SOUND_THREAD_SPIN_ROUNDS 1000
+
+typedef struct sound_event_s {
+    CLOCK clk;
+    WORD addr;
+    BYTE val;
+    BYTE chipno;
+} sound_event_t;
+
+static sound_event_t sound_queue[SOUND_QUEUE_SIZE];
+
+/* `head' is only written by the emulation thread, `tail' and
+   `frames_done' only by the worker.  */
+static volatile unsigned int sound_queue_head;
+static volatile unsigned int sound_queue_tail;
+static volatile unsigned int sound_frames_queued;
+static volatile unsigned int sound_frames_done;
+
+static pthread_t sound_thread;
+static pthread_mutex_t sound_thread_mutex;
+static pthread_cond_t sound_thread_cond;
+static volatile int sound_thread_sleeping;
+static volatile int sound_thread_running;
+static int sound_thread_started = 0;
+
+/* Flag: Do SID writes go through the queue?  */
+static int sound_thread_active = 0;
+
+/* Flag: Has the worker hit a device error?  Handled by sound_flush().  */
+static volatile int sound_thread_failed = 0;
+
+/* Handshake of a queued SID read.  */
+static volatile int sound_thread_read_waiting = 0;
+static volatile int sound_thread_read_done;
+static volatile int sound_thread_read_result;
+
+/* Flag: Did the worker skip a device write while a read was waiting?
+   Only used by the worker.  */
+static int sound_thread_write_pending = 0;
+
+#define sound_thread_barrier() __sync_synchronize()
+
+static void sound_thread_sync(void);
+
+static int sound_thread_is_worker(void)
+{
+    return sound_thread_started && pthread_equal(pthread_self(), sound_thread);
+}
+
 /* device registration code */
 static sound_device_t *sound_devices[32];
 
@@ -433,6 +534,13 @@ static void enablesound(void)
 /* close sid device and show error dialog */
 static int sound_error(const char *msg)
 {
+	/* Leave closing the device to the emulation thread.  */
+	if (sound_thread_is_worker())
+	{
+		sound_thread_failed = 1;
+		return 1;
+	}
+
 	sound_close();
 
 #if 0
@@ -552,6 +660,8 @@ static void sid_close(void)
 
 sound_t *sound_get_psid(unsigned int channel)
 {
+	sound_thread_sync();
+
 	return snddata.psid[channel];
 }
 
@@ -741,6 +851,8 @@ int sound_open(void)
 /* close sid */
 void sound_close(void)
 {
+	sound_thread_sync();
+
 	if (snddata.playdev)
 	{
 		#ifdef CELL_DEBUG
@@ -775,8 +887,8 @@ void sound_close(void)
 	vsync_suspend_speed_eval();
 }
 
-/* run sid */
-static int sound_run_sound(void)
+/* run sid up to `clk' */
+static int sound_run_sound_until(CLOCK clk)
 {
 	int nr = 0, c, i;
 	int delta_t = 0;
@@ -798,9 +910,11 @@ static int sound_run_sound(void)
 	{
 		for (c = 0; c < snddata.channels; c++)
 		{
-			delta_t = maincpu_clk - snddata.lastclk;
+			delta_t = clk - snddata.lastclk;
 			bufferptr = snddata.buffer + snddata.bufptr * snddata.channels + c;
+			PERFCOUNT_ENTER(PERFCOUNT_SID);
 			nr = sound_machine_calculate_samples(snddata.psid[c], bufferptr, SOUND_BUFSIZE - snddata.bufptr, snddata.channels, &delta_t);
+			PERFCOUNT_LEAVE(PERFCOUNT_SID);
 
 			#if 0
 			if (volume < 100)
@@ -814,7 +928,7 @@ static int sound_run_sound(void)
 	else
 	{
 		/* Handling of sample based sound engines. */
-		nr = (int)((SOUNDCLK_CONSTANT(maincpu_clk) - snddata.fclk) / snddata.clkstep);
+		nr = (int)((SOUNDCLK_CONSTANT(clk) - snddata.fclk) / snddata.clkstep);
 
 		if (!nr)
 			return 0;
@@ -825,7 +939,9 @@ static int sound_run_sound(void)
 		for (c = 0; c < snddata.channels; c++)
 		{
 			bufferptr = snddata.buffer + snddata.bufptr * snddata.channels + c;
+			PERFCOUNT_ENTER(PERFCOUNT_SID);
 			sound_machine_calculate_samples(snddata.psid[c], bufferptr, nr, snddata.channels, &delta_t);
+			PERFCOUNT_LEAVE(PERFCOUNT_SID);
 
 			#if 0
 			if (volume < 100)
@@ -839,16 +955,26 @@ static int sound_run_sound(void)
 	}
 
 	snddata.bufptr += nr;
-	snddata.lastclk = maincpu_clk;
+	snddata.lastclk = clk;
 
 	return 0;
 }
 
+/* run sid up to the current main CPU clock */
+static int sound_run_sound(void)
+{
+	sound_thread_sync();
+
+	return sound_run_sound_until(maincpu_clk);
+}
+
 /* reset sid */
 void sound_reset(void)
 {
 	int c;
 
+	sound_thread_sync();
+
 	snddata.fclk = SOUNDCLK_CONSTANT(maincpu_clk);
 	snddata.wclk = maincpu_clk;
 	snddata.lastclk = maincpu_clk;
@@ -864,6 +990,9 @@ static void prevent_clk_overflow_callback(CLOCK sub, void *data)
 {
 	int c;
 
+	/* Queued writes still carry the old clock values.  */
+	sound_thread_sync();
+
 	snddata.lastclk -= sub;
 	snddata.fclk -= SOUNDCLK_CONSTANT(sub);
 	snddata.wclk -= sub;
@@ -874,44 +1003,11 @@ static void prevent_clk_overflow_callback(CLOCK sub, void *data)
 	}
 }
 
-double sound_flush()
+/* write the whole fragments of the sample buffer to the device */
+static double sound_write_samples(void)
 {
 	int c, i, nr, space = 0, used;
 
-	if (!playback_enabled)
-	{
-		if (sdev_open)
-			sound_close();
-		return 0;
-	}
-
-	if (sound_state_changed)
-	{
-		if (sdev_open)
-			sound_close();
-		sound_state_changed = 0;
-	}
-
-	if (suspend_time > 0)
-		enablesound();
-	if (sound_run_sound())
-		return 0;
-
-	if (sid_state_changed)
-	{
-		if (sid_init() != 0)
-			return 0;
-
-		sid_state_changed = 0;
-	}
-
-	if (warp_mode_enabled && snddata.recdev == NULL)
-	{
-		snddata.bufptr = 0;
-		return 0;
-	}
-	sound_resume();
-
 	#if 0
 	if (snddata.playdev->flush)
 	{
@@ -1062,9 +1158,292 @@ double sound_flush()
 	return 0;
 }
 
+/* ------------------------------------------------------------------------- */
+
+static void sound_thread_process_read(const sound_event_t *ev)
+{
+	int chipno = ev->chipno & ~SOUND_EVENT_READ;
+	int val = -1;
+
+	if (!sound_thread_failed && snddata.playdev
+		&& !sound_run_sound_until(ev->clk) && chipno < snddata.channels)
+		val = sound_machine_read(snddata.psid[chipno], ev->addr);
+
+	/* Answer the read before writing out the frames held back for it.  */
+	sound_thread_read_result = val;
+	sound_thread_read_waiting = 0;
+	sound_thread_barrier();
+	sound_thread_read_done = 1;
+
+	if (sound_thread_write_pending && !sound_thread_failed && snddata.playdev)
+	{
+		sound_resume();
+		sound_write_samples();
+	}
+	sound_thread_write_pending = 0;
+}
+
+static void sound_thread_process(const sound_event_t *ev)
+{
+	if (ev->chipno != SOUND_EVENT_FLUSH && (ev->chipno & SOUND_EVENT_READ))
+	{
+		sound_thread_process_read(ev);
+		return;
+	}
+
+	/* Drop everything queued after a device error or a close.  */
+	if (sound_thread_failed || !snddata.playdev)
+		return;
+
+	if (sound_run_sound_until(ev->clk))
+		return;
+
+	if (ev->chipno == SOUND_EVENT_FLUSH)
+	{
+		/* The samples stay in the buffer; the next write sends them.  */
+		if (sound_thread_read_waiting)
+		{
+			sound_thread_write_pending = 1;
+			return;
+		}
+		sound_resume();
+		sound_write_samples();
+	}
+	else if (ev->chipno < snddata.channels)
+	{
+		sound_machine_store(snddata.psid[ev->chipno], ev->addr, ev->val);
+	}
+}
+
+static void *sound_thread_main(void *data)
+{
+	unsigned int rounds = 0;
+	const sound_event_t *ev;
+
+	while (1)
+	{
+		if (sound_queue_tail == sound_queue_head)
+		{
+			if (!sound_thread_running)
+				break;
+
+			if (++rounds < SOUND_THREAD_SPIN_ROUNDS)
+			{
+				sched_yield();
+				continue;
+			}
+
+			pthread_mutex_lock(&sound_thread_mutex);
+			sound_thread_sleeping = 1;
+			sound_thread_barrier();
+			while (sound_queue_tail == sound_queue_head && sound_thread_running)
+				pthread_cond_wait(&sound_thread_cond, &sound_thread_mutex);
+			sound_thread_sleeping = 0;
+			pthread_mutex_unlock(&sound_thread_mutex);
+			continue;
+		}
+
+		rounds = 0;
+		sound_thread_barrier();
+
+		ev = &sound_queue[sound_queue_tail & SOUND_QUEUE_MASK];
+		sound_thread_process(ev);
+		if (ev->chipno == SOUND_EVENT_FLUSH)
+			sound_frames_done++;
+
+		sound_thread_barrier();
+		sound_queue_tail++;
+	}
+
+	return NULL;
+}
+
+static int sound_thread_start(void)
+{
+	sound_queue_head = sound_queue_tail = 0;
+	sound_frames_queued = sound_frames_done = 0;
+	sound_thread_sleeping = 0;
+	sound_thread_running = 1;
+	sound_thread_failed = 0;
+	pthread_mutex_init(&sound_thread_mutex, NULL);
+	pthread_cond_init(&sound_thread_cond, NULL);
+
+	if (pthread_create(&sound_thread, NULL, sound_thread_main, NULL) != 0)
+	{
+		sound_thread_running = 0;
+		pthread_cond_destroy(&sound_thread_cond);
+		pthread_mutex_destroy(&sound_thread_mutex);
+		return -1;
+	}
+
+	sound_thread_started = 1;
+
+	return 0;
+}
+
+static void sound_thread_shutdown(void)
+{
+	if (!sound_thread_started)
+		return;
+
+	sound_thread_sync();
+	sound_thread_active = 0;
+
+	sound_thread_running = 0;
+	sound_thread_barrier();
+	pthread_mutex_lock(&sound_thread_mutex);
+	pthread_cond_signal(&sound_thread_cond);
+	pthread_mutex_unlock(&sound_thread_mutex);
+
+	pthread_join(sound_thread, NULL);
+	pthread_cond_destroy(&sound_thread_cond);
+	pthread_mutex_destroy(&sound_thread_mutex);
+
+	sound_thread_started = 0;
+}
+
+/* wait until the worker has processed everything queued so far */
+static void sound_thread_sync(void)
+{
+	if (!sound_thread_started || sound_thread_is_worker())
+		return;
+
+	while (sound_queue_tail != sound_queue_head)
+		sched_yield();
+
+	sound_thread_barrier();
+}
+
+static void sound_queue_push(CLOCK clk, WORD addr, BYTE val, BYTE chipno)
+{
+	sound_event_t *ev;
+
+	while (sound_queue_head - sound_queue_tail >= SOUND_QUEUE_SIZE)
+		sched_yield();
+
+	ev = &sound_queue[sound_queue_head & SOUND_QUEUE_MASK];
+	ev->clk = clk;
+	ev->addr = addr;
+	ev->val = val;
+	ev->chipno = chipno;
+
+	sound_thread_barrier();
+	sound_queue_head++;
+	sound_thread_barrier();
+
+	if (sound_thread_sleeping)
+	{
+		pthread_mutex_lock(&sound_thread_mutex);
+		pthread_cond_signal(&sound_thread_cond);
+		pthread_mutex_unlock(&sound_thread_mutex);
+	}
+}
+
+/* Let the worker answer a SID read once it has caught up with the current
+   clock.  Unlike sound_thread_sync(), this does not wait for the device
+   writes of the frames still queued.  */
+static int sound_thread_read(WORD addr, int chipno)
+{
+	sound_thread_read_done = 0;
+	sound_thread_read_waiting = 1;
+	sound_queue_push(maincpu_clk, addr, 0, (BYTE)(SOUND_EVENT_READ | chipno));
+
+	while (!sound_thread_read_done)
+		sched_yield();
+
+	sound_thread_barrier();
+
+	return sound_thread_read_result;
+}
+
+/* Hand the frame to the worker if nothing needs the emulation thread to
+   reopen or reinitialize the device.  Return 0 on success.  */
+static int sound_thread_flush(void)
+{
+	if (!sound_thread_enabled || !playback_enabled || !sdev_open
+		|| sound_state_changed || sid_state_changed || warp_mode_enabled
+		|| (suspend_time > 0 && disabletime))
+		return -1;
+
+	if (!sound_thread_started && sound_thread_start() < 0)
+	{
+		sound_thread_enabled = 0;
+		return -1;
+	}
+
+	sound_thread_active = 1;
+
+	sound_frames_queued++;
+	sound_queue_push(maincpu_clk, 0, 0, SOUND_EVENT_FLUSH);
+
+	/* Keep the audio latency bounded.  */
+	while (sound_frames_queued - sound_frames_done > SOUND_THREAD_MAX_FRAMES)
+		sched_yield();
+
+	return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+
+double sound_flush()
+{
+	if (sound_thread_failed)
+	{
+		sound_thread_sync();
+		sound_thread_failed = 0;
+		sound_error(translate_text(IDGS_WRITE_TO_SOUND_DEVICE_FAILED));
+	}
+
+	/* The worker does not report the device delay; vsync falls back to
+	   its own timer.  */
+	if (sound_thread_flush() == 0)
+		return 0;
+
+	sound_thread_sync();
+	sound_thread_active = 0;
+
+	if (!playback_enabled)
+	{
+		if (sdev_open)
+			sound_close();
+		return 0;
+	}
+
+	if (sound_state_changed)
+	{
+		if (sdev_open)
+			sound_close();
+		sound_state_changed = 0;
+	}
+
+	if (suspend_time > 0)
+		enablesound();
+	if (sound_run_sound())
+		return 0;
+
+	if (sid_state_changed)
+	{
+		if (sid_init() != 0)
+			return 0;
+
+		sid_state_changed = 0;
+	}
+
+	if (warp_mode_enabled && snddata.recdev == NULL)
+	{
+		snddata.bufptr = 0;
+		return 0;
+	}
+	sound_resume();
+
+	return sound_write_samples();
+}
+
 /* suspend sid (eg. before pause) */
 void sound_suspend(void)
 {
+	sound_thread_sync();
+
 	if (!snddata.playdev)
 		return;
 
@@ -1083,6 +1462,8 @@ void sound_suspend(void)
 /* resume sid */
 void sound_resume(void)
 {
+	sound_thread_sync();
+
 	if (!snddata.playdev)
 		return;
 
@@ -1101,6 +1482,8 @@ void sound_resume(void)
 /* set PAL/NTSC clock speed */
 void sound_set_machine_parameter(long clock_rate, long ticks_per_frame)
 {
+	sound_thread_sync();
+
 	sid_state_changed = 1;
 
 	cycles_per_sec  = clock_rate;
@@ -1153,6 +1536,10 @@ long sound_sample_position(void)
 
 int sound_read(WORD addr, int chipno)
 {
+	/* With an empty queue the engine can be read right here.  */
+	if (sound_thread_active && sound_queue_tail != sound_queue_head)
+		return sound_thread_read(addr, chipno);
+
 	if (sound_run_sound() || chipno >= snddata.channels)
 		return -1;
 
@@ -1163,6 +1550,12 @@ void sound_store(WORD addr, BYTE val, int chipno)
 {
 	int i;
 
+	if (sound_thread_active)
+	{
+		sound_queue_push(maincpu_clk, addr, val, (BYTE)chipno);
+		return;
+	}
+
 	if (sound_run_sound() || chipno >= snddata.channels)
 		return;
 
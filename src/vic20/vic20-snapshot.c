@@ -57,17 +57,11 @@
 #define SNAP_MINOR          0
 
 
-int vic20_snapshot_write(const char *name, int save_roms, int save_disks,
-                         int event_mode)
+static int vic20_snapshot_write_snapshot(snapshot_t *s, int save_roms,
+                                         int save_disks, int event_mode)
 {
-    snapshot_t *s;
     int ieee488;
 
-    s = snapshot_create(name, ((BYTE)(SNAP_MAJOR)), ((BYTE)(SNAP_MINOR)),
-                        machine_name);
-    if (s == NULL)
-        return -1;
-
     sound_snapshot_prepare();
 
     /* FIXME: Missing sound.  */
@@ -81,8 +75,6 @@ int vic20_snapshot_write(const char *name, int save_roms, int save_disks,
         || tape_snapshot_write_module(s, save_disks) < 0
         || keyboard_snapshot_write_module(s)
         || joystick_snapshot_write_module(s)) {
-        snapshot_close(s);
-        ioutil_remove(name);
         return -1;
     }
 
@@ -91,25 +83,56 @@ int vic20_snapshot_write(const char *name, int save_roms, int save_disks,
         if (viacore_snapshot_write_module(machine_context.ieeevia1, s) < 0
             || viacore_snapshot_write_module(machine_context.ieeevia2,
             s) < 0) {
-            snapshot_close(s);
-            ioutil_remove(name);
             return 1;
         }
     }
 
-    snapshot_close(s);
     return 0;
 }
 
-int vic20_snapshot_read(const char *name, int event_mode)
+int vic20_snapshot_write(const char *name, int save_roms, int save_disks,
+                         int event_mode)
 {
     snapshot_t *s;
-    BYTE minor, major;
+    int retval;
 
-    s = snapshot_open(name, &major, &minor, machine_name);
+    s = snapshot_create(name, ((BYTE)(SNAP_MAJOR)), ((BYTE)(SNAP_MINOR)),
+                        machine_name);
+    if (s == NULL)
+        return -1;
+
+    retval = vic20_snapshot_write_snapshot(s, save_roms, save_disks, event_mode);
+    snapshot_close(s);
+
+    if (retval != 0)
+        ioutil_remove(name);
+
+    return retval;
+}
+
+int vic20_snapshot_write_memory(BYTE **data, size_t *size, int save_roms,
+                                int save_disks, int event_mode)
+{
+    snapshot_t *s;
+
+    s = snapshot_memory_create(((BYTE)(SNAP_MAJOR)), ((BYTE)(SNAP_MINOR)),
+                               machine_name);
     if (s == NULL)
         return -1;
 
+    if (vic20_snapshot_write_snapshot(s, save_roms, save_disks, event_mode) != 0) {
+        snapshot_close(s);
+        return -1;
+    }
+
+    *data = snapshot_memory_release(s, size);
+    snapshot_close(s);
+    return 0;
+}
+
+static int vic20_snapshot_read_snapshot(snapshot_t *s, BYTE major, BYTE minor,
+                                        int event_mode)
+{
     if (major != SNAP_MAJOR || minor != SNAP_MINOR) {
         log_error(LOG_DEFAULT,
                   "Snapshot version (%d.%d) not valid: expecting %d.%d.",
@@ -153,4 +176,28 @@ fail:
     return -1;
 }
 
+int vic20_snapshot_read(const char *name, int event_mode)
+{
+    snapshot_t *s;
+    BYTE minor, major;
+
+    s = snapshot_open(name, &major, &minor, machine_name);
+    if (s == NULL)
+        return -1;
+
+    return vic20_snapshot_read_snapshot(s, major, minor, event_mode);
+}
+
+int vic20_snapshot_read_memory(const BYTE *data, size_t size, int event_mode)
+{
+    snapshot_t *s;
+    BYTE minor, major;
+
+    s = snapshot_memory_open(data, size, &major, &minor, machine_name);
+    if (s == NULL)
+        return -1;
+
+    return vic20_snapshot_read_snapshot(s, major, minor, event_mode);
+}
+
 
@@ -80,6 +80,7 @@ extern void vicii_reset_registers(void);
 extern void vicii_update_memory_ptrs_external(void);
 extern void vicii_handle_pending_alarms_external(int num_write_cycles);
 extern void vicii_handle_pending_alarms_external_write(void);
+extern CLOCK vicii_get_next_pending_clk(void);
 
 extern void vicii_screenshot(struct screenshot_s *screenshot);
 extern void vicii_shutdown(void);
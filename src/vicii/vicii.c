@@ -269,6 +269,17 @@ void vicii_handle_pending_alarms_external_write(void)
         vicii_handle_pending_alarms(maincpu_rmw_flag + 1);
 }
 
+/* Return the clock of the next event `vicii_handle_pending_alarms()' would
+   serve, so that DMA can skip calling it before that.  */
+CLOCK vicii_get_next_pending_clk(void)
+{
+    if (!vicii.initialized)
+        return 0;
+
+    return (vicii.fetch_clk < vicii.draw_clk) ? vicii.fetch_clk
+                                              : vicii.draw_clk;
+}
+
 /* return pixel aspect ratio for current video mode */
 /* FIXME: calculate proper values.
    look at http://www.codebase64.org/doku.php?id=base:pixel_aspect_ratio&s[]=aspect
@@ -157,6 +157,16 @@ static const cmdline_option_t cmdline_options[] =
       USE_PARAM_STRING, USE_DESCRIPTION_ID,
       IDCLS_UNUSED, IDCLS_USE_OLD_LUMINANCES,
       NULL, NULL },
+    { "-VICIIvector", SET_RESOURCE, 0,
+      NULL, NULL, "VICIIVectorDraw", (void *)1,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      NULL, T_("Resolve VIC-II pixel colors with vector lookups") },
+    { "+VICIIvector", SET_RESOURCE, 0,
+      NULL, NULL, "VICIIVectorDraw", (void *)0,
+      USE_PARAM_STRING, USE_DESCRIPTION_STRING,
+      IDCLS_UNUSED, IDCLS_UNUSED,
+      NULL, T_("Resolve VIC-II pixel colors one pixel at a time") },
     { "-saturation", SET_RESOURCE, 1,
       NULL, NULL, "ColorSaturation", NULL,
       USE_PARAM_STRING, USE_DESCRIPTION_ID,
@@ -32,11 +32,26 @@
 #include "snapshot.h"
 #include "vicii-chip-model.h"
 #include "vicii-draw-cycle.h"
+#include "vicii-resources.h"
 #include "viciitypes.h"
 
+#if defined(__ALTIVEC__)
+#include <altivec.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
 /* disable for debugging */
 #define DRAW_INLINE inline
 
+/* The AltiVec loads read the whole aligned 16 bytes around an address,
+   so the lookup tables are aligned and padded to keep them in bounds.  */
+#if defined(__ALTIVEC__)
+#define DRAW_TABLE_ALIGN __attribute__((aligned(16)))
+#else
+#define DRAW_TABLE_ALIGN
+#endif
+
 /* colors */
 #define COL_NONE     0x10
 #define COL_VBUF_L   0x11
@@ -111,13 +126,120 @@ static BYTE pri_buffer[8];
 
 static BYTE pixel_buffer[8];
 
-/* color resolution registers */
-static BYTE cregs[0x2f];
+/* color resolution registers (padded for lookup8_48()) */
+static BYTE cregs[0x40] DRAW_TABLE_ALIGN;
 static BYTE last_color_reg;
 static BYTE last_color_value;
 
 static unsigned int cycle_flags_pipe;
 
+/* vector path: per pixel index into a palette of up to 4 segments of
+   4 colors each, one segment per change of mode or latched colors */
+static BYTE gbuf_palette[32] DRAW_TABLE_ALIGN;
+static BYTE gbuf_index[8];
+static int gbuf_segment;
+
+
+/**************************************************************************
+ *
+ * SECTION  table lookups
+ *
+ * The vector path resolves the 8 pixels of a cycle with byte shuffles:
+ * vec_perm on AltiVec, pshufb on SSSE3.  Without either the same is
+ * done one byte at a time.
+ *   
+ ******/
+
+#if defined(__ALTIVEC__)
+
+typedef union {
+    vector unsigned char v;
+    BYTE b[16];
+} vec_bytes_t;
+
+static DRAW_INLINE vector unsigned char vec_load_unaligned(const BYTE *p)
+{
+    return vec_perm(vec_ld(0, p), vec_ld(15, p), vec_lvsl(0, p));
+}
+
+/* dst[i] = table[idx[i]] for 8 indices below 0x30 */
+static DRAW_INLINE void lookup8_48(BYTE *dst, const BYTE *table, const BYTE *idx)
+{
+    vec_bytes_t i, r;
+    vector unsigned char lo, hi;
+    vector unsigned char bit5 = vec_sl(vec_splat_u8(1), vec_splat_u8(5));
+
+    memcpy(i.b, idx, 8);
+    /* vec_perm uses the low 5 bits of the index, bit 5 selects the last 16 */
+    lo = vec_perm(vec_load_unaligned(table), vec_load_unaligned(table + 16), i.v);
+    hi = vec_load_unaligned(table + 32);
+    hi = vec_perm(hi, hi, i.v);
+    r.v = vec_sel(lo, hi, vec_cmpeq(vec_and(i.v, bit5), bit5));
+    memcpy(dst, r.b, 8);
+}
+
+/* dst[i] = table[idx[i]] and pri[i] = idx[i] & 2 for 8 indices below 16 */
+static DRAW_INLINE void lookup8_16(BYTE *dst, BYTE *pri, const BYTE *table, const BYTE *idx)
+{
+    vec_bytes_t i, r;
+    vector unsigned char t;
+
+    memcpy(i.b, idx, 8);
+    t = vec_load_unaligned(table);
+    r.v = vec_perm(t, t, i.v);
+    memcpy(dst, r.b, 8);
+    r.v = vec_and(i.v, vec_splat_u8(2));
+    memcpy(pri, r.b, 8);
+}
+
+#elif defined(__SSSE3__)
+
+static DRAW_INLINE void lookup8_48(BYTE *dst, const BYTE *table, const BYTE *idx)
+{
+    __m128i i = _mm_loadl_epi64((const __m128i *)idx);
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(i, 4), _mm_set1_epi8(0x0f));
+    __m128i m1 = _mm_cmpeq_epi8(hi, _mm_set1_epi8(1));
+    __m128i m2 = _mm_cmpeq_epi8(hi, _mm_set1_epi8(2));
+    __m128i r = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)table), i);
+
+    r = _mm_or_si128(_mm_andnot_si128(m1, r),
+                     _mm_and_si128(m1, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(table + 16)), i)));
+    r = _mm_or_si128(_mm_andnot_si128(m2, r),
+                     _mm_and_si128(m2, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(table + 32)), i)));
+    _mm_storel_epi64((__m128i *)dst, r);
+}
+
+static DRAW_INLINE void lookup8_16(BYTE *dst, BYTE *pri, const BYTE *table, const BYTE *idx)
+{
+    __m128i i = _mm_loadl_epi64((const __m128i *)idx);
+
+    _mm_storel_epi64((__m128i *)dst, _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)table), i));
+    _mm_storel_epi64((__m128i *)pri, _mm_and_si128(i, _mm_set1_epi8(2)));
+}
+
+#else
+
+static DRAW_INLINE void lookup8_48(BYTE *dst, const BYTE *table, const BYTE *idx)
+{
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        dst[i] = table[idx[i]];
+    }
+}
+
+static DRAW_INLINE void lookup8_16(BYTE *dst, BYTE *pri, const BYTE *table, const BYTE *idx)
+{
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        dst[i] = table[idx[i]];
+        pri[i] = idx[i] & 0x2;
+    }
+}
+
+#endif
+
 
 /**************************************************************************
  *
@@ -136,12 +258,9 @@ static const BYTE colors[] = {
     COL_NONE,   COL_NONE,   COL_NONE,   COL_NONE    /* ECM=1 BMM=1 MCM=1 */
 };
 
-static DRAW_INLINE void draw_graphics(int i)
+static DRAW_INLINE BYTE get_graphics_pixel(int i)
 {
     BYTE px;
-    BYTE cc;
-    BYTE pixel_pri;
-    BYTE vmode;
 
     /* Load new gbuf/vbuf/cbuf values at offset == xscroll */
     if (i == xscroll_pipe) {
@@ -186,12 +305,18 @@ static DRAW_INLINE void draw_graphics(int i)
     gbuf_reg <<= 1;
     gbuf_mc_flop ^= 1;
 
-    /* Determine pixel color and priority */
+    return px;
+}
+
+static DRAW_INLINE BYTE get_graphics_color(BYTE px)
+{
+    BYTE cc;
+    BYTE vmode;
+
     vmode = vmode11_pipe | vmode16_pipe;
-    pixel_pri = (px & 0x2);
     cc = colors[vmode | px];
 
-    /* lookup colors and render pixel */
+    /* lookup colors */
     switch (cc) {
     case COL_NONE:
         cc = 0;
@@ -215,11 +340,47 @@ static DRAW_INLINE void draw_graphics(int i)
         break;
     }
 
-    render_buffer[i] = cc;
-    pri_buffer[i] = pixel_pri;
+    return cc;
+}
+
+static DRAW_INLINE void draw_graphics(int i)
+{
+    BYTE px;
+
+    px = get_graphics_pixel(i);
+
+    /* Determine pixel color and priority, and render pixel */
+    render_buffer[i] = get_graphics_color(px);
+    pri_buffer[i] = px & 0x2;
+}
+
+static DRAW_INLINE void draw_graphics_vector(int i)
+{
+    BYTE px;
+    int c;
+
+    px = get_graphics_pixel(i);
+
+    /* the colors only change at the xscroll latch and pixels 4 and 6 */
+    if (i == 0 || i == xscroll_pipe || i == 4 || i == 6) {
+        gbuf_segment = (i == 0) ? 0 : gbuf_segment + 4;
+        for (c = 0; c < 4; c++) {
+            gbuf_palette[gbuf_segment + c] = get_graphics_color((BYTE)c);
+        }
+    }
+    gbuf_index[i] = (BYTE)(gbuf_segment + px);
+}
+
+static DRAW_INLINE void draw_graphics_pixel(int i, int vector)
+{
+    if (vector) {
+        draw_graphics_vector(i);
+    } else {
+        draw_graphics(i);
+    }
 }
 
-static DRAW_INLINE void draw_graphics8(unsigned int cycle_flags)
+static DRAW_INLINE void draw_graphics8(unsigned int cycle_flags, int vector)
 {
     int vis_en;
 
@@ -227,34 +388,38 @@ static DRAW_INLINE void draw_graphics8(unsigned int cycle_flags)
 
     /* render pixels */
     /* pixel 0 */
-    draw_graphics(0);
+    draw_graphics_pixel(0, vector);
     /* pixel 1 */
-    draw_graphics(1);
+    draw_graphics_pixel(1, vector);
     /* pixel 2 */
-    draw_graphics(2);
+    draw_graphics_pixel(2, vector);
     /* pixel 3 */
-    draw_graphics(3);
+    draw_graphics_pixel(3, vector);
     /* pixel 4 */
     vmode16_pipe = ( vicii.regs[0x16] & 0x10 ) >> 2;
     if (vicii.color_latency) {
         /* handle rising edge of internal signal */
         vmode11_pipe |= ( vicii.regs[0x11] & 0x60 ) >> 2;
     }
-    draw_graphics(4);
+    draw_graphics_pixel(4, vector);
     /* pixel 5 */
-    draw_graphics(5);
+    draw_graphics_pixel(5, vector);
     /* pixel 6 */
     if (vicii.color_latency) {
         /* handle falling edge of internal signal */
         vmode11_pipe &= ( vicii.regs[0x11] & 0x60 ) >> 2;
     }
-    draw_graphics(6);
+    draw_graphics_pixel(6, vector);
     /* pixel 7 */
     if ( vmode16_pipe && !vmode16_pipe2 ) {
         gbuf_mc_flop = 0;
     }
     vmode16_pipe2 = vmode16_pipe;
-    draw_graphics(7);
+    draw_graphics_pixel(7, vector);
+
+    if (vector) {
+        lookup8_16(render_buffer, pri_buffer, gbuf_palette, gbuf_index);
+    }
 
     if (!vicii.color_latency) {
         vmode11_pipe = ( vicii.regs[0x11] & 0x60 ) >> 2;
@@ -625,7 +790,7 @@ static DRAW_INLINE void draw_colors_8565(int offs, int i)
     pixel_buffer[i] = render_buffer[i];
 }
 
-static DRAW_INLINE void draw_colors8(void)
+static DRAW_INLINE void draw_colors8(int vector)
 {
     int offs = vicii.dbuf_offset;
 
@@ -634,12 +799,25 @@ static DRAW_INLINE void draw_colors8(void)
         return;
 
     /* update color register (if written) */
-    if (last_color_reg) {
+    if (last_color_reg != 0xff) {
         cregs[last_color_reg] = last_color_value;
     }
 
     /* render pixels */
-    if (vicii.color_latency) {
+    if (vector) {
+        lookup8_48(vicii.dbuf + offs, cregs, pixel_buffer);
+        if (vicii.color_latency) {
+            /* pixel 0 was resolved at the end of the last cycle */
+            vicii.dbuf[offs] = pixel_buffer[0];
+        } else if (pixel_buffer[0] == last_color_reg) {
+            /* special case for grey dot handling */
+            vicii.dbuf[offs] = 0x0f;
+        }
+        memcpy(pixel_buffer, render_buffer, 8);
+        if (vicii.color_latency) {
+            pixel_buffer[0] = cregs[pixel_buffer[0]];
+        }
+    } else if (vicii.color_latency) {
         draw_colors_6569(offs, 0);
         draw_colors_6569(offs, 1);
         draw_colors_6569(offs, 2);
@@ -672,18 +850,25 @@ static DRAW_INLINE void draw_colors8(void)
 
 void vicii_draw_cycle(void)
 {
+    /* the draw path is chosen once per cycle, never per pixel */
+    int vector = vicii_resources.vector_draw;
+
     /* reset rendering on raster cycle 1 */
     if (vicii.raster_cycle == 1) {
         vicii.dbuf_offset = 0;
     }
 
-    draw_graphics8(cycle_flags_pipe);
+    if (vector) {
+        draw_graphics8(cycle_flags_pipe, 1);
+    } else {
+        draw_graphics8(cycle_flags_pipe, 0);
+    }
 
     draw_sprites8(cycle_flags_pipe);
 
     draw_border8();
 
-    draw_colors8();
+    draw_colors8(vector);
 
     cycle_flags_pipe = vicii.cycle_flags;
 }
@@ -80,6 +80,12 @@ static int set_new_luminances(int val, void *param)
     return vicii_color_update_palette(vicii.raster.canvas);
 }
 
+static int set_vector_draw(int val, void *param)
+{
+    vicii_resources.vector_draw = val ? 1 : 0;
+    return 0;
+}
+
 struct vicii_model_info_s {
     int video;
     int luma;
@@ -145,6 +151,9 @@ static const resource_int_t resources_int[] =
     { "VICIIModel", 0, RES_EVENT_NO, NULL,
       &vicii_resources.model,
       set_model, NULL },
+    { "VICIIVectorDraw", 1, RES_EVENT_NO, NULL,
+      &vicii_resources.vector_draw,
+      set_vector_draw, NULL },
     { NULL }
 };
 
@@ -46,6 +46,9 @@ struct vicii_resources_s
 
     /* VIC-II model */
     int model;
+
+    /* Flag: Resolve the pixels of a cycle with vector lookups?  */
+    int vector_draw;
 };
 typedef struct vicii_resources_s vicii_resources_t;
 
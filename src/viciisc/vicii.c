@@ -138,6 +138,12 @@ void vicii_handle_pending_alarms_external_write(void)
     return;
 }
 
+CLOCK vicii_get_next_pending_clk(void)
+{
+    /* Cycles are stolen through the BA line, there is nothing pending.  */
+    return 0;
+}
+
 /* return pixel aspect ratio for current video mode */
 /* FIXME: calculate proper values.
    look at http://www.codebase64.org/doku.php?id=base:pixel_aspect_ratio&s[]=aspect
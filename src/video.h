@@ -180,6 +180,8 @@ extern void video_canvas_refresh(struct video_canvas_s *canvas,
                                  unsigned int xs, unsigned int ys,
                                  unsigned int xi, unsigned int yi,
                                  unsigned int w, unsigned int h);
+/* Called after the `video_canvas_refresh()' calls that make up one frame.  */
+extern void video_canvas_refresh_done(struct video_canvas_s *canvas);
 extern int video_canvas_set_palette(struct video_canvas_s *canvas,
                                     struct palette_s *palette);
 /* This will go away.  */
@@ -29,6 +29,11 @@
 #include "render1x1.h"
 #include "types.h"
 
+#if defined(__ALTIVEC__) && defined(WORDS_BIGENDIAN)
+#define RENDER_ALTIVEC
+#include <altivec.h>
+#endif
+
 
 /* 16 color 1x1 renderers */
 
@@ -80,6 +85,82 @@ void render_08_1x1_04(const video_render_color_tables_t *color_tab, const BYTE *
     }
 }
 
+#ifdef RENDER_ALTIVEC
+/* Convert one line 16 pixels at a time, looking up the first 16 colors
+   with vec_perm from tables holding the high and low bytes of each color.
+   Returns the number of pixels done; the caller does the rest.  */
+static unsigned int render_16_1x1_04_altivec(const DWORD *colortab,
+                                             vector unsigned char hi_tab,
+                                             vector unsigned char lo_tab,
+                                             const BYTE *src, WORD *trg,
+                                             unsigned int width)
+{
+    const vector unsigned char max_color = vec_splat_u8(15);
+    vector unsigned char pixels, hi, lo;
+    unsigned int x = 0, i;
+
+    /* alignment: 16 bytes for vec_st */
+    while (x < width && (vice_ptr_to_uint(trg + x) & 15) != 0) {
+        trg[x] = (WORD)colortab[src[x]];
+        x++;
+    }
+
+    while (x + 16 <= width) {
+        pixels = vec_perm(vec_ld(0, src + x), vec_ld(15, src + x),
+                          vec_lvsl(0, src + x));
+
+        if (vec_all_le(pixels, max_color)) {
+            hi = vec_perm(hi_tab, hi_tab, pixels);
+            lo = vec_perm(lo_tab, lo_tab, pixels);
+            vec_st(vec_mergeh(hi, lo), 0, (unsigned char *)(trg + x));
+            vec_st(vec_mergel(hi, lo), 16, (unsigned char *)(trg + x));
+        } else {
+            for (i = x; i < x + 16; i++) {
+                trg[i] = (WORD)colortab[src[i]];
+            }
+        }
+        x += 16;
+    }
+
+    return x;
+}
+
+void render_16_1x1_04(const video_render_color_tables_t *color_tab, const BYTE *src, BYTE *trg,
+                      unsigned int width, const unsigned int height,
+                      const unsigned int xs, const unsigned int ys,
+                      const unsigned int xt, const unsigned int yt,
+                      const unsigned int pitchs, const unsigned int pitcht)
+{
+    const DWORD *colortab = color_tab->physical_colors;
+    union {
+        vector unsigned char v;
+        BYTE b[16];
+    } hi_tab, lo_tab;
+    const BYTE *tmpsrc;
+    WORD *tmptrg;
+    unsigned int x, y;
+
+    src = src + pitchs * ys + xs;
+    trg = trg + pitcht * yt + (xt << 1);
+
+    for (x = 0; x < 16; x++) {
+        hi_tab.b[x] = (BYTE)(colortab[x] >> 8);
+        lo_tab.b[x] = (BYTE)colortab[x];
+    }
+
+    for (y = 0; y < height; y++) {
+        tmpsrc = src;
+        tmptrg = (WORD *)trg;
+        x = render_16_1x1_04_altivec(colortab, hi_tab.v, lo_tab.v, tmpsrc,
+                                     tmptrg, width);
+        for (; x < width; x++) {
+            tmptrg[x] = (WORD)colortab[tmpsrc[x]];
+        }
+        src += pitchs;
+        trg += pitcht;
+    }
+}
+#else
 void render_16_1x1_04(const video_render_color_tables_t *color_tab, const BYTE *src, BYTE *trg,
                       unsigned int width, const unsigned int height,
                       const unsigned int xs, const unsigned int ys,
@@ -129,6 +210,7 @@ void render_16_1x1_04(const video_render_color_tables_t *color_tab, const BYTE *
         trg += pitcht;
     }
 }
+#endif
 
 void render_24_1x1_04(const video_render_color_tables_t *color_tab, const BYTE *src, BYTE *trg,
                       unsigned int width, const unsigned int height,
@@ -101,6 +101,7 @@ void video_canvas_refresh_all(video_canvas_t *canvas)
 	geometry = canvas->geometry;
 
 	video_canvas_refresh(canvas, viewport->first_x + geometry->extra_offscreen_border_left, viewport->first_line, viewport->x_offset, viewport->y_offset, MIN(canvas->draw_buffer->canvas_width, geometry->screen_size.width - viewport->first_x), MIN(canvas->draw_buffer->canvas_height, viewport->last_line - viewport->first_line + 1));
+	video_canvas_refresh_done(canvas);
 }
 
 void video_canvas_redraw_size(video_canvas_t *canvas, unsigned int width, unsigned int height)
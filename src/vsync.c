@@ -49,15 +49,18 @@ int vsync_frame_counter;
 #include <limits.h>
 #endif
 
+#include "batchrun.h"
 #include "clkguard.h"
 #include "cmdline.h"
 #include "debug.h"
 #include "maincpu.h"
 #include "machine.h"
+#include "rewind.h"
 #ifdef HAVE_NETWORK
 #include "monitor_network.h"
 #endif
 #include "network.h"
+#include "perfcount.h"
 #include "resources.h"
 #include "sound.h"
 #include "translate.h"
@@ -259,6 +262,8 @@ void vsync_init(void (*hook)(void))
 	vsyncarch_init();
 
 	vsyncarch_freq = vsyncarch_frequency();
+
+	batchrun_init();
 }
 
 /* FIXME: This function is not needed here anymore, however it is
@@ -315,6 +320,11 @@ int vsync_do_vsync(struct video_canvas_s *c, int been_skipped)
 	signed long delay;
 	long frame_ticks_remainder, frame_ticks_integer, compval;
 
+	if (perfcount_enabled)
+		perfcount_frame();
+
+	PERFCOUNT_ENTER(PERFCOUNT_VSYNC);
+
 #ifdef HAVE_NETWORK
 	/* check if someone wants to connect remotely to the monitor */
 	monitor_check_remote();
@@ -330,6 +340,18 @@ int vsync_do_vsync(struct video_canvas_s *c, int been_skipped)
 
 	vsync_hook();
 
+	rewind_vsync();
+
+	/* Batch mode does not care about speed, sound or display; just check
+	   the exit conditions and skip the next frame.  */
+	if (batchrun_enabled)
+	{
+		batchrun_vsync();
+		vsyncarch_postsync();
+		PERFCOUNT_LEAVE(PERFCOUNT_VSYNC);
+		return 1;
+	}
+
 #ifdef DEBUG
 	/* switch between recording and playback in history debug mode */
 	debug_check_autoplay_mode();
@@ -362,7 +384,9 @@ int vsync_do_vsync(struct video_canvas_s *c, int been_skipped)
 	}
 
 	/* Flush sound buffer, get delay in seconds. */
+	PERFCOUNT_ENTER(PERFCOUNT_SOUND);
 	sound_delay = sound_flush();
+	PERFCOUNT_LEAVE(PERFCOUNT_SOUND);
 
 	/* Get current time, directly after getting the sound delay. */
 	now = vsyncarch_gettime();
@@ -486,5 +510,6 @@ int vsync_do_vsync(struct video_canvas_s *c, int been_skipped)
 	next_frame_start += frame_ticks;
 
 	vsyncarch_postsync();
+	PERFCOUNT_LEAVE(PERFCOUNT_VSYNC);
 	return skip_next_frame;
 }
@@ -39,6 +39,12 @@ extern signed long vsyncarch_frequency(void);
 /* provide the actual time in timer units */
 extern unsigned long vsyncarch_gettime(void);
 
+/* cheap high resolution host timer used by the performance counters */
+extern unsigned long vsyncarch_perf_ticks(void);
+
+/* number of perf timer units per second */
+extern signed long vsyncarch_perf_frequency(void);
+
 /* call when vsync_init is called */
 extern void vsyncarch_init(void);
 
@@ -33,6 +33,7 @@
 #include "vice.h"
 
 #include <ctype.h>
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -97,11 +98,36 @@ struct zfile_s {
     struct zfile_s *prev, *next; /* Link to the previous and next nodes.  */
     zfile_action_t action;       /* action on close */
     char *request_string;        /* ui string for action=ZFILE_REQUEST */
+    BYTE *data;                  /* Buffer behind an in-memory stream.  */
 };
 typedef struct zfile_s zfile_t;
 
 static zfile_t *zfile_list = NULL;
 
+/* The list and the cache are shared with the thread that opens disk
+   images ahead of time (see attach.c).  This lock is held only while they
+   are changed, never while a file is read, decompressed or compressed.  */
+static pthread_mutex_t zfile_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Decompressed files are kept in memory, so that attaching the same image
+   again does not have to inflate it again.  An entry is identified by the
+   CRC and length of the decompressed data, which gzip and zip both store
+   next to the compressed data, and by the length of the compressed file.  */
+#define ZFILE_CACHE_SIZE (4 * 1024 * 1024)
+
+struct zfile_cache_s {
+    DWORD crc;
+    size_t size;
+    size_t packed_size;
+    BYTE *data;
+    struct zfile_cache_s *next;
+};
+typedef struct zfile_cache_s zfile_cache_t;
+
+/* Most recently used first.  */
+static zfile_cache_t *zfile_cache = NULL;
+static size_t zfile_cache_size = 0;
+
 /* ------------------------------------------------------------------------- */
 
 static int zinit_done = 0;
@@ -139,7 +165,7 @@ static void zfile_list_add(const char *tmp_name,
                            const char *orig_name,
                            enum compression_type type,
                            int write_mode,
-                           FILE *stream, FILE *fd)
+                           FILE *stream, FILE *fd, BYTE *data)
 {
     zfile_t *new_zfile = lib_malloc(sizeof(zfile_t));
 
@@ -154,68 +180,263 @@ static void zfile_list_add(const char *tmp_name,
     new_zfile->type = type;
     new_zfile->action = ZFILE_KEEP;
     new_zfile->request_string = NULL;
+    new_zfile->data = data;
+
+    pthread_mutex_lock(&zfile_mutex);
     new_zfile->next = zfile_list;
     new_zfile->prev = NULL;
     if (zfile_list != NULL)
         zfile_list->prev = new_zfile;
     zfile_list = new_zfile;
+    pthread_mutex_unlock(&zfile_mutex);
+}
+
+static void zfile_cache_destroy(void)
+{
+    zfile_cache_t *p;
+
+    while (zfile_cache != NULL) {
+        p = zfile_cache;
+        zfile_cache = p->next;
+        lib_free(p->data);
+        lib_free(p);
+    }
+
+    zfile_cache_size = 0;
+}
+
+/* Return the cache entry for the given key and make it the most recently
+   used one, or return NULL.  */
+static zfile_cache_t *zfile_cache_find(DWORD crc, size_t size,
+                                       size_t packed_size)
+{
+    zfile_cache_t *p, *prev = NULL;
+
+    for (p = zfile_cache; p != NULL; prev = p, p = p->next) {
+        if (p->crc == crc && p->size == size
+            && p->packed_size == packed_size)
+            break;
+    }
+
+    if (p != NULL && prev != NULL) {
+        prev->next = p->next;
+        p->next = zfile_cache;
+        zfile_cache = p;
+    }
+
+    return p;
 }
 
+/* Return a copy of the cached data for the given key, or NULL.  */
+static BYTE *zfile_cache_get(DWORD crc, size_t size, size_t packed_size)
+{
+    zfile_cache_t *p;
+    BYTE *data = NULL;
+
+    pthread_mutex_lock(&zfile_mutex);
+
+    p = zfile_cache_find(crc, size, packed_size);
+
+    if (p != NULL) {
+        data = lib_malloc(size ? size : 1);
+        memcpy(data, p->data, size);
+    }
+
+    pthread_mutex_unlock(&zfile_mutex);
+
+    return data;
+}
+
+static void zfile_cache_put(DWORD crc, size_t packed_size, const BYTE *data,
+                            size_t size)
+{
+    zfile_cache_t *p, **pp;
+
+    if (size > ZFILE_CACHE_SIZE / 2)
+        return;
+
+    /* Copy outside the lock.  */
+    p = lib_malloc(sizeof(zfile_cache_t));
+    p->crc = crc;
+    p->size = size;
+    p->packed_size = packed_size;
+    p->data = lib_malloc(size ? size : 1);
+    memcpy(p->data, data, size);
+
+    pthread_mutex_lock(&zfile_mutex);
+
+    if (zfile_cache_find(crc, size, packed_size) != NULL) {
+        pthread_mutex_unlock(&zfile_mutex);
+        lib_free(p->data);
+        lib_free(p);
+        return;
+    }
+
+    p->next = zfile_cache;
+    zfile_cache = p;
+    zfile_cache_size += size;
+
+    /* Drop the least recently used entries.  */
+    while (zfile_cache_size > ZFILE_CACHE_SIZE) {
+        for (pp = &zfile_cache; (*pp)->next != NULL; pp = &(*pp)->next);
+        p = *pp;
+        *pp = NULL;
+        zfile_cache_size -= p->size;
+        lib_free(p->data);
+        lib_free(p);
+    }
+
+    pthread_mutex_unlock(&zfile_mutex);
+}
+
+/* The prefetch thread has already been joined by file_system_shutdown();
+   the lock only guards against a late caller.  */
 void zfile_shutdown(void)
 {
+    pthread_mutex_lock(&zfile_mutex);
     zfile_list_destroy();
+    zfile_cache_destroy();
+    pthread_mutex_unlock(&zfile_mutex);
+}
+
+/* Put decompressed data into a temporary file and return its name.  */
+static char *zfile_write_tmp(const BYTE *data, size_t size)
+{
+    FILE *fddest;
+    char *tmp_name = NULL;
+
+    fddest = archdep_mkstemp_fd(&tmp_name, MODE_WRITE);
+
+    if (fddest == NULL)
+        return NULL;
+
+    if (size > 0 && fwrite((void *)data, size, 1, fddest) < 1) {
+        fclose(fddest);
+        ioutil_remove(tmp_name);
+        lib_free(tmp_name);
+        return NULL;
+    }
+
+    fclose(fddest);
+
+    return tmp_name;
 }
 
 /* ------------------------------------------------------------------------ */
 
 /* Uncompression.  */
 
-/* If `name' has a gzip-like extension, try to uncompress it into a temporary
-   file using gzip or zlib if available.  If this succeeds, return the name
-   of the temporary file; return NULL otherwise.  */
-static char *try_uncompress_with_gzip(const char *name)
-{
 #ifdef HAVE_ZLIB
-    FILE *fdsrc, *fddest;
-    char *tmp_name = NULL;
-    int len;
+#define MAX_GZIP_SIZE 0x1000000
+
+/* If `name' has a gzip-like extension, uncompress it into memory.  If this
+   succeeds, return the data and its length in `size'; return NULL
+   otherwise.  */
+static BYTE *try_uncompress_with_gzip(const char *name, size_t *size)
+{
+    FILE *fdsrc;
+    BYTE trailer[8];
+    BYTE *packed, *data;
+    size_t packed_size, alloc, isize;
+    DWORD crc;
+    z_stream stream;
+    int rc;
 
     if (!archdep_file_is_gzip(name))
         return NULL;
 
-    fddest = archdep_mkstemp_fd(&tmp_name, MODE_WRITE);
+    fdsrc = fopen(name, MODE_READ);
+    if (fdsrc == NULL)
+        return NULL;
 
-    if (fddest == NULL)
+    packed_size = util_file_length(fdsrc);
+
+    /* The trailer holds the CRC and the length of the data.  */
+    if (packed_size < 18 || fseek(fdsrc, -8L, SEEK_END) != 0
+        || fread(trailer, 8, 1, fdsrc) < 1) {
+        fclose(fdsrc);
         return NULL;
+    }
 
-    fdsrc = gzopen(name, MODE_READ);
-    if (fdsrc == NULL) {
-        fclose(fddest);
-        ioutil_remove(tmp_name);
-        lib_free(tmp_name);
+    crc = trailer[0] | (trailer[1] << 8) | (trailer[2] << 16)
+          | ((DWORD)trailer[3] << 24);
+    isize = trailer[4] | (trailer[5] << 8) | (trailer[6] << 16)
+            | ((DWORD)trailer[7] << 24);
+
+    data = zfile_cache_get(crc, isize, packed_size);
+    if (data != NULL) {
+        fclose(fdsrc);
+        ZDEBUG(("try_uncompress_with_gzip: `%s' from cache", name));
+        *size = isize;
+        return data;
+    }
+
+    /* Read the whole file and inflate it in one go.  */
+    packed = lib_malloc(packed_size);
+    if (fseek(fdsrc, 0L, SEEK_SET) != 0
+        || fread(packed, packed_size, 1, fdsrc) < 1) {
+        lib_free(packed);
+        fclose(fdsrc);
+        return NULL;
+    }
+    fclose(fdsrc);
+
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, 15 + 16) != Z_OK) {
+        lib_free(packed);
         return NULL;
     }
 
+    /* Do not trust a damaged trailer too far.  */
+    alloc = (isize < MAX_GZIP_SIZE ? isize : packed_size * 4) + 1;
+    data = lib_malloc(alloc);
+
+    stream.next_in = packed;
+    stream.avail_in = (uInt)packed_size;
+    stream.next_out = data;
+    stream.avail_out = (uInt)alloc;
+
     do {
-        char buf[256];
+        rc = inflate(&stream, Z_NO_FLUSH);
 
-        len = gzread(fdsrc, (void *)buf, 256);
-        if (len > 0) {
-            if (fwrite((void *)buf, 1, (size_t)len, fddest) < len) {
-                gzclose(fdsrc);
-                fclose(fddest);
-                ioutil_remove(tmp_name);
-                lib_free(tmp_name);
-                return NULL;
-            }
+        /* Concatenated members are inflated one after the other, other
+           trailing bytes are ignored like gzread() does.  */
+        if (rc == Z_STREAM_END && stream.avail_in >= 2
+            && stream.next_in[0] == 0x1f && stream.next_in[1] == 0x8b) {
+            rc = inflateReset(&stream);
+            continue;
         }
-    } while (len > 0);
 
-    gzclose(fdsrc);
-    fclose(fddest);
+        if (rc == Z_OK && stream.avail_out == 0) {
+            /* The length in the trailer only counts the last member.  */
+            data = lib_realloc(data, alloc * 2);
+            stream.next_out = data + alloc;
+            stream.avail_out = (uInt)alloc;
+            alloc *= 2;
+        }
+    } while (rc == Z_OK);
 
-    return tmp_name;
+    *size = (size_t)(stream.next_out - data);
+    inflateEnd(&stream);
+    lib_free(packed);
+
+    if (rc != Z_STREAM_END) {
+        lib_free(data);
+        return NULL;
+    }
+
+    /* Only single member files are identified by their trailer.  */
+    if (*size == isize)
+        zfile_cache_put(crc, packed_size, data, *size);
+
+    return data;
+}
 #else
+/* If `name' has a gzip-like extension, try to uncompress it into a temporary
+   file using gzip.  If this succeeds, return the name of the temporary file;
+   return NULL otherwise.  */
+static char *try_uncompress_with_gzip(const char *name)
+{
     char *tmp_name = NULL;
     int exit_status;
     char *argv[4];
@@ -245,8 +466,8 @@ static char *try_uncompress_with_gzip(const char *name)
         lib_free(tmp_name);
         return NULL;
     }
-#endif
 }
+#endif
 
 #define MAX_BUFFER_SIZE 524288
 
@@ -295,15 +516,21 @@ int zipfile_entries(const char *name)
 }
 
 
-static char *try_uncompress_with_unzip(const char *name, int write_mode)
+/* Uncompress the first file of the zip archive `name' into memory.  If this
+   succeeds, return the data and its length in `size'; return NULL otherwise.
+   `*read_only' is set if this is a zip file that cannot be opened for
+   writing.  */
+static BYTE *try_uncompress_with_unzip(const char *name, int write_mode,
+                                       size_t *size, int *read_only)
 {
     unz_file_info  info;
     unzFile        file;
 
-    uint8_t        *buffer;
+    BYTE           *buffer;
     char           filename[132];
     int            filesize = 0;
     int            port;
+    int            l;
 
     file = unzOpen(name);
 
@@ -319,6 +546,7 @@ static char *try_uncompress_with_unzip(const char *name, int write_mode)
     if (filesize > MAX_BUFFER_SIZE)
     {
         //log_error(zlog, "filesize (%d) exceeds maximum buffer size.\n", filesize);
+        unzClose(file);
         return NULL;
     }
 
@@ -329,23 +557,34 @@ static char *try_uncompress_with_unzip(const char *name, int write_mode)
     }
 
     /* This would be a valid ZIP file, but we cannot handle ZIP files in
-       write mode.  Return a null temporary file name to report this.  */
+       write mode.  */
     if (write_mode) {
         ZDEBUG(("try_uncompress_archive: cannot open file in write mode."));
-        return "";
+        unzClose(file);
+        *read_only = 1;
+        return NULL;
     }
 
     ZDEBUG(("try_uncompress_archive file : %s from %s", filename, name));
 
+    *size = (size_t)filesize;
+
+    buffer = zfile_cache_get((DWORD)info.crc, *size,
+                             (size_t)info.compressed_size);
+    if (buffer != NULL) {
+        unzClose(file);
+        return buffer;
+    }
+
     if (unzOpenCurrentFile(file) != UNZ_OK)
     {
         unzClose(file);
         return NULL;
     }
 
-    // TODO This should really use a small buffer and iterate until filesize
+    /* The whole file is inflated with a single call.  */
     buffer = lib_malloc(filesize);
-    int l = unzReadCurrentFile(file, buffer, filesize);
+    l = unzReadCurrentFile(file, buffer, filesize);
 
     if (unzCloseCurrentFile(file) == UNZ_CRCERROR)
     {
@@ -363,30 +602,11 @@ static char *try_uncompress_with_unzip(const char *name, int write_mode)
 
     unzClose(file);
 
-    // Now write the file to a temp file, and return that temp filename
-    FILE *fddest;
-    char *tmp_name = NULL;
-    fddest = archdep_mkstemp_fd(&tmp_name, MODE_WRITE);
-
-    if (fddest == NULL) {
-        lib_free(buffer);
-        return NULL;
-    }
+    zfile_cache_put((DWORD)info.crc, (size_t)info.compressed_size, buffer,
+                    *size);
 
-    // TODO This should really use a small buffer and iterate until filesize
-    if (fwrite((void *)buffer, 1, (size_t)filesize, fddest) < filesize) {
-        fclose(fddest);
-        ioutil_remove(tmp_name);
-        lib_free(tmp_name);
-        lib_free(buffer);
-        return NULL;
-    }
-
-    fclose(fddest);
-    lib_free(buffer);
-
-    ZDEBUG(("try_uncompress_archive: '%s' to `%s' successful.", filename, tmp_name));
-    return tmp_name;
+    ZDEBUG(("try_uncompress_archive: '%s' successful.", filename));
+    return buffer;
 }
 
 
@@ -871,14 +1091,18 @@ static const valid_archives_t valid_archives[] = {
 /* Try to uncompress file `name' using the algorithms we know of.  If this is
    not possible, return `COMPR_NONE'.  Otherwise, uncompress the file into a
    temporary file, return the type of algorithm used and the name of the
-   temporary file in `tmp_name'.  If `write_mode' is non-zero and the
-   returned `tmp_name' has zero length, then the file cannot be accessed in
-   write mode.  */
+   temporary file in `tmp_name'.  Files that are uncompressed into memory
+   are returned in `data' and `size' instead, with `tmp_name' set to NULL.
+   If `write_mode' is non-zero and the returned `tmp_name' has zero length,
+   then the file cannot be accessed in write mode.  */
 static enum compression_type try_uncompress(const char *name,
                                             char **tmp_name,
+                                            BYTE **data, size_t *size,
                                             int write_mode)
 {
-    int i;
+    int i, read_only = 0;
+
+    *data = NULL;
 
     for (i = 0; valid_archives[i].program; i++) {
         if ((*tmp_name = try_uncompress_archive(name, write_mode,
@@ -893,12 +1117,25 @@ static enum compression_type try_uncompress(const char *name,
     }
 
     /* need this order or .tar.gz is misunderstood */
+#ifdef HAVE_ZLIB
+    *tmp_name = NULL;
+    if ((*data = try_uncompress_with_gzip(name, size)) != NULL)
+        return COMPR_GZIP;
+#else
     if ((*tmp_name = try_uncompress_with_gzip(name)) != NULL)
         return COMPR_GZIP;
+#endif
 
-    if ((*tmp_name = try_uncompress_with_unzip(name, write_mode)) != NULL)
+    *tmp_name = NULL;
+    if ((*data = try_uncompress_with_unzip(name, write_mode, size,
+                                           &read_only)) != NULL)
         return COMPR_ZIP;
 
+    if (read_only) {
+        *tmp_name = "";
+        return COMPR_ZIP;
+    }
+
     if ((*tmp_name = try_uncompress_with_bzip(name)) != NULL)
         return COMPR_BZIP;
 
@@ -1133,12 +1370,16 @@ static int zfile_compress(const char *src, const char *dest,
 FILE *zfile_fopen(const char *name, const char *mode)
 {
     char *tmp_name;
+    BYTE *data;
+    size_t size;
     FILE *stream;
     enum compression_type type;
     int write_mode = 0;
 
+    pthread_mutex_lock(&zfile_mutex);
     if (!zinit_done)
         zinit();
+    pthread_mutex_unlock(&zfile_mutex);
 
     if (name == NULL || name[0] == 0)
         return NULL;
@@ -1151,13 +1392,32 @@ FILE *zfile_fopen(const char *name, const char *mode)
     if (write_mode && ioutil_access(name, IOUTIL_ACCESS_W_OK) < 0)
         return NULL;
 
-    type = try_uncompress(name, &tmp_name, write_mode);
+    type = try_uncompress(name, &tmp_name, &data, &size, write_mode);
     if (type == COMPR_NONE) {
         stream = fopen(name, mode);
         if (stream == NULL)
             return NULL;
-        zfile_list_add(NULL, name, type, write_mode, stream, NULL);
+        zfile_list_add(NULL, name, type, write_mode, stream, NULL, NULL);
         return stream;
+    }
+
+    if (data != NULL) {
+#ifdef HAVE_FMEMOPEN
+        /* Read the uncompressed data straight from memory.  */
+        if (!write_mode) {
+            stream = fmemopen(data, size, mode);
+            if (stream == NULL) {
+                lib_free(data);
+                return NULL;
+            }
+            zfile_list_add(NULL, name, type, write_mode, stream, NULL, data);
+            return stream;
+        }
+#endif
+        tmp_name = zfile_write_tmp(data, size);
+        lib_free(data);
+        if (tmp_name == NULL)
+            return NULL;
     } else if (*tmp_name == '\0') {
         errno = EACCES;
         return NULL;
@@ -1168,7 +1428,7 @@ FILE *zfile_fopen(const char *name, const char *mode)
     if (stream == NULL)
         return NULL;
 
-    zfile_list_add(tmp_name, name, type, write_mode, stream, NULL);
+    zfile_list_add(tmp_name, name, type, write_mode, stream, NULL, NULL);
 
     /* now we don't need the archdep_tmpnam allocation any more */
     lib_free(tmp_name);
@@ -1198,37 +1458,33 @@ static int handle_close_action(zfile_t *ptr)
     return 0;
 }
 
-/* Handle close of a (compressed file). `ptr' points to the zfile to close.  */
+/* Handle close of a (compressed file). `ptr' points to the zfile to close,
+   which has already been removed from the list.  */
 static int handle_close(zfile_t *ptr)
 {
+	int rc = 0;
+
 	ZDEBUG(("handle_close: closing `%s' (`%s'), write_mode = %d",
 				ptr->tmp_name ? ptr->tmp_name : "(null)",
 				ptr->orig_name, ptr->write_mode));
 
 	if (ptr->tmp_name) {
-		/* Recompress into the original file.  */
+		/* Recompress into the original file.  If that fails, the
+		   temporary file is kept, so the data is not lost.  */
 		if (ptr->orig_name
 				&& ptr->write_mode
 				&& zfile_compress(ptr->tmp_name, ptr->orig_name, ptr->type))
-			return -1;
+			rc = -1;
 
 		/* Remove temporary file.  */
-		if (ioutil_remove(ptr->tmp_name) < 0)
+		if (rc == 0 && ioutil_remove(ptr->tmp_name) < 0)
 		{
 			//log_error(zlog, "Cannot unlink `%s': %s", ptr->tmp_name, strerror(errno));
 		}
 	}
 
-	handle_close_action(ptr);
-
-	/* Remove item from list.  */
-	if (ptr->prev != NULL)
-		ptr->prev->next = ptr->next;
-	else
-		zfile_list = ptr->next;
-
-	if (ptr->next != NULL)
-		ptr->next->prev = ptr->prev;
+	if (rc == 0)
+		handle_close_action(ptr);
 
 	if (ptr->orig_name)
 		lib_free(ptr->orig_name);
@@ -1236,10 +1492,37 @@ static int handle_close(zfile_t *ptr)
 		lib_free(ptr->tmp_name);
 	if (ptr->request_string)
 		lib_free(ptr->request_string);
+	if (ptr->data)
+		lib_free(ptr->data);
 
 	lib_free(ptr);
 
-	return 0;
+	return rc;
+}
+
+/* Find the zfile for `stream' and remove it from the list.  */
+static zfile_t *zfile_list_take(FILE *stream)
+{
+    zfile_t *ptr;
+
+    pthread_mutex_lock(&zfile_mutex);
+
+    for (ptr = zfile_list; ptr != NULL; ptr = ptr->next) {
+        if (ptr->stream == stream) {
+            if (ptr->prev != NULL)
+                ptr->prev->next = ptr->next;
+            else
+                zfile_list = ptr->next;
+
+            if (ptr->next != NULL)
+                ptr->next->prev = ptr->prev;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&zfile_mutex);
+
+    return ptr;
 }
 
 /* `fclose()' wrapper.  */
@@ -1253,44 +1536,48 @@ int zfile_fclose(FILE *stream)
     }
 
     /* Search for the matching file in the list.  */
-    for (ptr = zfile_list; ptr != NULL; ptr = ptr->next) {
-        if (ptr->stream == stream) {
-
-            /* Close temporary file.  */
-            if (fclose(stream) == -1) {
-                return -1;
-            }
-            if (handle_close(ptr) < 0) {
-                errno = EBADF;
-                return -1;
-            }
+    ptr = zfile_list_take(stream);
+    if (ptr == NULL)
+        return fclose(stream);
+
+    /* Close temporary file.  The stream is gone even if this fails, but
+       its data is not recompressed then.  */
+    if (fclose(stream) == -1) {
+        ptr->write_mode = 0;
+        handle_close(ptr);
+        return -1;
+    }
 
-            return 0;
-        }
+    if (handle_close(ptr) < 0) {
+        errno = EBADF;
+        return -1;
     }
 
-    return fclose(stream);
+    return 0;
 }
 
 int zfile_close_action(const char *filename, zfile_action_t action,
                        const char *request_str)
 {
     char *fullname = NULL;
-    zfile_t *p = zfile_list;
+    zfile_t *p;
+    int rc = -1;
 
     archdep_expand_path(&fullname, filename);
 
-    while (p != NULL) {
+    pthread_mutex_lock(&zfile_mutex);
+
+    for (p = zfile_list; p != NULL; p = p->next) {
         if (p->orig_name && !strcmp(p->orig_name, fullname)) {
             p->action = action;
             p->request_string = request_str ? lib_stralloc(request_str) : NULL;
-            lib_free(fullname);
-            return 0;
+            rc = 0;
+            break;
         }
-        p = p->next;
     }
 
+    pthread_mutex_unlock(&zfile_mutex);
+
     lib_free(fullname);
-    return -1;
+    return rc;
 }
-